@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+
+#include "Types.h"
+
+namespace Hash
+{
+	/* 64-bit FNV-1a. A hash can be continued over more data by passing it as 'hash'. */
+	constexpr u64 fnv_offset_basis = 0xCBF29CE484222325;
+	constexpr u64 fnv_prime = 0x100000001B3;
+
+	inline u64 FNV1a(const void* data, const size_t size, u64 hash = fnv_offset_basis)
+	{
+		const u8* bytes = static_cast<const u8*>(data);
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= fnv_prime;
+		}
+		return hash;
+	}
+}
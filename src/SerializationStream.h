@@ -1,24 +1,55 @@
 #pragma once
 
 #include <array>
+#include <cstring>
 #include <deque>
 #include <fstream>
 #include <queue>
+#include <span>
 #include <string>
+#include <type_traits>
 #include <vector>
 
-/* A class used for save states and configuration files; reads or writes data from/to files */
+#include "Types.h"
+
+/* A class used for save states and configuration files; reads or writes data from/to files, or from/to memory.
+   Streaming to memory is meant for states that are taken often (e.g. rewind and run-ahead): data is copied in bulk, and a buffer
+   that is serialized into again keeps its capacity, so that once it has grown to the size of a state, nothing is allocated. */
 class SerializationStream
 {
 private:
 	bool has_error = false; // an error has occured while reading/writing.
 	std::fstream fstream;
 
+	/* Memory streams only */
+	std::vector<u8>* write_buffer = nullptr;
+	std::span<const u8> read_buffer;
+	size_t read_pos = 0;
+	bool in_memory = false;
+
 	void Stream(void* obj, const size_t size)
 	{
 		if (has_error)
 			return;
 
+		if (in_memory)
+		{
+			if (mode == Mode::Serialization)
+			{
+				write_buffer->insert(write_buffer->end(), (const u8*)obj, (const u8*)obj + size);
+			}
+			else if (size > read_buffer.size() - read_pos)
+			{
+				has_error = true;
+			}
+			else
+			{
+				std::memcpy(obj, read_buffer.data() + read_pos, size);
+				read_pos += size;
+			}
+			return;
+		}
+
 		if (mode == Mode::Serialization)
 			fstream.write((const char*)obj, size);
 		else
@@ -49,6 +80,12 @@ public:
 		}
 	}
 
+	/* Serializes into 'buffer', after what it already holds. */
+	explicit SerializationStream(std::vector<u8>& buffer) : write_buffer(&buffer), in_memory(true), mode(Mode::Serialization) {}
+
+	/* Deserializes from 'buffer', which must outlive the stream. Reading past its end is an error. */
+	explicit SerializationStream(std::span<const u8> buffer) : read_buffer(buffer), in_memory(true), mode(Mode::Deserialization) {}
+
 	SerializationStream(const SerializationStream& other) = delete;
 
 	SerializationStream(SerializationStream&& other) noexcept : mode(other.mode)
@@ -65,6 +102,10 @@ public:
 			this->fstream.swap(other.fstream);
 			this->has_error = other.has_error;
 			other.has_error = false;
+			this->write_buffer = other.write_buffer;
+			this->read_buffer = other.read_buffer;
+			this->read_pos = other.read_pos;
+			this->in_memory = other.in_memory;
 		}
 		return *this;
 	}
@@ -74,6 +115,12 @@ public:
 		return has_error;
 	}
 
+	/* Memory streams only; whether all of the buffer has been deserialized. */
+	bool ReachedEnd() const
+	{
+		return read_pos == read_buffer.size();
+	}
+
 	template<typename T> void StreamPrimitive(T& number)
 	{
 		Stream(&number, sizeof T);
@@ -101,6 +148,11 @@ public:
 		{
 			size_t size = 0;
 			Stream(&size, sizeof(size_t));
+			if (has_error || (in_memory && size > read_buffer.size() - read_pos))
+			{
+				has_error = true;
+				return;
+			}
 			char* c_str = new char[size + 1]{};
 			Stream(c_str, size * sizeof(char));
 			str = std::string(c_str);
@@ -175,9 +227,39 @@ public:
 		}
 	}
 
+	/* For vectors whose size is fixed once they are made (e.g. cartridge RAM); streamed as StreamVector does. Loading data
+	   of another size is an error, and leaves the vector as it was. */
+	template<typename T> void StreamFixedSizeVector(std::vector<T>& vector)
+	{
+		static_assert(std::is_trivially_copyable_v<T>);
+		size_t size = vector.size();
+		Stream(&size, sizeof(size_t));
+		if (!has_error && size != vector.size())
+			has_error = true;
+		Stream(vector.data(), size * sizeof(T));
+	}
+
 	template<typename T> void StreamVector(std::vector<T>& vector)
 	{
-		if (mode == Mode::Serialization)
+		/* Vectors of plain data are streamed in one go. Loading into a vector of the same size does not allocate. */
+		if constexpr (std::is_trivially_copyable_v<T>)
+		{
+			size_t size = vector.size();
+			Stream(&size, sizeof(size_t));
+			if (has_error)
+				return;
+			if (mode == Mode::Deserialization)
+			{
+				if (in_memory && size > (read_buffer.size() - read_pos) / sizeof(T))
+				{
+					has_error = true;
+					return;
+				}
+				vector.resize(size);
+			}
+			Stream(vector.data(), size * sizeof(T));
+		}
+		else if (mode == Mode::Serialization)
 		{
 			size_t size = vector.size();
 			Stream(&size, sizeof(size_t));
@@ -0,0 +1,158 @@
+#include "StateCompression.h"
+
+#include <algorithm>
+#include <cstring>
+
+
+namespace StateCompression
+{
+	static constexpr size_t max_literal_run = 128;
+	static constexpr size_t min_repeat_run = 3;
+	static constexpr size_t extended_repeat_run = min_repeat_run + 127; /* Runs this long or longer have their length continued in a varint */
+	static constexpr size_t short_run = 16;
+
+
+	template<bool has_base>
+	static void CompressImpl(const u8* data, const u8* base, const size_t size, std::vector<u8>& out)
+	{
+		auto Byte = [&](size_t i) -> u8 {
+			if constexpr (has_base) return data[i] ^ base[i];
+			else return data[i];
+		};
+		auto Word = [&](size_t i) -> u64 {
+			u64 word;
+			std::memcpy(&word, data + i, sizeof(u64));
+			if constexpr (has_base)
+			{
+				u64 base_word;
+				std::memcpy(&base_word, base + i, sizeof(u64));
+				word ^= base_word;
+			}
+			return word;
+		};
+
+		size_t literal_start = 0;
+		auto EmitLiterals = [&](const size_t end) {
+			while (literal_start < end)
+			{
+				const size_t len = std::min(end - literal_start, max_literal_run);
+				const size_t out_pos = out.size();
+				out.resize(out_pos + 1 + len);
+				out[out_pos] = u8(len - 1);
+				for (size_t i = 0; i < len; i++)
+					out[out_pos + 1 + i] = Byte(literal_start + i);
+				literal_start += len;
+			}
+		};
+		auto EmitRepeat = [&](const u8 value, const size_t len) {
+			if (len < extended_repeat_run)
+			{
+				out.push_back(u8(0x80 | (len - min_repeat_run)));
+				out.push_back(value);
+				return;
+			}
+			out.push_back(0xFF);
+			out.push_back(value);
+			size_t more = len - extended_repeat_run;
+			while (more >= 0x80)
+			{
+				out.push_back(u8(more | 0x80));
+				more >>= 7;
+			}
+			out.push_back(u8(more));
+		};
+
+		size_t pos = 0;
+		while (pos < size)
+		{
+			/* Find how far the byte at 'pos' repeats; eight bytes at a time, as long runs are the common case. */
+			const u8 value = Byte(pos);
+			const u64 pattern = u64(value) * 0x0101010101010101;
+			size_t end = pos + 1;
+			while (end + sizeof(u64) <= size && Word(end) == pattern)
+				end += sizeof(u64);
+			while (end < size && Byte(end) == value)
+				end++;
+			if (end - pos >= min_repeat_run)
+			{
+				EmitLiterals(pos);
+				EmitRepeat(value, end - pos);
+				literal_start = end;
+			}
+			pos = end;
+		}
+		EmitLiterals(size);
+	}
+
+
+	void Compress(const std::span<const u8> data, const std::span<const u8> base, std::vector<u8>& out)
+	{
+		if (base.empty())
+			CompressImpl<false>(data.data(), nullptr, data.size(), out);
+		else
+			CompressImpl<true>(data.data(), base.data(), data.size(), out);
+	}
+
+
+	bool Decompress(const std::span<const u8> compressed, const std::span<const u8> base, const std::span<u8> out)
+	{
+		if (!base.empty() && base.size() != out.size())
+			return false;
+
+		size_t in_pos = 0, out_pos = 0;
+		while (in_pos < compressed.size())
+		{
+			const u8 token = compressed[in_pos++];
+			if (token < 0x80)
+			{
+				const size_t len = token + 1;
+				if (len > compressed.size() - in_pos || len > out.size() - out_pos)
+					return false;
+				/* Most runs are short; copying a fixed number of bytes is faster than copying exactly as many. What is written
+				   past the run is written over by the runs after it. */
+				if (len <= short_run && compressed.size() - in_pos >= short_run && out.size() - out_pos >= short_run)
+					std::memcpy(out.data() + out_pos, compressed.data() + in_pos, short_run);
+				else
+					std::memcpy(out.data() + out_pos, compressed.data() + in_pos, len);
+				in_pos += len;
+				out_pos += len;
+				continue;
+			}
+
+			if (in_pos == compressed.size())
+				return false;
+			const u8 value = compressed[in_pos++];
+			size_t len = (token & 0x7F) + min_repeat_run;
+			if (len == extended_repeat_run)
+			{
+				size_t more = 0;
+				for (unsigned shift = 0; ; shift += 7)
+				{
+					if (in_pos == compressed.size() || shift >= 8 * sizeof(size_t))
+						return false;
+					const u8 byte = compressed[in_pos++];
+					more |= size_t(byte & 0x7F) << shift;
+					if (!(byte & 0x80))
+						break;
+				}
+				len += more;
+			}
+			if (len > out.size() - out_pos)
+				return false;
+			if (len <= short_run && out.size() - out_pos >= short_run)
+				std::memset(out.data() + out_pos, value, short_run);
+			else
+				std::memset(out.data() + out_pos, value, len);
+			out_pos += len;
+		}
+		if (out_pos != out.size())
+			return false;
+
+		if (!base.empty())
+		{
+			for (size_t i = 0; i < out.size(); i++)
+				out[i] ^= base[i];
+		}
+		return true;
+	}
+}
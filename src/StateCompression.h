@@ -0,0 +1,22 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include "Types.h"
+
+/* A byte compressor for save states, made for speed rather than ratio. A state is mostly made up of runs of the same byte
+   (cleared RAM, blank areas of the framebuffer), and a state XORed with an earlier one of the same game (see Rewinder) is mostly
+   zeroes; so the data is stored as a sequence of
+   - literal runs: a byte 0lllllll, followed by l + 1 bytes, and
+   - repeat runs: a byte 1lllllll, followed by the byte to repeat, and, if l is 127, a varint with more length; l + 3 (+ more) bytes. */
+namespace StateCompression
+{
+	/* Appends 'data' to 'out' in compressed form. If 'base' is not empty, 'data' XORed with 'base' is stored instead;
+	   'base' must then be of the same size as 'data'. */
+	void Compress(std::span<const u8> data, std::span<const u8> base, std::vector<u8>& out);
+
+	/* Decompresses into 'out', which must be of the size of the data that was compressed, and XORs it with 'base' if that is not empty.
+	   Returns false if 'compressed' is not valid. */
+	[[nodiscard]] bool Decompress(std::span<const u8> compressed, std::span<const u8> base, std::span<u8> out);
+}
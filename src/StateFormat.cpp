@@ -0,0 +1,131 @@
+#include "StateFormat.h"
+
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+
+#include "StateCompression.h"
+
+
+namespace StateFormat
+{
+	static constexpr u8 magic[8] = { 'N', 'E', 'S', '-', 'S', 'T', 'A', 0x1A };
+
+	static constexpr u32 flag_compressed = 1 << 0;
+
+	/* States are around a hundred kilobytes; the largest that a game can make (with the most cartridge RAM there is) are well below this.
+	   Checked before a file's state is allocated for. */
+	static constexpr u64 max_state_size = 16 * 1024 * 1024;
+
+	struct FileHeader
+	{
+		u8 magic[8];
+		u32 version;
+		u32 flags;
+		u64 state_size; /* Before compression */
+	};
+
+	struct ChunkHeader
+	{
+		u32 id;
+		u32 length;
+	};
+
+
+	size_t BeginChunk(std::vector<u8>& state, const u32 id)
+	{
+		const size_t chunk_pos = state.size();
+		const ChunkHeader header = { id, 0 };
+		state.insert(state.end(), (const u8*)&header, (const u8*)&header + sizeof(ChunkHeader));
+		return chunk_pos;
+	}
+
+
+	void EndChunk(std::vector<u8>& state, const size_t chunk_pos)
+	{
+		const u32 length = u32(state.size() - chunk_pos - sizeof(ChunkHeader));
+		std::memcpy(state.data() + chunk_pos + offsetof(ChunkHeader, length), &length, sizeof(u32));
+	}
+
+
+	std::optional<std::span<const u8>> ChunkReader::Next(const u32 id)
+	{
+		if (state.size() - pos < sizeof(ChunkHeader))
+			return std::nullopt;
+		ChunkHeader header;
+		std::memcpy(&header, state.data() + pos, sizeof(ChunkHeader));
+		if (header.id != id || header.length > state.size() - pos - sizeof(ChunkHeader))
+			return std::nullopt;
+		pos += sizeof(ChunkHeader);
+		const std::span<const u8> data = state.subspan(pos, header.length);
+		pos += header.length;
+		return data;
+	}
+
+
+	bool WriteFile(const std::string& path, const std::span<const u8> state, const bool compress)
+	{
+		FileHeader header{};
+		std::memcpy(header.magic, magic, sizeof(magic));
+		header.version = version;
+		header.state_size = state.size();
+
+		std::vector<u8> file(sizeof(FileHeader));
+		if (compress)
+		{
+			StateCompression::Compress(state, {}, file);
+			if (file.size() - sizeof(FileHeader) < state.size())
+				header.flags |= flag_compressed;
+			else
+				file.resize(sizeof(FileHeader));
+		}
+		if (!(header.flags & flag_compressed))
+			file.insert(file.end(), state.begin(), state.end());
+		std::memcpy(file.data(), &header, sizeof(FileHeader));
+
+		std::ofstream ofs{ path, std::ios::out | std::ios::binary | std::ios::trunc };
+		ofs.write((const char*)file.data(), file.size());
+		return bool(ofs);
+	}
+
+
+	FileError ReadFile(const std::string& path, std::vector<u8>& state)
+	{
+		std::ifstream ifs{ path, std::ios::in | std::ios::binary | std::ios::ate };
+		if (!ifs)
+			return FileError::CannotOpen;
+		const std::streamoff file_size = ifs.tellg();
+		if (file_size < std::streamoff(sizeof(FileHeader)))
+			return FileError::NotASaveState;
+
+		std::vector<u8> file(file_size);
+		ifs.seekg(0);
+		ifs.read((char*)file.data(), file_size);
+		if (!ifs)
+			return FileError::CannotOpen;
+
+		FileHeader header;
+		std::memcpy(&header, file.data(), sizeof(FileHeader));
+		if (std::memcmp(header.magic, magic, sizeof(magic)) != 0)
+			return FileError::NotASaveState;
+		if (header.version != version)
+			return FileError::OtherVersion;
+		if (header.state_size > max_state_size || (header.flags & ~flag_compressed))
+			return FileError::Corrupt;
+
+		const std::span<const u8> payload = std::span<const u8>(file).subspan(sizeof(FileHeader));
+		if (header.flags & flag_compressed)
+		{
+			state.resize(header.state_size);
+			if (!StateCompression::Decompress(payload, {}, state))
+				return FileError::Corrupt;
+		}
+		else
+		{
+			if (payload.size() != header.state_size)
+				return FileError::Corrupt;
+			state.assign(payload.begin(), payload.end());
+		}
+		return FileError::None;
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "Types.h"
+
+/* The layout of save states.
+   A state is a sequence of chunks (see Emulator::SaveStateToMemory): one that identifies the rom, then one per component.
+   A chunk is a four-character ID, the length of the data, and the data that the component streams (see Snapshottable). States that are held in memory (rewind, run-ahead) are just that.
+   Save state files start with a header: a magic number, the version of the layout, flags, and the size of the chunks; which follow,
+   compressed (see StateCompression) unless that would not make them any smaller.
+   Components stream their members as they are laid out in memory. Any change to what a component streams, or to the layout
+   of a struct that it streams whole, must come with a new 'version', as files of other versions are refused. */
+namespace StateFormat
+{
+	constexpr u32 version = 3;
+
+	enum class FileError
+	{
+		None,
+		CannotOpen,
+		NotASaveState, /* Including the states of versions of the emulator that saved them without a header */
+		OtherVersion,
+		Corrupt
+	};
+
+	constexpr u32 ChunkID(const char (&id)[5])
+	{
+		return u32(u8(id[0])) | u32(u8(id[1])) << 8 | u32(u8(id[2])) << 16 | u32(u8(id[3])) << 24;
+	}
+
+	/* Appends the header of a chunk to 'state', and returns where it is. Its length is filled in by EndChunk,
+	   once the data of the chunk has been appended. */
+	size_t BeginChunk(std::vector<u8>& state, u32 id);
+	void EndChunk(std::vector<u8>& state, size_t chunk_pos);
+
+	/* Goes through the chunks of a state, in order. */
+	class ChunkReader
+	{
+	public:
+		explicit ChunkReader(std::span<const u8> state) : state(state) {}
+
+		/* Returns the data of the next chunk; if there is one, and it has the given ID. */
+		std::optional<std::span<const u8>> Next(u32 id);
+		bool ReachedEnd() const { return pos == state.size(); }
+
+	private:
+		std::span<const u8> state;
+		size_t pos = 0;
+	};
+
+	/* Writes the chunks of a state to a file, with a header, in one go. Returns true on success. */
+	[[nodiscard]] bool WriteFile(const std::string& path, std::span<const u8> state, bool compress);
+	/* Reads the chunks of a state from a file into 'state', replacing what it held. */
+	[[nodiscard]] FileError ReadFile(const std::string& path, std::vector<u8>& state);
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/* A fixed set of worker threads that jobs can be handed to.
+   ParallelFor splits a range into bands that are processed by the workers and the calling thread together.
+   The calling thread keeps taking bands itself until none are left, so calling ParallelFor from within a job
+   that is running on the pool can never deadlock; it just gets less help. */
+class ThreadPool
+{
+public:
+	explicit ThreadPool(unsigned num_threads = DefaultNumThreads())
+	{
+		for (unsigned i = 0; i < num_threads; i++)
+			workers.emplace_back([this] { WorkerLoop(); });
+	}
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard lock(mutex);
+			stopping = true;
+		}
+		job_available.notify_all();
+		for (std::thread& worker : workers)
+			worker.join();
+	}
+
+	ThreadPool(const ThreadPool& other) = delete;
+	ThreadPool(ThreadPool&& other) = delete;
+	ThreadPool& operator=(const ThreadPool& other) = delete;
+	ThreadPool& operator=(ThreadPool&& other) = delete;
+
+	/* One worker less than the number of hardware threads; the remaining one is the thread that hands out the work. */
+	static unsigned DefaultNumThreads() { return std::max(std::thread::hardware_concurrency(), 2u) - 1; }
+
+	unsigned GetNumThreads() const { return unsigned(workers.size()); }
+
+	void Enqueue(std::function<void()> job)
+	{
+		{
+			std::lock_guard lock(mutex);
+			jobs.push(std::move(job));
+		}
+		job_available.notify_one();
+	}
+
+	template<typename Func>
+	std::future<void> Submit(Func&& func)
+	{
+		auto task = std::make_shared<std::packaged_task<void()>>(std::forward<Func>(func));
+		std::future<void> future = task->get_future();
+		Enqueue([task] { (*task)(); });
+		return future;
+	}
+
+	/* Calls 'func(begin, end)' for consecutive subranges covering [0, count), and returns once all of them have finished. */
+	void ParallelFor(size_t count, const std::function<void(size_t, size_t)>& func)
+	{
+		const size_t num_bands = std::min(count, workers.size() + 1);
+		if (num_bands <= 1)
+		{
+			if (count > 0)
+				func(0, count);
+			return;
+		}
+
+		struct Bands
+		{
+			std::atomic<size_t> next{ 0 };
+			std::atomic<size_t> remaining;
+			std::mutex mutex;
+			std::condition_variable finished;
+		};
+		auto bands = std::make_shared<Bands>();
+		bands->remaining = num_bands;
+
+		/* 'func' is captured by reference; this is safe, since it is only called for bands that have not yet been
+		   handed out, and we do not return before every band that has been handed out has finished. */
+		auto process_bands = [bands, &func, count, num_bands] {
+			size_t band;
+			while ((band = bands->next++) < num_bands)
+			{
+				func(count * band / num_bands, count * (band + 1) / num_bands);
+				if (--bands->remaining == 0)
+				{
+					std::lock_guard lock(bands->mutex);
+					bands->finished.notify_all();
+				}
+			}
+		};
+
+		for (size_t i = 0; i < num_bands - 1; i++)
+			Enqueue(process_bands);
+		process_bands();
+
+		std::unique_lock lock(bands->mutex);
+		bands->finished.wait(lock, [&] { return bands->remaining == 0; });
+	}
+
+private:
+	bool stopping = false;
+
+	std::condition_variable job_available;
+	std::mutex mutex;
+	std::queue<std::function<void()>> jobs;
+	std::vector<std::thread> workers;
+
+	void WorkerLoop()
+	{
+		while (true)
+		{
+			std::function<void()> job;
+			{
+				std::unique_lock lock(mutex);
+				job_available.wait(lock, [this] { return stopping || !jobs.empty(); });
+				if (stopping && jobs.empty())
+					return;
+				job = std::move(jobs.front());
+				jobs.pop();
+			}
+			job();
+		}
+	}
+};
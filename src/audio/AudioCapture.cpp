@@ -0,0 +1,247 @@
+#include "AudioCapture.h"
+
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <cmath>
+#include <filesystem>
+#include <limits>
+
+
+AudioCapture::~AudioCapture()
+{
+	Stop();
+}
+
+
+std::optional<AudioCapture::Format> AudioCapture::GetFormatFromPath(const std::string& path)
+{
+	std::string extension = std::filesystem::path(path).extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+	if (extension == ".wav") return Format::WAV;
+	if (extension == ".raw" || extension == ".pcm") return Format::Raw;
+	return std::nullopt;
+}
+
+
+std::string AudioCapture::GetStemPath(const std::string& path, const Stem stem)
+{
+	static constexpr const char* stem_names[num_stems] = { "pulse1", "pulse2", "triangle", "noise", "dmc" };
+	std::filesystem::path stem_path = path;
+	stem_path.replace_filename(stem_path.stem().string() + "_" + stem_names[static_cast<unsigned>(stem)] + stem_path.extension().string());
+	return stem_path.string();
+}
+
+
+bool AudioCapture::Start(const std::string& path, const Format format, const SampleFormat sample_format,
+	const unsigned sample_rate, const unsigned num_channels, const bool record_stems)
+{
+	Stop();
+
+	this->format = format;
+	this->sample_format = sample_format;
+	this->sample_rate = sample_rate;
+	this->record_stems = record_stems;
+
+	buffers.assign(num_buffers, Block{});
+	free_buffers.clear();
+	for (unsigned i = 0; i < num_buffers; i++)
+		free_buffers.push_back(i);
+	queue = {};
+	stopping = false;
+	write_failed = false;
+
+	/* The files are opened here rather than on the writer thread, so that failing to open one can be reported right away. */
+	outputs = std::vector<Output>(record_stems ? 1 + num_stems : 1);
+	bool opened = OpenOutput(outputs[0], path, num_channels);
+	for (unsigned i = 0; opened && record_stems && i < num_stems; i++)
+		opened = OpenOutput(outputs[1 + i], GetStemPath(path, static_cast<Stem>(i)), 1);
+	if (!opened)
+	{
+		outputs.clear();
+		return false;
+	}
+
+	capturing = true;
+	writer_thread = std::thread([this] { WriterLoop(); });
+	return true;
+}
+
+
+bool AudioCapture::Stop()
+{
+	if (!capturing)
+		return true;
+
+	{
+		std::lock_guard lock(mutex);
+		stopping = true;
+	}
+	block_available.notify_one();
+	writer_thread.join();
+
+	for (Output& output : outputs)
+		FinishOutput(output);
+	outputs.clear();
+	capturing = false;
+	return !write_failed;
+}
+
+
+void AudioCapture::PushBlock(const f32* mixed_samples, const size_t num_frames, const std::array<const f32*, num_stems>& stem_samples)
+{
+	std::unique_lock lock(mutex);
+	buffer_available.wait(lock, [&] { return !free_buffers.empty(); });
+	const unsigned buffer_index = free_buffers.back();
+	free_buffers.pop_back();
+
+	/* The buffer is not shared with the writer thread until it has been queued, so the copy can be made without holding the lock. */
+	lock.unlock();
+	Block& block = buffers[buffer_index];
+	block.num_frames = num_frames;
+	block.mixed_samples.assign(mixed_samples, mixed_samples + num_frames * outputs[0].num_channels);
+	if (record_stems)
+	{
+		for (unsigned i = 0; i < num_stems; i++)
+			block.stem_samples[i].assign(stem_samples[i], stem_samples[i] + num_frames);
+	}
+	lock.lock();
+
+	queue.push(buffer_index);
+	lock.unlock();
+	block_available.notify_one();
+}
+
+
+bool AudioCapture::OpenOutput(Output& output, const std::string& path, const unsigned num_channels)
+{
+	output.ofs.open(path, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+	output.num_channels = num_channels;
+	output.num_frames_written = 0;
+	if (format == Format::WAV)
+		WriteWAVHeader(output);
+	return output.ofs && !write_failed;
+}
+
+
+void AudioCapture::FinishOutput(Output& output)
+{
+	if (format == Format::WAV && !write_failed)
+	{
+		/* WAV sizes are 32-bit; a longer recording is still written in full, but readers will only see the first 4 GiB of it. */
+		const u64 data_size = output.num_frames_written * output.num_channels * GetBytesPerSample();
+		const u64 riff_size = data_size + output.data_size_offset + 4 - 8;
+		auto PatchU32 = [&](std::streamoff offset, u64 value) {
+			const u32 clamped = u32(std::min(value, u64(std::numeric_limits<u32>::max())));
+			const u8 bytes[4] = { u8(clamped), u8(clamped >> 8), u8(clamped >> 16), u8(clamped >> 24) };
+			output.ofs.seekp(offset);
+			Write(output, bytes, 4);
+		};
+		PatchU32(output.riff_size_offset, riff_size);
+		if (output.fact_num_frames_offset.has_value())
+			PatchU32(output.fact_num_frames_offset.value(), output.num_frames_written);
+		PatchU32(output.data_size_offset, data_size);
+	}
+	output.ofs.close();
+}
+
+
+void AudioCapture::WriterLoop()
+{
+	while (true)
+	{
+		unsigned buffer_index;
+		{
+			std::unique_lock lock(mutex);
+			block_available.wait(lock, [&] { return stopping || !queue.empty(); });
+			if (queue.empty())
+				return;
+			buffer_index = queue.front();
+			queue.pop();
+		}
+
+		const Block& block = buffers[buffer_index];
+		WriteSamples(outputs[0], block.mixed_samples.data(), block.num_frames);
+		for (unsigned i = 0; record_stems && i < num_stems; i++)
+			WriteSamples(outputs[1 + i], block.stem_samples[i].data(), block.num_frames);
+
+		{
+			std::lock_guard lock(mutex);
+			free_buffers.push_back(buffer_index);
+		}
+		buffer_available.notify_one();
+	}
+}
+
+
+void AudioCapture::Write(Output& output, const void* data, const size_t size)
+{
+	if (write_failed)
+		return;
+	output.ofs.write(static_cast<const char*>(data), size);
+	if (!output.ofs)
+		write_failed = true;
+}
+
+
+void AudioCapture::WriteSamples(Output& output, const f32* samples, const size_t num_frames)
+{
+	/* Both WAV and the raw format are little-endian. */
+	static_assert(std::endian::native == std::endian::little);
+	const size_t num_samples = num_frames * output.num_channels;
+	if (sample_format == SampleFormat::F32)
+	{
+		Write(output, samples, num_samples * sizeof(f32));
+	}
+	else
+	{
+		/* Scaled like the float samples, with 1.0 as full scale, so that both formats hold the same signal. */
+		converted_samples.resize(num_samples * sizeof(s16));
+		s16* out = reinterpret_cast<s16*>(converted_samples.data());
+		for (size_t i = 0; i < num_samples; i++)
+			out[i] = s16(std::clamp(std::lround(samples[i] * 32767.f), -32768l, 32767l));
+		Write(output, converted_samples.data(), converted_samples.size());
+	}
+	output.num_frames_written += num_frames;
+}
+
+
+void AudioCapture::WriteWAVHeader(Output& output)
+{
+	/* Layout: RIFF 'WAVE' { 'fmt ', ['fact',] 'data' }. Float samples need the extended 'fmt ' chunk and a 'fact' chunk. */
+	const bool is_float = sample_format == SampleFormat::F32;
+	const u16 bits_per_sample = u16(8 * GetBytesPerSample());
+	const u16 block_align = u16(output.num_channels * GetBytesPerSample());
+
+	std::vector<u8> header;
+	auto FourCC = [&](const char* fourcc) { header.insert(header.end(), fourcc, fourcc + 4); };
+	auto U32 = [&](u32 value) { header.insert(header.end(), { u8(value), u8(value >> 8), u8(value >> 16), u8(value >> 24) }); };
+	auto U16 = [&](u16 value) { header.insert(header.end(), { u8(value), u8(value >> 8) }); };
+
+	FourCC("RIFF");
+	output.riff_size_offset = header.size();
+	U32(0); FourCC("WAVE");
+
+	FourCC("fmt "); U32(is_float ? 18 : 16);
+	U16(is_float ? 3 : 1); /* WAVE_FORMAT_IEEE_FLOAT or WAVE_FORMAT_PCM */
+	U16(u16(output.num_channels));
+	U32(sample_rate);
+	U32(sample_rate * block_align); /* bytes per second */
+	U16(block_align);
+	U16(bits_per_sample);
+	if (is_float)
+	{
+		U16(0); /* size of the extension */
+		FourCC("fact"); U32(4);
+		output.fact_num_frames_offset = header.size();
+		U32(0);
+	}
+	else
+		output.fact_num_frames_offset.reset();
+
+	FourCC("data");
+	output.data_size_offset = header.size();
+	U32(0);
+
+	Write(output, header.data(), header.size());
+}
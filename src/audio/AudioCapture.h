@@ -0,0 +1,107 @@
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../Types.h"
+
+/* Records the audio output by the APU to a WAV file, or to a raw stream of little-endian samples, as 16-bit integers or 32-bit floats.
+   Besides the mixed output, each channel can be recorded on its own to a mono file next to it, named <name>_<channel><extension>.
+   Since the APU mixer is not linear, the channel files do not add up to the mixed one; each holds the level that the channel
+   alone would make the mixer output.
+   Blocks of samples are copied into a fixed set of buffers and handed to a writer thread, so that the emulation thread never
+   converts or writes anything. Recording is driven by the samples the APU makes rather than by the audio device, so that it works
+   the same whether audio is played or not, and at any speed; when the writer falls behind, the emulation waits for it. */
+class AudioCapture
+{
+public:
+	enum class Format { WAV, Raw };
+	enum class SampleFormat { S16, F32 };
+	enum class Stem { Pulse1, Pulse2, Triangle, Noise, DMC };
+
+	static constexpr unsigned num_stems = 5;
+
+	AudioCapture() = default;
+	~AudioCapture();
+	AudioCapture(const AudioCapture& other) = delete;
+	AudioCapture(AudioCapture&& other) = delete;
+
+	AudioCapture& operator=(const AudioCapture& other) = delete;
+	AudioCapture& operator=(AudioCapture&& other) = delete;
+
+	/* Deduces the format from the file extension (.wav, or .raw/.pcm). */
+	static std::optional<Format> GetFormatFromPath(const std::string& path);
+	static std::string GetStemPath(const std::string& path, Stem stem);
+
+	[[nodiscard]] bool Start(const std::string& path, Format format, SampleFormat sample_format,
+		unsigned sample_rate, unsigned num_channels, bool record_stems);
+	/* Waits for every queued block to be written, and closes the files. Returns false if anything could not be written. */
+	bool Stop();
+	bool IsCapturing() const { return capturing; }
+	bool IsRecordingStems() const { return capturing && record_stems; }
+
+	/* Queues 'num_frames' frames of interleaved samples of the mixed output, and, if the channels are recorded,
+	   'num_frames' samples of each of them, in the order of 'Stem'. */
+	void PushBlock(const f32* mixed_samples, size_t num_frames, const std::array<const f32*, num_stems>& stem_samples);
+
+private:
+	static constexpr unsigned num_buffers = 16;
+
+	struct Block
+	{
+		size_t num_frames = 0;
+		std::vector<f32> mixed_samples;
+		std::array<std::vector<f32>, num_stems> stem_samples;
+	};
+
+	struct Output
+	{
+		std::ofstream ofs;
+		unsigned num_channels = 0;
+		u64 num_frames_written = 0;
+		/* WAV: where the sizes that are only known at the end go. */
+		std::streamoff riff_size_offset = 0;
+		std::optional<std::streamoff> fact_num_frames_offset;
+		std::streamoff data_size_offset = 0;
+	};
+
+	bool capturing = false;
+	bool stopping = false;
+	bool record_stems = false;
+	bool write_failed = false; /* Only accessed by the writer thread while it is running. */
+
+	Format format;
+	SampleFormat sample_format;
+	unsigned sample_rate;
+
+	/* The mixed output first, followed by the channels if they are recorded. */
+	std::vector<Output> outputs;
+
+	std::vector<Block> buffers;
+	std::vector<unsigned> free_buffers;
+	std::queue<unsigned> queue;
+	std::mutex mutex;
+	std::condition_variable buffer_available;
+	std::condition_variable block_available;
+	std::thread writer_thread;
+
+	/* Writer thread state */
+	std::vector<u8> converted_samples;
+
+	unsigned GetBytesPerSample() const { return sample_format == SampleFormat::S16 ? 2 : 4; }
+
+	bool OpenOutput(Output& output, const std::string& path, unsigned num_channels);
+	void FinishOutput(Output& output);
+	void WriterLoop();
+	void Write(Output& output, const void* data, size_t size);
+	void WriteSamples(Output& output, const f32* samples, size_t num_frames);
+	void WriteWAVHeader(Output& output);
+};
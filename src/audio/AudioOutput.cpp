@@ -0,0 +1,146 @@
+#include "AudioOutput.h"
+
+#include <algorithm>
+#include <thread>
+
+
+AudioOutput::AudioOutput(const unsigned default_sample_rate, const unsigned default_num_channels, const unsigned frames_per_block) :
+	sample_rate(default_sample_rate),
+	num_channels(default_num_channels),
+	frames_per_block(frames_per_block),
+	target_latency_in_frames(target_latency_in_blocks * frames_per_block),
+	ring_buffer(ring_buffer_size_in_blocks * frames_per_block * max_num_channels),
+	last_frame(default_num_channels)
+{
+}
+
+
+AudioOutput::~AudioOutput()
+{
+	Close();
+}
+
+
+bool AudioOutput::Open()
+{
+	if (device_id != 0)
+		return true;
+
+	SDL_AudioSpec desired_spec;
+	SDL_zero(desired_spec);
+	desired_spec.freq = sample_rate;
+	desired_spec.format = AUDIO_F32;
+	desired_spec.channels = num_channels;
+	desired_spec.samples = frames_per_block;
+	desired_spec.callback = AudioCallback;
+	desired_spec.userdata = this;
+
+	/* The rate and the number of channels are taken as the device has them; the APU makes its output at that rate to begin with,
+	   which is better than having SDL resample it again. The sample format is always converted by SDL if need be, which is cheap. */
+	SDL_AudioSpec obtained_spec;
+	device_id = SDL_OpenAudioDevice(nullptr, 0, &desired_spec, &obtained_spec,
+		SDL_AUDIO_ALLOW_FREQUENCY_CHANGE | SDL_AUDIO_ALLOW_CHANNELS_CHANGE);
+	if (device_id == 0)
+	{
+		const char* error_msg = SDL_GetError();
+		UserMessage::Show(std::format("Could not open an audio device; {}", error_msg), UserMessage::Type::Warning);
+		return false;
+	}
+	if (obtained_spec.channels > max_num_channels)
+	{
+		UserMessage::Show(std::format("The audio device has {} channels, which is more than are supported.", obtained_spec.channels), UserMessage::Type::Warning);
+		SDL_CloseAudioDevice(device_id);
+		device_id = 0;
+		return false;
+	}
+	sample_rate = obtained_spec.freq;
+	num_channels = obtained_spec.channels;
+	last_frame.assign(num_channels, 0.f);
+	SDL_PauseAudioDevice(device_id, 0);
+	return true;
+}
+
+
+void AudioOutput::Close()
+{
+	if (device_id != 0)
+	{
+		/* Returns once the callback is no longer running. */
+		SDL_CloseAudioDevice(device_id);
+		device_id = 0;
+	}
+}
+
+
+void AudioOutput::Submit(const f32* samples, const size_t num_frames)
+{
+	if (device_id == 0)
+	{
+		WaitForBlockDuration();
+		return;
+	}
+
+	/* Only whole frames are pushed, so that the callback never sees half of one. Should the buffer somehow be full, the rest is dropped. */
+	const size_t num_frames_to_push = std::min(num_frames, ring_buffer.GetNumFree() / num_channels);
+	ring_buffer.Push(samples, num_frames_to_push * num_channels);
+
+	/* The buffer only ever shrinks while waiting, so the amount to sleep for can be computed up front and then checked again.
+	   Should the device stop asking for samples (e.g. if it is unplugged), the wait is given up on a target latency's worth of time after it should have ended. */
+	size_t num_buffered_frames = GetNumBufferedFrames();
+	const auto give_up_time_point = std::chrono::steady_clock::now() + std::chrono::duration<double>(
+		double(num_buffered_frames + target_latency_in_frames) / sample_rate);
+	while (num_buffered_frames > target_latency_in_frames && std::chrono::steady_clock::now() < give_up_time_point)
+	{
+		const auto excess = std::chrono::duration<double>(double(num_buffered_frames - target_latency_in_frames) / sample_rate);
+		std::this_thread::sleep_for(excess);
+		num_buffered_frames = GetNumBufferedFrames();
+	}
+	next_block_time_point = std::chrono::steady_clock::now();
+}
+
+
+double AudioOutput::GetRateAdjustment() const
+{
+	if (device_id == 0)
+		return 1.0;
+	/* Below the target, more samples are made per emulated second, which fills up the buffer at the same emulation speed. */
+	const double deviation = (double(target_latency_in_frames) - double(GetNumBufferedFrames())) / double(target_latency_in_frames);
+	return 1.0 + max_rate_adjustment * std::clamp(deviation, -1.0, 1.0);
+}
+
+
+void AudioOutput::WaitForBlockDuration()
+{
+	/* Without a device, the speed is kept by the clock alone. If the emulation has fallen far behind, it does not try to catch up. */
+	const auto block_duration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+		std::chrono::duration<double>(double(frames_per_block) / sample_rate));
+	next_block_time_point = std::max(next_block_time_point + block_duration,
+		std::chrono::steady_clock::now() - target_latency_in_blocks * block_duration);
+	std::this_thread::sleep_until(next_block_time_point);
+}
+
+
+void SDLCALL AudioOutput::AudioCallback(void* userdata, Uint8* stream, int len)
+{
+	AudioOutput* output = static_cast<AudioOutput*>(userdata);
+	output->FillDeviceBuffer(reinterpret_cast<f32*>(stream), size_t(len) / sizeof(f32) / output->num_channels);
+}
+
+
+void AudioOutput::FillDeviceBuffer(f32* out, const size_t num_frames)
+{
+	/* Runs on SDL's audio thread; nothing here may block. */
+	const size_t num_frames_available = std::min(num_frames, GetNumBufferedFrames());
+	ring_buffer.Pop(out, num_frames_available * num_channels);
+	if (num_frames_available > 0)
+		std::copy(out + (num_frames_available - 1) * num_channels, out + num_frames_available * num_channels, last_frame.begin());
+
+	/* Holding the last level rather than dropping to zero keeps an underrun from stepping the output, which would be heard as a click;
+	   the high-pass filters (see OutputFilter) centre it on zero over time, not at every sample. */
+	if (num_frames_available < num_frames)
+	{
+		for (size_t frame = num_frames_available; frame < num_frames; frame++)
+			std::copy(last_frame.begin(), last_frame.end(), out + frame * num_channels);
+		num_underruns.fetch_add(1, std::memory_order_relaxed);
+	}
+}
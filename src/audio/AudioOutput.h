@@ -0,0 +1,82 @@
+#pragma once
+
+#include "SDL.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <format>
+#include <vector>
+
+#include "../Types.h"
+
+#include "../gui/UserMessage.h"
+
+#include "SPSCRingBuffer.h"
+
+/* Plays the samples output by the APU through an SDL audio device, and paces the emulation by it.
+   Samples are handed over through a lock-free ring buffer that the device's callback reads from, so that the emulation thread
+   never blocks on the device and the callback never blocks on the emulation thread. When more than the target latency of audio is
+   buffered, Submit sleeps until the device has played enough of it; the emulation thus runs at the speed at which the device plays.
+   Since sleeping is coarse, and the emulation may at times fall behind, the fill level drifts from the target. To bring it back
+   without the device running dry (which crackles), the rate at which samples are made from emulated time is nudged up or down by
+   a fraction of a percent in proportion to the deviation (see GetRateAdjustment); a change far too small to be heard as a change in pitch.
+   When there is no device, Submit sleeps for as long as the samples would have taken to play instead.
+   The device is opened at whatever rate and number of channels it prefers (see GetSampleRate and GetNumChannels);
+   the samples given to Submit must be in that format, so that SDL does not have to resample them. */
+class AudioOutput
+{
+public:
+	/* The rate and the number of channels asked for when opening the device, and used when there is none. */
+	AudioOutput(unsigned default_sample_rate, unsigned default_num_channels, unsigned frames_per_block);
+	~AudioOutput();
+	AudioOutput(const AudioOutput& other) = delete;
+	AudioOutput(AudioOutput&& other) = delete;
+
+	AudioOutput& operator=(const AudioOutput& other) = delete;
+	AudioOutput& operator=(AudioOutput&& other) = delete;
+
+	/* Returns true on success, otherwise false. */
+	bool Open();
+	void Close();
+	bool IsOpen() const { return device_id != 0; }
+
+	unsigned GetSampleRate() const { return sample_rate; }
+	unsigned GetNumChannels() const { return num_channels; }
+
+	/* Queues 'num_frames' frames of interleaved samples for playback, and then waits until no more than the target latency is buffered. */
+	void Submit(const f32* samples, size_t num_frames);
+
+	/* The factor to multiply the nominal sample rate by for the next block, given how much audio is currently buffered. */
+	double GetRateAdjustment() const;
+
+	/* The number of times that the device has asked for more samples than were buffered. */
+	u64 GetNumUnderruns() const { return num_underruns.load(std::memory_order_relaxed); }
+
+private:
+	static constexpr unsigned target_latency_in_blocks = 4;
+	static constexpr unsigned ring_buffer_size_in_blocks = 16;
+	static constexpr double max_rate_adjustment = 0.005;
+	static constexpr unsigned max_num_channels = 8; /* 7.1 */
+
+	unsigned sample_rate;
+	unsigned num_channels;
+	const unsigned frames_per_block;
+	const size_t target_latency_in_frames;
+
+	SDL_AudioDeviceID device_id = 0;
+
+	SPSCRingBuffer<f32> ring_buffer;
+
+	/* Used by the callback only. The last frame played, which is repeated when the buffer runs dry. */
+	std::vector<f32> last_frame;
+
+	std::atomic<u64> num_underruns = 0;
+
+	std::chrono::steady_clock::time_point next_block_time_point = std::chrono::steady_clock::now();
+
+	static void SDLCALL AudioCallback(void* userdata, Uint8* stream, int len);
+	void FillDeviceBuffer(f32* out, size_t num_frames);
+	size_t GetNumBufferedFrames() const { return ring_buffer.GetNumElements() / num_channels; }
+	void WaitForBlockDuration();
+};
@@ -0,0 +1,137 @@
+#include "BlipBuffer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <numbers>
+
+
+BlipBuffer::BlipBuffer(const size_t max_num_samples) :
+	max_num_samples(max_num_samples),
+	buffer(max_num_samples + kernel_width)
+{
+}
+
+
+void BlipBuffer::SetRates(const double clock_rate, const double sample_rate)
+{
+	/* Rounded up, so that GetClocksNeeded never asks for too few clocks. */
+	factor = u64(std::ceil(sample_rate / clock_rate * double(1ull << time_frac_bits)));
+	Clear();
+}
+
+
+void BlipBuffer::Clear()
+{
+	offset = 0;
+	integrator = 0;
+	std::fill(buffer.begin(), buffer.end(), 0);
+}
+
+
+void BlipBuffer::ClearAndSyncWith(const BlipBuffer& other)
+{
+	Clear();
+	factor = other.factor;
+	offset = other.offset;
+}
+
+
+void BlipBuffer::AddDelta(const u32 clock_time, const f32 delta)
+{
+	const u64 time = clock_time * factor + offset;
+	const size_t sample_index = size_t(time >> time_frac_bits);
+	const unsigned phase = unsigned(time >> (time_frac_bits - phase_bits)) & (num_phases - 1);
+	assert(sample_index + kernel_width <= buffer.size());
+
+	const s64 fixed_delta = std::lround(delta * f32(1 << amplitude_unit_bits));
+	const std::array<s16, kernel_width>& kernel = GetKernel()[phase];
+	s64* dst = &buffer[sample_index];
+	for (unsigned tap = 0; tap < kernel_width; tap++)
+		dst[tap] += fixed_delta * kernel[tap];
+}
+
+
+void BlipBuffer::EndFrame(const u32 clock_duration)
+{
+	offset += clock_duration * factor;
+	assert(GetNumSamplesAvailable() <= max_num_samples);
+}
+
+
+u32 BlipBuffer::GetClocksNeeded(const size_t num_samples) const
+{
+	const u64 needed_time = u64(num_samples) << time_frac_bits;
+	if (needed_time <= offset)
+		return 0;
+	return u32((needed_time - offset + factor - 1) / factor);
+}
+
+
+size_t BlipBuffer::ReadSamples(f32* out, size_t max_num_samples, const size_t stride)
+{
+	constexpr f32 scale = 1.f / f32(1ull << (kernel_unit_bits + amplitude_unit_bits));
+	const size_t num_samples = std::min(max_num_samples, GetNumSamplesAvailable());
+	for (size_t i = 0; i < num_samples; i++)
+	{
+		integrator += buffer[i];
+		out[i * stride] = f32(integrator) * scale;
+	}
+
+	/* Move the deltas that lie beyond what was read (those of the current frame, and the tails of the kernels) to the start. */
+	std::copy(buffer.begin() + num_samples, buffer.end(), buffer.begin());
+	std::fill(buffer.end() - num_samples, buffer.end(), 0);
+	offset -= u64(num_samples) << time_frac_bits;
+	return num_samples;
+}
+
+
+const BlipBuffer::Kernel& BlipBuffer::GetKernel()
+{
+	static const Kernel kernel = MakeKernel();
+	return kernel;
+}
+
+
+BlipBuffer::Kernel BlipBuffer::MakeKernel()
+{
+	/* Sample the Blackman-windowed sinc impulse finely, at 'num_phases' points per sample. Each tap of the kernel for phase p
+	   is then the integral of the impulse over the one sample long interval that the tap covers, when the step is p / num_phases
+	   of a sample past the sample boundary. This is the difference between two consecutive samples of a band-limited step. */
+	constexpr double pi = std::numbers::pi;
+	constexpr double half_width = kernel_width / 2;
+	std::vector<double> impulse(kernel_width * num_phases);
+	for (size_t i = 0; i < impulse.size(); i++)
+	{
+		const double t = (i + 0.5) / num_phases - half_width; /* in samples */
+		const double x = pi * cutoff * t;
+		const double sinc = x == 0 ? 1.0 : std::sin(x) / x;
+		const double window = 0.42 + 0.5 * std::cos(pi * t / half_width) + 0.08 * std::cos(2 * pi * t / half_width);
+		impulse[i] = cutoff * sinc * window;
+	}
+
+	Kernel kernel{};
+	for (int phase = 0; phase < int(num_phases); phase++)
+	{
+		std::array<double, kernel_width> taps{};
+		double sum = 0;
+		for (int tap = 0; tap < int(kernel_width); tap++)
+		{
+			const int first = tap * int(num_phases) - phase;
+			for (int i = std::max(first, 0); i < std::min(first + int(num_phases), int(impulse.size())); i++)
+				taps[tap] += impulse[i];
+			sum += taps[tap];
+		}
+
+		/* Normalize every phase on its own, and put the rounding error on the largest tap, so that a step always adds up to its full height. */
+		int int_sum = 0;
+		for (unsigned tap = 0; tap < kernel_width; tap++)
+		{
+			kernel[phase][tap] = s16(std::lround(taps[tap] / sum * (1 << kernel_unit_bits)));
+			int_sum += kernel[phase][tap];
+		}
+		s16& largest_tap = *std::max_element(kernel[phase].begin(), kernel[phase].end());
+		largest_tap = s16(largest_tap + (1 << kernel_unit_bits) - int_sum);
+	}
+	return kernel;
+}
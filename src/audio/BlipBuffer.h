@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+#include "../Types.h"
+
+/* Band-limited synthesis of a signal made up of steps, in the style of blip_buf.
+   Instead of taking instantaneous samples of the signal (which aliases every step that does not fall on a sample boundary),
+   every change in amplitude is added as a delta at the exact clock cycle it happens on. Each delta is spread over 'kernel_width'
+   samples through a windowed sinc kernel, chosen from 'num_phases' kernels by where between two samples the step falls.
+   The buffer holds the differences between consecutive samples, and is integrated when the samples are read out.
+   Everything is done in integer arithmetic, so that the integrated output never drifts from the sum of the deltas.
+
+   Clock times are given relative to the start of the current frame, which is ended with 'EndFrame'. A frame can be of any length,
+   as long as the samples it produces fit in the buffer along with those not yet read. */
+class BlipBuffer
+{
+public:
+	explicit BlipBuffer(size_t max_num_samples);
+
+	void SetRates(double clock_rate, double sample_rate);
+	void Clear();
+	/* Clears the buffer, and takes over the rates of 'other' and its position within the current frame,
+	   so that from then on, the two make the same number of samples out of every frame. */
+	void ClearAndSyncWith(const BlipBuffer& other);
+
+	/* Adds a change in amplitude of 'delta' (1.0 being full scale) at 'clock_time' clocks into the current frame. */
+	void AddDelta(u32 clock_time, f32 delta);
+	/* Ends the current frame after 'clock_duration' clocks, making the samples up until then available for reading. */
+	void EndFrame(u32 clock_duration);
+
+	size_t GetNumSamplesAvailable() const { return size_t(offset >> time_frac_bits); }
+	/* The number of clocks that the current frame must run for before 'num_samples' samples are available. */
+	u32 GetClocksNeeded(size_t num_samples) const;
+
+	/* Reads up to 'max_num_samples' samples, and writes them to every 'stride':th element of 'out'. Returns the number of samples read. */
+	size_t ReadSamples(f32* out, size_t max_num_samples, size_t stride = 1);
+
+private:
+	static constexpr unsigned time_frac_bits = 32;
+	static constexpr unsigned phase_bits = 5;
+	static constexpr unsigned num_phases = 1 << phase_bits;
+	static constexpr unsigned kernel_width = 16; /* samples */
+	static constexpr unsigned kernel_unit_bits = 15; /* The taps of every kernel phase add up to exactly 1 << kernel_unit_bits. */
+	static constexpr unsigned amplitude_unit_bits = 16; /* Deltas are stored in units of 2^-16 of full scale. */
+	static constexpr double cutoff = 0.9; /* As a fraction of the Nyquist frequency */
+
+	using Kernel = std::array<std::array<s16, kernel_width>, num_phases>;
+
+	static const Kernel& GetKernel();
+	static Kernel MakeKernel();
+
+	u64 factor = 0; /* Samples per clock, in units of 2^-time_frac_bits samples */
+	u64 offset = 0; /* Time of the start of the current frame, relative to the first unread sample, in the same units */
+	s64 integrator = 0;
+	size_t max_num_samples;
+	std::vector<s64> buffer;
+};
@@ -0,0 +1,58 @@
+#include "OutputFilter.h"
+
+#include <cmath>
+#include <numbers>
+
+
+void OutputFilter::Configure(const double sample_rate)
+{
+	const std::array<Coefficients, 4> stages = {
+		MakeHighPass(90, sample_rate),
+		MakeHighPass(440, sample_rate),
+		MakeLowPass(14000, sample_rate),
+		Coefficients{}
+	};
+	b0 = _mm_setr_ps(stages[0].b0, stages[1].b0, stages[2].b0, stages[3].b0);
+	b1 = _mm_setr_ps(stages[0].b1, stages[1].b1, stages[2].b1, stages[3].b1);
+	b2 = _mm_setr_ps(stages[0].b2, stages[1].b2, stages[2].b2, stages[3].b2);
+	a1 = _mm_setr_ps(stages[0].a1, stages[1].a1, stages[2].a1, stages[3].a1);
+	a2 = _mm_setr_ps(stages[0].a2, stages[1].a2, stages[2].a2, stages[3].a2);
+	Reset();
+}
+
+
+void OutputFilter::Reset()
+{
+	s1 = s2 = y = _mm_setzero_ps();
+}
+
+
+void OutputFilter::Process(f32* samples, const size_t num_samples)
+{
+	for (size_t i = 0; i < num_samples; i++)
+	{
+		/* Every stage takes the output of the stage before it from the last step; the first one takes the new sample. */
+		const __m128 x = _mm_move_ss(_mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(y), 4)), _mm_set_ss(samples[i]));
+		y = _mm_add_ps(_mm_mul_ps(b0, x), s1);
+		s1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1, x), _mm_mul_ps(a1, y)), s2);
+		s2 = _mm_sub_ps(_mm_mul_ps(b2, x), _mm_mul_ps(a2, y));
+		samples[i] = _mm_cvtss_f32(_mm_shuffle_ps(y, y, _MM_SHUFFLE(num_stages - 1, num_stages - 1, num_stages - 1, num_stages - 1)));
+	}
+}
+
+
+OutputFilter::Coefficients OutputFilter::MakeHighPass(const double cutoff, const double sample_rate)
+{
+	const double k = std::tan(std::numbers::pi * cutoff / sample_rate);
+	return Coefficients{ f32(1 / (1 + k)), f32(-1 / (1 + k)), 0, f32((k - 1) / (k + 1)), 0 };
+}
+
+
+OutputFilter::Coefficients OutputFilter::MakeLowPass(const double cutoff, const double sample_rate)
+{
+	/* At output rates this low, the resampler has already removed everything above the cutoff. */
+	if (cutoff >= 0.45 * sample_rate)
+		return Coefficients{};
+	const double k = std::tan(std::numbers::pi * cutoff / sample_rate);
+	return Coefficients{ f32(k / (1 + k)), f32(k / (1 + k)), 0, f32((k - 1) / (k + 1)), 0 };
+}
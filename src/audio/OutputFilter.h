@@ -0,0 +1,41 @@
+#pragma once
+
+#include <emmintrin.h>
+
+#include <array>
+#include <cstddef>
+
+#include "../Types.h"
+
+/* The filters between the APU's mixer and the audio output of an NES: a high-pass at about 90 Hz, another at about 440 Hz,
+   and a low-pass at about 14 kHz (https://wiki.nesdev.org/w/index.php?title=APU_Mixer). Besides shaping the sound, the high-passes
+   remove the DC offset of the mixer output, centring it around zero.
+
+   Each filter is a first-order section (a biquad whose second-order coefficients are zero), from the bilinear transform of an RC filter.
+   The three are run as a cascade in the lanes of one SSE register: on every step, lane k filters the sample that lane k - 1 output
+   on the step before, so that all stages are computed with the same few vector instructions, and the whole block is run through
+   the cascade in a single pass. This pipelining delays the output by 'num_stages' - 1 samples. */
+class OutputFilter
+{
+public:
+	/* Resets the state. */
+	void Configure(double sample_rate);
+	void Reset();
+
+	/* Filters 'num_samples' samples in place. */
+	void Process(f32* samples, size_t num_samples);
+
+private:
+	static constexpr unsigned num_stages = 3;
+
+	/* Per lane (stage); the unused fourth lane passes its input through. In transposed direct form II:
+	   y = b0 * x + s1, s1' = b1 * x - a1 * y + s2, s2' = b2 * x - a2 * y. */
+	__m128 b0 = _mm_set1_ps(1.f), b1 = _mm_setzero_ps(), b2 = _mm_setzero_ps(), a1 = _mm_setzero_ps(), a2 = _mm_setzero_ps();
+	__m128 s1 = _mm_setzero_ps(), s2 = _mm_setzero_ps();
+	__m128 y = _mm_setzero_ps(); /* The output of every stage on the last step */
+
+	struct Coefficients { f32 b0 = 1, b1 = 0, b2 = 0, a1 = 0, a2 = 0; };
+
+	static Coefficients MakeHighPass(double cutoff, double sample_rate);
+	static Coefficients MakeLowPass(double cutoff, double sample_rate);
+};
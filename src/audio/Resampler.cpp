@@ -0,0 +1,171 @@
+#include "Resampler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <numbers>
+
+
+void Resampler::Configure(const double input_rate, const double output_rate, const Quality quality)
+{
+	this->quality = quality;
+
+	/* The filter is designed in terms of the lower of the two rates. When going down, it spans proportionally more input samples,
+	   so that the transition band is as narrow relative to the output rate as when going up. */
+	const double ratio = std::min(1.0, output_rate / input_rate);
+	const unsigned base_num_taps = GetNumTaps(quality);
+	num_taps = (unsigned(std::ceil(base_num_taps / ratio)) + 3) & ~3u;
+
+	/* Kaiser's estimate of the transition width for a given attenuation (in dB) and length, in fractions of the lower Nyquist frequency.
+	   The cutoff is put so that the stop band starts right at the lower Nyquist frequency. */
+	const double attenuation = GetKaiserBeta(quality) / 0.1102 + 8.7;
+	const double transition_width = 2 * (attenuation - 7.95) / (14.36 * base_num_taps);
+	MakeFilter(ratio * (1.0 - transition_width / 2));
+
+	ChangeRates(input_rate, output_rate);
+	Reset();
+}
+
+
+void Resampler::ChangeRates(const double input_rate, const double output_rate)
+{
+	step = u64(std::llround(input_rate / output_rate * double(1ull << time_frac_bits)));
+}
+
+
+void Resampler::Reset()
+{
+	/* Start with the filter reaching back over silence, and the first output sample at the first input sample.
+	   (Before being configured, there is no filter to reach back with.) */
+	const unsigned half = num_taps / 2;
+	history.assign(half > 0 ? half - 1 : 0, 0.f);
+	position = u64(history.size()) << time_frac_bits;
+}
+
+
+void Resampler::ClearAndSyncWith(const Resampler& other)
+{
+	*this = other;
+	std::fill(history.begin(), history.end(), 0.f);
+}
+
+
+size_t Resampler::GetNumInputSamplesNeeded(const size_t num_output_samples) const
+{
+	if (num_output_samples == 0)
+		return 0;
+	const u64 last_position = position + (num_output_samples - 1) * step;
+	const size_t num_samples_needed = size_t(last_position >> time_frac_bits) + num_taps / 2 + 1;
+	return num_samples_needed > history.size() ? num_samples_needed - history.size() : 0;
+}
+
+
+void Resampler::Process(const f32* input, const size_t num_input_samples, f32* output, const size_t num_output_samples)
+{
+	assert(num_input_samples == GetNumInputSamplesNeeded(num_output_samples));
+	history.insert(history.end(), input, input + num_input_samples);
+
+	const unsigned half = num_taps / 2;
+	constexpr f32 phase_frac_scale = 1.f / f32(1ull << (time_frac_bits - phase_bits));
+	for (size_t i = 0; i < num_output_samples; i++)
+	{
+		const f32* samples = &history[size_t(position >> time_frac_bits) - (half - 1)];
+		const unsigned phase = unsigned(position >> (time_frac_bits - phase_bits)) & (num_phases - 1);
+		const f32 phase_frac = f32(position & ((1ull << (time_frac_bits - phase_bits)) - 1)) * phase_frac_scale;
+		const f32 a = DotProduct(samples, &filter[phase * num_taps]);
+		const f32 b = DotProduct(samples, &filter[(phase + 1) * num_taps]);
+		output[i] = a + (b - a) * phase_frac;
+		position += step;
+	}
+
+	/* Drop the input samples that the filter will not reach back to anymore. */
+	const size_t num_samples_to_drop = size_t(position >> time_frac_bits) - (half - 1);
+	history.erase(history.begin(), history.begin() + num_samples_to_drop);
+	position -= u64(num_samples_to_drop) << time_frac_bits;
+}
+
+
+f32 Resampler::DotProduct(const f32* samples, const f32* taps) const
+{
+	__m128 sum0 = _mm_setzero_ps(), sum1 = _mm_setzero_ps();
+	unsigned tap = 0;
+	for (; tap + 8 <= num_taps; tap += 8)
+	{
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(samples + tap), _mm_loadu_ps(taps + tap)));
+		sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(samples + tap + 4), _mm_loadu_ps(taps + tap + 4)));
+	}
+	if (tap < num_taps)
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(samples + tap), _mm_loadu_ps(taps + tap)));
+	__m128 sum = _mm_add_ps(sum0, sum1);
+	sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+	sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+	return _mm_cvtss_f32(sum);
+}
+
+
+void Resampler::MakeFilter(const double cutoff)
+{
+	/* 'cutoff' is in fractions of the input Nyquist frequency. Tap j of phase k is the windowed sinc at the distance between
+	   the input sample it is multiplied with and an output position k / num_phases of a sample past the centre sample. */
+	constexpr double pi = std::numbers::pi;
+	const int half = int(num_taps / 2);
+	const double beta = GetKaiserBeta(quality);
+	const double window_scale = 1.0 / BesselI0(beta);
+	filter.assign((num_phases + 1) * num_taps, 0.f);
+	std::vector<double> taps(num_taps);
+	for (unsigned phase = 0; phase <= num_phases; phase++)
+	{
+		double sum = 0;
+		for (int tap = 0; tap < int(num_taps); tap++)
+		{
+			const double t = tap - half + 1 - double(phase) / num_phases; /* in input samples */
+			const double x = pi * cutoff * t;
+			const double sinc = x == 0 ? 1.0 : std::sin(x) / x;
+			const double r = t / half;
+			const double window = r * r < 1 ? BesselI0(beta * std::sqrt(1 - r * r)) * window_scale : 0;
+			taps[tap] = cutoff * sinc * window;
+			sum += taps[tap];
+		}
+		/* Normalize every phase on its own, so that a constant input comes out unchanged at any position. */
+		for (unsigned tap = 0; tap < num_taps; tap++)
+			filter[phase * num_taps + tap] = f32(taps[tap] / sum);
+	}
+}
+
+
+unsigned Resampler::GetNumTaps(const Quality quality)
+{
+	switch (quality)
+	{
+	case Quality::Low: return 24;
+	case Quality::Medium: return 48;
+	default: return 96;
+	}
+}
+
+
+double Resampler::GetKaiserBeta(const Quality quality)
+{
+	/* Stop band attenuation of roughly 63, 81 and 99 dB */
+	switch (quality)
+	{
+	case Quality::Low: return 6;
+	case Quality::Medium: return 8;
+	default: return 10;
+	}
+}
+
+
+double Resampler::BesselI0(const double x)
+{
+	/* The power series; it converges quickly for the arguments used for Kaiser windows. */
+	double sum = 1, term = 1;
+	for (int k = 1; k < 50; k++)
+	{
+		term *= (x / (2 * k)) * (x / (2 * k));
+		sum += term;
+		if (term < sum * 1e-16)
+			break;
+	}
+	return sum;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <emmintrin.h>
+
+#include <cstddef>
+#include <vector>
+
+#include "../Types.h"
+
+/* Converts a stream of mono samples from one rate to another through a polyphase FIR filter: a Kaiser-windowed sinc,
+   tabulated at 'num_phases' fractional positions between two input samples. Each output sample is the dot product of
+   the input around its position with the two closest phases of the filter, interpolated linearly between them.
+   The dot products are computed four taps at a time with SSE2.
+   The cutoff is put just below the Nyquist frequency of the lower of the two rates, so that nothing above it folds back.
+   The quality decides the number of taps, and with it how steep the transition band is and how far the stop band is attenuated.
+
+   Output is made in blocks of a given size; GetNumInputSamplesNeeded tells how many input samples must be given for the next block.
+   Since the filter is centred on the output position, the output lags the input by half the filter length. */
+class Resampler
+{
+public:
+	enum class Quality { Low, Medium, High };
+
+	/* Resets the stream. */
+	void Configure(double input_rate, double output_rate, Quality quality);
+	/* Changes the ratio of the rates from the next block on, keeping the stream and the filter (which was designed for the configured rates). */
+	void ChangeRates(double input_rate, double output_rate);
+	void Reset();
+	/* Takes over the configuration and the position in the stream of 'other', but with silence as the input so far,
+	   so that from then on, the two need the same number of input samples for every block. */
+	void ClearAndSyncWith(const Resampler& other);
+
+	Quality GetQuality() const { return quality; }
+
+	size_t GetNumInputSamplesNeeded(size_t num_output_samples) const;
+	/* 'num_input_samples' must be what GetNumInputSamplesNeeded returned for 'num_output_samples'. */
+	void Process(const f32* input, size_t num_input_samples, f32* output, size_t num_output_samples);
+
+private:
+	static constexpr unsigned time_frac_bits = 32;
+	static constexpr unsigned phase_bits = 7;
+	static constexpr unsigned num_phases = 1 << phase_bits;
+
+	Quality quality = Quality::High;
+	unsigned num_taps = 0; /* A multiple of four */
+	u64 step = 0; /* Input samples per output sample, in units of 2^-time_frac_bits input samples */
+	u64 position = 0; /* Position of the next output sample in 'history', in the same units */
+
+	/* 'num_phases' + 1 phases of 'num_taps' taps each; the extra phase is the first one shifted by a whole sample, for interpolating past the last one. */
+	std::vector<f32> filter;
+	/* The input samples that the next output samples are made from, preceded by the ones the filter reaches back to. */
+	std::vector<f32> history;
+
+	static unsigned GetNumTaps(Quality quality);
+	static double GetKaiserBeta(Quality quality);
+	static double BesselI0(double x);
+
+	void MakeFilter(double cutoff);
+	f32 DotProduct(const f32* samples, const f32* taps) const;
+};
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <vector>
+
+/* A lock-free ring buffer for one producer thread and one consumer thread.
+   The read and write positions only ever increase, and are masked into the buffer when indexing it, so that a full buffer
+   can be told apart from an empty one without giving up an element. Each side only stores to its own position,
+   with release semantics, after having copied the elements; the other side loads it with acquire semantics before copying. */
+template<typename T>
+class SPSCRingBuffer
+{
+public:
+	/* The capacity is rounded up to a power of two. */
+	explicit SPSCRingBuffer(size_t min_capacity) :
+		buffer(std::bit_ceil(std::max(min_capacity, size_t(1)))),
+		index_mask(buffer.size() - 1)
+	{
+	}
+
+	SPSCRingBuffer(const SPSCRingBuffer& other) = delete;
+	SPSCRingBuffer& operator=(const SPSCRingBuffer& other) = delete;
+
+	size_t GetCapacity() const { return buffer.size(); }
+
+	/* Exact when called from either thread, as far as its own side is concerned: the producer may see fewer elements
+	   than there are (the consumer may have taken some since), and the consumer may see more free space than there is. */
+	size_t GetNumElements() const
+	{
+		return write_pos.load(std::memory_order_acquire) - read_pos.load(std::memory_order_acquire);
+	}
+
+	size_t GetNumFree() const { return GetCapacity() - GetNumElements(); }
+
+	/* Producer only. Copies as many of the 'count' elements at 'data' as there is room for, and returns how many that was. */
+	size_t Push(const T* data, size_t count)
+	{
+		const size_t write = write_pos.load(std::memory_order_relaxed);
+		const size_t read = read_pos.load(std::memory_order_acquire);
+		count = std::min(count, GetCapacity() - (write - read));
+		const size_t first_part = std::min(count, GetCapacity() - (write & index_mask));
+		std::copy(data, data + first_part, buffer.begin() + (write & index_mask));
+		std::copy(data + first_part, data + count, buffer.begin());
+		write_pos.store(write + count, std::memory_order_release);
+		return count;
+	}
+
+	/* Consumer only. Copies up to 'count' elements to 'data', and returns how many there were. */
+	size_t Pop(T* data, size_t count)
+	{
+		const size_t read = read_pos.load(std::memory_order_relaxed);
+		const size_t write = write_pos.load(std::memory_order_acquire);
+		count = std::min(count, write - read);
+		const size_t first_part = std::min(count, GetCapacity() - (read & index_mask));
+		std::copy(buffer.begin() + (read & index_mask), buffer.begin() + (read & index_mask) + first_part, data);
+		std::copy(buffer.begin(), buffer.begin() + (count - first_part), data + first_part);
+		read_pos.store(read + count, std::memory_order_release);
+		return count;
+	}
+
+private:
+	static constexpr size_t cache_line_size = 64;
+
+	std::vector<T> buffer;
+	const size_t index_mask;
+
+	/* On separate cache lines, so that the two threads do not keep taking the line from each other. */
+	alignas(cache_line_size) std::atomic<size_t> write_pos = 0;
+	alignas(cache_line_size) std::atomic<size_t> read_pos = 0;
+};
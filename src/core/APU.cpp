@@ -1,5 +1,16 @@
 #include "APU.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+
+
+APU::~APU()
+{
+	StopRenderThread();
+}
+
 
 bool APU::AudioIsEnabled() const
 {
@@ -10,32 +21,83 @@ bool APU::AudioIsEnabled() const
 void APU::EnableAudio()
 {
 	audio_is_enabled = true;
+	if (render_replica)
+	{
+		std::scoped_lock lock{ render_mutex };
+		render_replica->audio_is_enabled = true;
+	}
 }
 
 void APU::DisableAudio()
 {
 	audio_is_enabled = false;
+	if (render_replica)
+	{
+		std::scoped_lock lock{ render_mutex };
+		render_replica->audio_is_enabled = false;
+	}
 }
 
 
-void APU::PowerOn(const System::VideoStandard standard)
+void APU::OpenAudioDevice()
+{
+	StopRenderThread();
+	render_replica.reset();
+
+	if (render_on_thread)
+	{
+		/* The replica takes over everything to do with the output, including the device. */
+		audio_output.Close();
+		render_replica = std::make_unique<APU>(nullptr);
+		render_replica->is_render_replica = true;
+		render_replica->audio_is_enabled = audio_is_enabled;
+		render_replica->resampler_quality = resampler_quality;
+		render_replica->sample_block_listener = sample_block_listener;
+		if (render_replica->audio_output.Open())
+			render_replica->SetOutputFormat(render_replica->audio_output.GetSampleRate(), render_replica->audio_output.GetNumChannels());
+		StartRenderThread();
+	}
+	else if (audio_output.Open())
+		SetOutputFormat(audio_output.GetSampleRate(), audio_output.GetNumChannels());
+}
+
+
+void APU::SetOutputFormat(const unsigned sample_rate, const unsigned num_channels)
 {
-	SDL_AudioSpec desired_spec;
-	SDL_zero(desired_spec);
-	desired_spec.freq = sample_rate;
-	desired_spec.format = AUDIO_F32;
-	desired_spec.channels = num_audio_channels;
-	desired_spec.samples = sample_buffer_size_per_channel;
-	desired_spec.callback = nullptr;
+	output_sample_rate = sample_rate;
+	num_output_channels = num_channels;
+	output_needs_configuring = true;
+}
+
 
-	SDL_AudioSpec obtained_spec;
-	audio_device_id = SDL_OpenAudioDevice(nullptr, 0, &desired_spec, &obtained_spec, 0);
-	if (audio_device_id == 0)
+void APU::SetResamplerQuality(const Resampler::Quality quality)
+{
+	resampler_quality = quality;
+	output_needs_configuring = true;
+	if (render_replica)
 	{
-		const char* error_msg = SDL_GetError();
-		UserMessage::Show(std::format("Could not open an audio device; {}", error_msg), UserMessage::Type::Warning);
+		std::scoped_lock lock{ render_mutex };
+		render_replica->SetResamplerQuality(quality);
 	}
-	SDL_PauseAudioDevice(audio_device_id, 0);
+}
+
+
+void APU::SetSampleBlockListener(std::function<void(const f32*, size_t)> listener)
+{
+	this->sample_block_listener = std::move(listener);
+	if (render_replica)
+	{
+		std::scoped_lock lock{ render_mutex };
+		render_replica->sample_block_listener = this->sample_block_listener;
+	}
+}
+
+
+void APU::PowerOn(const System::VideoStandard standard)
+{
+	/* The replica is made anew when the audio device is opened for the game. */
+	StopRenderThread();
+	render_replica.reset();
 
 	switch (standard)
 	{
@@ -44,12 +106,24 @@ void APU::PowerOn(const System::VideoStandard standard)
 	case System::VideoStandard::Dendy: this->standard = Dendy; break;
 	}
 
+	blip_buffer.SetRates(this->standard.cpu_cycles_per_sec, synthesis_sample_rate);
+	output_needs_configuring = true;
+	pulse_sum = 0;
+	tnd_sum = 0;
+	output_level = 0;
+	cycles_behind = 0;
+	cycle_count = 0;
+	register_only_mode = !HasAudioSink();
+	StartSampleBlock();
+	ResetStems();
+
 	for (u16 addr = 0x4000; addr <= 0x4013; addr++)
 		WriteRegister(addr, 0x00);
 	WriteRegister(0x4015, 0x00);
 	WriteRegister(0x4017, 0x00);
 
 	dmc.apu_cycles_until_step = dmc.period; /* To prevent underflow of 'apu_cycles_until_step' the first time DMC::Step() is called */
+	ScheduleNextEvent();
 }
 
 
@@ -59,9 +133,194 @@ void APU::Reset()
 }
 
 
-void APU::Update()
+void APU::CatchUp()
+{
+	RunCycles(cycles_behind);
+	cycle_count += cycles_behind;
+	cycles_behind = 0;
+	UpdateRegisterOnlyMode();
+	if (LogsEvents() && cycle_count - last_advance_cycle >= render_advance_interval_in_cycles)
+	{
+		LogEvent(LoggedEventKind::Advance, 0, 0);
+		last_advance_cycle = cycle_count;
+		/* Wait for the replica if it has fallen behind; it is what paces the emulation. */
+		while (cycle_count - rendered_cycle.load(std::memory_order_acquire) > max_render_lead_in_cycles)
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+	}
+	ScheduleNextEvent();
+}
+
+
+bool APU::HasAudioSink() const
+{
+	return audio_is_enabled || sample_block_listener || audio_capture.IsCapturing();
+}
+
+
+void APU::UpdateRegisterOnlyMode()
+{
+	const bool new_register_only_mode = render_replica != nullptr || !HasAudioSink() || output_suppressed;
+	if (new_register_only_mode == register_only_mode)
+		return;
+	register_only_mode = new_register_only_mode;
+	if (!register_only_mode)
+	{
+		/* The output starts over in a new block, from the level of the channels as they were frozen. */
+		blip_buffer.Clear();
+		resampler.Reset();
+		output_filter.Reset();
+		StartSampleBlock();
+		ResetStems();
+		pulse_sum = 0;
+		tnd_sum = 0;
+		output_level = 0;
+		Mix(0);
+	}
+}
+
+
+void APU::ScheduleNextEvent()
+{
+	cycles_until_next_event = std::min({ frame_counter.CyclesUntilEvent(), CyclesUntilDMCSampleFetch(), CyclesUntilBlockEnd() });
+}
+
+
+void APU::RunCycles(u32 num_cycles)
+{
+	/* Stretches of cycles on which only the channel timers and the frame counter's cycle count advance are fast-forwarded.
+	   Everything else (frame counter steps, delayed register writes, DMC sample fetches) happens on cycles that are clocked one at a time. */
+	while (num_cycles > 0)
+	{
+		u32 num_fast_forward_cycles = 0;
+		if (!frame_counter.pending_4017_write && !HaltFlagWriteIsPending())
+		{
+			num_fast_forward_cycles = std::min({ num_cycles, frame_counter.CyclesUntilEvent() - 1,
+				CyclesUntilDMCSampleFetch() - 1, CyclesUntilBlockEnd() });
+		}
+		if (num_fast_forward_cycles > 0)
+		{
+			FastForward(num_fast_forward_cycles);
+			num_cycles -= num_fast_forward_cycles;
+		}
+		else
+		{
+			ClockCycle();
+			num_cycles--;
+		}
+	}
+}
+
+
+void APU::FastForward(const u32 num_cycles)
+{
+	/* Runs the channels for 'num_cycles' CPU cycles, during which neither the frame counter nor the DMC sample reader may act.
+	   Instead of stepping every timer every cycle, the cycle (relative to now) on which each timer next expires is computed,
+	   and the timers are visited in the order that they expire in, so that the mixer output still changes on the exact cycles.
+	   The pulse, noise and DMC timers are clocked on every APU cycle (every other CPU cycle), and the triangle timer on every CPU cycle. */
+	if (register_only_mode)
+	{
+		FastForwardDMC(num_cycles);
+		frame_counter.cpu_cycle_count += num_cycles;
+		on_apu_cycle ^= num_cycles & 1;
+		return;
+	}
+
+	const u32 first_apu_cycle = on_apu_cycle ? 0 : 1;
+	u32 pulse_1_expiry = first_apu_cycle + 2 * pulse_ch_1.timer;
+	u32 pulse_2_expiry = first_apu_cycle + 2 * pulse_ch_2.timer;
+	u32 noise_expiry = first_apu_cycle + 2 * noise_ch.timer;
+	u32 dmc_expiry = first_apu_cycle + 2 * (dmc.StepsUntilOutputClock() - 1);
+	u32 triangle_expiry = triangle_ch.timer;
+	const u32 dmc_period = dmc.period == 0 ? 256 : dmc.period;
+
+	/* Changes caused by register writes since the last cycle are mixed on the first cycle, like they would be if it was stepped. */
+	for (u32 cycle = 0; cycle < num_cycles;
+		cycle = std::min({ pulse_1_expiry, pulse_2_expiry, noise_expiry, dmc_expiry, triangle_expiry }))
+	{
+		if (pulse_1_expiry == cycle)
+		{
+			pulse_ch_1.ClockSequencer();
+			pulse_1_expiry += 2 * (pulse_ch_1.timer_period + 1);
+		}
+		if (pulse_2_expiry == cycle)
+		{
+			pulse_ch_2.ClockSequencer();
+			pulse_2_expiry += 2 * (pulse_ch_2.timer_period + 1);
+		}
+		if (noise_expiry == cycle)
+		{
+			noise_ch.ClockShiftRegister();
+			noise_expiry += 2 * (noise_ch.timer_period + 1);
+		}
+		if (dmc_expiry == cycle)
+		{
+			dmc.ClockOutputUnit();
+			dmc_expiry += 2 * dmc_period;
+		}
+		if (triangle_expiry == cycle)
+		{
+			triangle_ch.ClockSequencer();
+			triangle_expiry += triangle_ch.timer_period + 1;
+		}
+		Mix(blip_clock + cycle);
+	}
+
+	/* Turn the expiry cycles back into timer values, counting from the first APU cycle after the ones that were run. */
+	const u32 next_apu_cycle = num_cycles + ((num_cycles ^ first_apu_cycle) & 1);
+	pulse_ch_1.timer = (pulse_1_expiry - next_apu_cycle) / 2;
+	pulse_ch_2.timer = (pulse_2_expiry - next_apu_cycle) / 2;
+	noise_ch.timer = (noise_expiry - next_apu_cycle) / 2;
+	dmc.apu_cycles_until_step = (dmc_expiry - next_apu_cycle) / 2 + 1;
+	triangle_ch.timer = triangle_expiry - num_cycles;
+
+	frame_counter.cpu_cycle_count += num_cycles;
+	on_apu_cycle ^= num_cycles & 1;
+	blip_clock += num_cycles;
+	if (blip_clock == blip_clocks_per_block)
+		OutputSampleBlock();
+}
+
+
+void APU::FastForwardDMC(const u32 num_cycles)
 {
-	/* APU::Update() is called every CPU cycle, and 2 CPU cycles = 1 APU cycle.
+	/* In register-only mode, only the DMC output unit needs to be clocked, since it decides when sample bytes are fetched.
+	   No fetch falls within the cycles, so it is clocked fewer than eight times. */
+	const u32 first_apu_cycle = on_apu_cycle ? 0 : 1;
+	const u32 dmc_period = dmc.period == 0 ? 256 : dmc.period;
+	u32 dmc_expiry = first_apu_cycle + 2 * (dmc.StepsUntilOutputClock() - 1);
+	for (; dmc_expiry < num_cycles; dmc_expiry += 2 * dmc_period)
+		dmc.ClockOutputUnit();
+	const u32 next_apu_cycle = num_cycles + ((num_cycles ^ first_apu_cycle) & 1);
+	dmc.apu_cycles_until_step = (dmc_expiry - next_apu_cycle) / 2 + 1;
+}
+
+
+u32 APU::CyclesUntilBlockEnd() const
+{
+	/* In register-only mode, no samples are made, and so no block ever ends. */
+	return register_only_mode ? std::numeric_limits<u32>::max() : blip_clocks_per_block - blip_clock;
+}
+
+
+u32 APU::CyclesUntilDMCSampleFetch() const
+{
+	/* A sample byte may be fetched when the output unit has shifted out the last bit of its shift register. */
+	const u32 first_apu_cycle = on_apu_cycle ? 0 : 1;
+	const u32 dmc_period = dmc.period == 0 ? 256 : dmc.period;
+	return first_apu_cycle + 2 * (dmc.StepsUntilOutputClock() - 1) + 2 * dmc_period * (dmc.bits_remaining - 1) + 1;
+}
+
+
+bool APU::HaltFlagWriteIsPending() const
+{
+	return pulse_ch_1.length_counter.write_to_halt_next_cpu_cycle || pulse_ch_2.length_counter.write_to_halt_next_cpu_cycle
+		|| triangle_ch.length_counter.write_to_halt_next_cpu_cycle || noise_ch.length_counter.write_to_halt_next_cpu_cycle;
+}
+
+
+void APU::ClockCycle()
+{
+	/* ClockCycle() runs a single CPU cycle, and 2 CPU cycles = 1 APU cycle.
 	   Some components update every APU cycle, others every CPU cycle.
 	   The triangle channel's timer is clocked on every CPU cycle,
 	   but the pulse, noise, and DMC timers are clocked only on every second CPU cycle.
@@ -69,12 +328,16 @@ void APU::Update()
 	if (on_apu_cycle)
 	{
 		dmc.Step();
-		noise_ch.Step();
-		pulse_ch_1.Step();
-		pulse_ch_2.Step();
+		if (!register_only_mode)
+		{
+			noise_ch.Step();
+			pulse_ch_1.Step();
+			pulse_ch_2.Step();
+		}
 	}
 	frame_counter.Step();
-	triangle_ch.Step();
+	if (!register_only_mode)
+		triangle_ch.Step();
 
 	/* If the length counter halt flag was set to be set/cleared on the last cpu cycle, set/clear it now. */
 	pulse_ch_1.length_counter.UpdateHaltFlag();
@@ -82,11 +345,11 @@ void APU::Update()
 	triangle_ch.length_counter.UpdateHaltFlag();
 	noise_ch.length_counter.UpdateHaltFlag();
 
-	cpu_cycle_sample_counter += sample_rate;
-	if (cpu_cycle_sample_counter >= standard.cpu_cycles_per_sec)
+	if (!register_only_mode)
 	{
-		SampleAndMix();
-		cpu_cycle_sample_counter -= standard.cpu_cycles_per_sec;
+		Mix(blip_clock);
+		if (++blip_clock == blip_clocks_per_block)
+			OutputSampleBlock();
 	}
 
 	on_apu_cycle = !on_apu_cycle;
@@ -98,6 +361,7 @@ u8 APU::ReadRegister(const u16 addr)
 	// Only $4015 is readable, the rest are write only.
 	if (addr == Bus::Addr::APU_STAT)
 	{
+		CatchUp();
 		const u8 ret = (pulse_ch_1.length_counter.value  > 0)
 					 | (pulse_ch_2.length_counter.value  > 0) << 1
 					 | (triangle_ch.length_counter.value > 0) << 2
@@ -108,6 +372,7 @@ u8 APU::ReadRegister(const u16 addr)
 
 		SetFrameCounterIRQHigh();
 		// TODO If an interrupt flag was set at the same moment of the read, it will read back as 1 but it will not be cleared.
+		ScheduleNextEvent();
 		return ret;
 	}
 	return 0xFF;
@@ -116,6 +381,8 @@ u8 APU::ReadRegister(const u16 addr)
 
 void APU::WriteRegister(const u16 addr, const u8 data)
 {
+	CatchUp();
+
 	switch (addr)
 	{
 	case Bus::Addr::SQ1_VOL: // $4000
@@ -137,13 +404,13 @@ void APU::WriteRegister(const u16 addr, const u8 data)
 		break;
 
 	case Bus::Addr::SQ1_LO: // $4002
-		pulse_ch_1.timer_period = pulse_ch_1.timer_period & 0x700 | data;
+		pulse_ch_1.timer_period = (pulse_ch_1.timer_period & 0x700) | data;
 		pulse_ch_1.UpdateSweepMuting();
 		pulse_ch_1.ComputeTargetTimerPeriod();
 		break;
 
 	case Bus::Addr::SQ1_HI: // $4003
-		pulse_ch_1.timer_period = pulse_ch_1.timer_period & 0xFF | data << 8;
+		pulse_ch_1.timer_period = (pulse_ch_1.timer_period & 0xFF) | data << 8;
 		pulse_ch_1.UpdateSweepMuting();
 		if (pulse_ch_1.enabled)
 		{
@@ -174,13 +441,13 @@ void APU::WriteRegister(const u16 addr, const u8 data)
 		break;
 
 	case Bus::Addr::SQ2_LO: // $4006
-		pulse_ch_2.timer_period = pulse_ch_2.timer_period & 0x700 | data;
+		pulse_ch_2.timer_period = (pulse_ch_2.timer_period & 0x700) | data;
 		pulse_ch_2.UpdateSweepMuting();
 		pulse_ch_2.ComputeTargetTimerPeriod();
 		break;
 
 	case Bus::Addr::SQ2_HI: // $4007
-		pulse_ch_2.timer_period = pulse_ch_2.timer_period & 0xFF | data << 8;
+		pulse_ch_2.timer_period = (pulse_ch_2.timer_period & 0xFF) | data << 8;
 		pulse_ch_2.UpdateSweepMuting();
 		if (pulse_ch_2.enabled)
 		{
@@ -199,11 +466,11 @@ void APU::WriteRegister(const u16 addr, const u8 data)
 		break;
 
 	case Bus::Addr::TRI_LO: // $400A
-		triangle_ch.timer_period = triangle_ch.timer_period & 0x700 | data;
+		triangle_ch.timer_period = (triangle_ch.timer_period & 0x700) | data;
 		break;
 
 	case Bus::Addr::TRI_HI: // $400B
-		triangle_ch.timer_period = triangle_ch.timer_period & 0xFF | data << 8;
+		triangle_ch.timer_period = (triangle_ch.timer_period & 0xFF) | data << 8;
 		if (triangle_ch.enabled)
 		{
 			triangle_ch.length_counter.value = length_table[data >> 3];
@@ -320,6 +587,25 @@ void APU::WriteRegister(const u16 addr, const u8 data)
 	default:
 		break;
 	}
+
+	/* Logged after it has been applied, so that a sample byte fetched because of it comes before it in the log. */
+	if (LogsEvents())
+		LogEvent(LoggedEventKind::RegisterWrite, addr, data);
+	ScheduleNextEvent();
+}
+
+
+unsigned APU::FrameCounter::CyclesUntilEvent() const
+{
+	if (pending_4017_write)
+		return cpu_cycles_until_apply_4017_write;
+	const unsigned* const table = apu->standard.frame_counter_step_cycle_table;
+	for (int i = 0; i < 8; i++)
+	{
+		if (table[i] > cpu_cycle_count)
+			return table[i] - cpu_cycle_count;
+	}
+	return 1;
 }
 
 
@@ -484,13 +770,19 @@ void APU::PulseCh::ComputeTargetTimerPeriod()
 }
 
 
+void APU::PulseCh::ClockSequencer()
+{
+	duty_pos++;
+	output = pulse_duty_table[duty][duty_pos];
+}
+
+
 void APU::PulseCh::Step()
 {
 	if (timer == 0)
 	{
 		timer = timer_period;
-		duty_pos++;
-		output = pulse_duty_table[duty][duty_pos];
+		ClockSequencer();
 	}
 	else
 		timer--;
@@ -517,17 +809,23 @@ void APU::TriangleCh::ClockLinear()
 }
 
 
+void APU::TriangleCh::ClockSequencer()
+{
+	// The sequencer is clocked by the timer as long as both the linear counter and the length counter are nonzero.
+	if (linear_counter.value != 0 && length_counter.value != 0)
+	{
+		duty_pos++;
+		output = triangle_duty_table[duty_pos];
+	}
+}
+
+
 void APU::TriangleCh::Step()
 {
 	if (timer == 0)
 	{
 		timer = timer_period;
-		// The sequencer is clocked by the timer as long as both the linear counter and the length counter are nonzero.
-		if (linear_counter.value != 0 && length_counter.value != 0)
-		{
-			duty_pos++;
-			output = triangle_duty_table[duty_pos];
-		}
+		ClockSequencer();
 	}
 	else
 		timer--;
@@ -578,15 +876,21 @@ void APU::NoiseCh::ClockLength()
 }
 
 
+void APU::NoiseCh::ClockShiftRegister()
+{
+	output = (LFSR & 1) ^ (mode ? (LFSR >> 6 & 1) : (LFSR >> 1 & 1));
+	LFSR >>= 1;
+	LFSR |= output << 14;
+	UpdateVolume();
+}
+
+
 void APU::NoiseCh::Step()
 {
 	if (timer == 0)
 	{
 		timer = timer_period;
-		output = (LFSR & 1) ^ (mode ? (LFSR >> 6 & 1) : (LFSR >> 1 & 1));
-		LFSR >>= 1;
-		LFSR |= output << 14;
-		UpdateVolume();
+		ClockShiftRegister();
 	}
 	else
 		timer--;
@@ -597,7 +901,13 @@ void APU::DMC::Step()
 {
 	if (--apu_cycles_until_step > 0)
 		return;
+	ClockOutputUnit();
+	apu_cycles_until_step = period;
+}
 
+
+void APU::DMC::ClockOutputUnit()
+{
 	if (!silence_flag)
 	{
 		const int new_output_level = output_level + ((shift_register & 1) ? 2 : -2);
@@ -622,15 +932,27 @@ void APU::DMC::Step()
 				sample_buffer_is_empty = true;
 		}
 	}
-
-	apu_cycles_until_step = period;
 }
 
 
 void APU::DMC::ReadSampleByte()
 {
-	apu->nes->cpu->Stall();
-	sample_buffer = apu->nes->mapper->ReadPRG(current_sample_addr);
+	if (apu->is_render_replica)
+	{
+		/* The byte that the emulated APU fetched at this point (see RenderLoop) */
+		if (!apu->logged_sample_bytes.empty())
+		{
+			sample_buffer = apu->logged_sample_bytes.front();
+			apu->logged_sample_bytes.pop_front();
+		}
+	}
+	else
+	{
+		apu->nes->cpu->Stall();
+		sample_buffer = apu->nes->mapper->ReadPRG(current_sample_addr);
+		if (apu->LogsEvents())
+			apu->LogEvent(LoggedEventKind::DMCSampleByte, current_sample_addr, sample_buffer);
+	}
 	current_sample_addr = (current_sample_addr + 1) | 0x8000; // If the address exceeds $FFFF, it is wrapped around to $8000.
 	sample_buffer_is_empty = false;
 
@@ -651,63 +973,346 @@ void APU::DMC::RestartSample()
 }
 
 
-void APU::SampleAndMix()
+void APU::Mix(const u32 clock)
 {
 	// https://wiki.nesdev.org/w/index.php?title=APU_Mixer
-	const u8 pulse_sum = pulse_ch_1.output * pulse_ch_1.volume + pulse_ch_2.output * pulse_ch_2.volume;
-	const f32 pulse_out = pulse_table[pulse_sum];
-
-	const u16 tnd_sum = 3 * triangle_ch.output + 2 * noise_ch.output * noise_ch.volume + dmc.output_level;
-	const f32 tnd_out = tnd_table[tnd_sum];
+	/* The mixer is not linear, so the output is recomputed from all channels whenever one of them changes,
+	   and the change of the mixed output is what is synthesized. Most cycles, nothing changes. */
+	if (!stem_blip_buffers.empty())
+		MixStems(clock);
+
+	const u8 new_pulse_sum = pulse_ch_1.output * pulse_ch_1.volume + pulse_ch_2.output * pulse_ch_2.volume;
+	const u16 new_tnd_sum = 3 * triangle_ch.output + 2 * noise_ch.output * noise_ch.volume + dmc.output_level;
+	if (new_pulse_sum == pulse_sum && new_tnd_sum == tnd_sum)
+		return;
 
-	const f32 output = pulse_out + tnd_out; /* [0, 2] */
+	pulse_sum = new_pulse_sum;
+	tnd_sum = new_tnd_sum;
+	const f32 new_output_level = pulse_table[pulse_sum] + tnd_table[tnd_sum]; /* [0, 2] */
+	blip_buffer.AddDelta(clock, new_output_level - output_level);
+	output_level = new_output_level;
+}
 
-	sample_buffer[sample_buffer_index++] = output;
-	sample_buffer[sample_buffer_index++] = output;
 
-	if (sample_buffer_index == sample_buffer_size)
+void APU::MixStems(const u32 clock)
+{
+	/* Each channel is put through the mixer as if the others were silent. */
+	const std::array<f32, AudioCapture::num_stems> new_output_levels = {
+		pulse_table[pulse_ch_1.output * pulse_ch_1.volume],
+		pulse_table[pulse_ch_2.output * pulse_ch_2.volume],
+		tnd_table[3 * triangle_ch.output],
+		tnd_table[2 * noise_ch.output * noise_ch.volume],
+		tnd_table[dmc.output_level]
+	};
+	for (unsigned i = 0; i < AudioCapture::num_stems; i++)
 	{
-		if (audio_is_enabled) /* TODO: disable updating of the APU entirely when audio is disabled? */
+		if (new_output_levels[i] != stem_output_levels[i])
 		{
-			while (std::chrono::duration_cast<std::chrono::nanoseconds>(
-				std::chrono::steady_clock::now() - last_audio_enqueue_time_point).count() < nanoseconds_per_audio_enqueue);
+			stem_blip_buffers[i].AddDelta(clock, new_output_levels[i] - stem_output_levels[i]);
+			stem_output_levels[i] = new_output_levels[i];
+		}
+	}
+}
+
+
+void APU::ResetStems()
+{
+	for (BlipBuffer& stem_blip_buffer : stem_blip_buffers)
+		stem_blip_buffer.ClearAndSyncWith(blip_buffer);
+	for (Resampler& stem_resampler : stem_resamplers)
+		stem_resampler.ClearAndSyncWith(resampler);
+	for (OutputFilter& stem_output_filter : stem_output_filters)
+		stem_output_filter.Reset();
+	stem_output_levels.fill(0);
+	if (!stem_blip_buffers.empty())
+		MixStems(blip_clock);
+}
+
+
+bool APU::StartAudioCapture(const std::string& path, const AudioCapture::Format format,
+	const AudioCapture::SampleFormat sample_format, const bool record_stems)
+{
+	if (render_replica)
+	{
+		std::scoped_lock lock{ render_mutex };
+		return render_replica->StartAudioCapture(path, format, sample_format, record_stems);
+	}
+	/* The stems are synthesized from the current cycle on, so the APU must be up to date. */
+	CatchUp();
+	if (!audio_capture.Start(path, format, sample_format, output_sample_rate, num_output_channels, record_stems))
+		return false;
+	stem_blip_buffers.assign(record_stems ? AudioCapture::num_stems : 0, BlipBuffer{ synthesis_buffer_size });
+	stem_resamplers.assign(record_stems ? AudioCapture::num_stems : 0, Resampler{});
+	stem_output_filters.assign(record_stems ? AudioCapture::num_stems : 0, output_filter);
+	UpdateRegisterOnlyMode();
+	ResetStems();
+	ScheduleNextEvent();
+	return true;
+}
 
-			last_audio_enqueue_time_point = std::chrono::steady_clock::now(); /* TODO: improve accuracy by using the last ::now() in the while loop */
-			SDL_QueueAudio(audio_device_id, sample_buffer.data(), sample_buffer_size * sizeof(f32));
+
+bool APU::StopAudioCapture()
+{
+	if (render_replica)
+	{
+		std::scoped_lock lock{ render_mutex };
+		return render_replica->StopAudioCapture();
+	}
+	stem_blip_buffers.clear();
+	stem_resamplers.clear();
+	stem_output_filters.clear();
+	return audio_capture.Stop();
+}
+
+
+void APU::OutputSampleBlock()
+{
+	blip_buffer.EndFrame(blip_clock);
+	blip_buffer.ReadSamples(synthesis_buffer.data(), synthesis_samples_per_block);
+	resampler.Process(synthesis_buffer.data(), synthesis_samples_per_block, mono_sample_buffer.data(), sample_buffer_size_per_channel);
+	output_filter.Process(mono_sample_buffer.data(), sample_buffer_size_per_channel);
+
+	/* The output is mono. It goes to both front channels (or to the only one), and any others are left silent. */
+	for (size_t frame = 0; frame < sample_buffer_size_per_channel; frame++)
+	{
+		f32* const out = &sample_buffer[frame * num_output_channels];
+		out[0] = mono_sample_buffer[frame];
+		for (unsigned channel = 1; channel < num_output_channels; channel++)
+			out[channel] = channel == 1 ? mono_sample_buffer[frame] : 0.f;
+	}
+
+	if (sample_block_listener)
+		sample_block_listener(sample_buffer.data(), sample_buffer.size());
+	if (audio_capture.IsCapturing())
+	{
+		std::array<const f32*, AudioCapture::num_stems> stem_samples{};
+		for (size_t i = 0; i < stem_blip_buffers.size(); i++)
+		{
+			stem_blip_buffers[i].EndFrame(blip_clock);
+			stem_blip_buffers[i].ReadSamples(synthesis_buffer.data(), synthesis_samples_per_block);
+			stem_resamplers[i].Process(synthesis_buffer.data(), synthesis_samples_per_block,
+				stem_sample_buffers[i].data(), sample_buffer_size_per_channel);
+			stem_output_filters[i].Process(stem_sample_buffers[i].data(), sample_buffer_size_per_channel);
+			stem_samples[i] = stem_sample_buffers[i].data();
 		}
-		sample_buffer_index = 0;
+		audio_capture.PushBlock(sample_buffer.data(), sample_buffer_size_per_channel, stem_samples);
 	}
+	if (audio_is_enabled)
+		audio_output.Submit(sample_buffer.data(), sample_buffer_size_per_channel); /* Also paces the emulation */
+
+	StartSampleBlock();
+}
+
+
+void APU::StartSampleBlock()
+{
+	if (output_needs_configuring)
+		ConfigureOutput();
+
+	/* While audio is played, the number of samples made per emulated second is adjusted slightly, to keep the amount
+	   of buffered audio near its target (see AudioOutput). Otherwise, the rate is exactly the nominal one. */
+	const double block_sample_rate = audio_is_enabled ? output_sample_rate * audio_output.GetRateAdjustment() : output_sample_rate;
+	resampler.ChangeRates(synthesis_sample_rate, block_sample_rate);
+	for (Resampler& stem_resampler : stem_resamplers)
+		stem_resampler.ChangeRates(synthesis_sample_rate, block_sample_rate);
+
+	synthesis_samples_per_block = u32(resampler.GetNumInputSamplesNeeded(sample_buffer_size_per_channel));
+	blip_clock = 0;
+	blip_clocks_per_block = std::max(blip_buffer.GetClocksNeeded(synthesis_samples_per_block), 1u);
+}
+
+
+void APU::ConfigureOutput()
+{
+	resampler.Configure(synthesis_sample_rate, output_sample_rate, resampler_quality);
+	for (Resampler& stem_resampler : stem_resamplers)
+		stem_resampler.ClearAndSyncWith(resampler);
+	output_filter.Configure(output_sample_rate);
+	for (OutputFilter& stem_output_filter : stem_output_filters)
+		stem_output_filter.Configure(output_sample_rate);
+	sample_buffer.assign(sample_buffer_size_per_channel * num_output_channels, 0.f);
+	output_needs_configuring = false;
 }
 
 
 void APU::StreamState(SerializationStream& stream)
 {
-	stream.StreamPrimitive(pulse_ch_1);
-	stream.StreamPrimitive(pulse_ch_2);
+	CatchUp();
+
+	stream.StreamPrimitive(static_cast<PulseChState&>(pulse_ch_1));
+	stream.StreamPrimitive(static_cast<PulseChState&>(pulse_ch_2));
 	stream.StreamPrimitive(triangle_ch);
 	stream.StreamPrimitive(noise_ch);
 
-	/* Do not mutate the apu pointers in the dmc channel and frame counter */
-	APU* apu = dmc.apu;
-	stream.StreamPrimitive(dmc);
-	stream.StreamPrimitive(frame_counter);
-	dmc.apu = frame_counter.apu = apu;
+	stream.StreamPrimitive(static_cast<DMCState&>(dmc));
+	stream.StreamPrimitive(static_cast<FrameCounterState&>(frame_counter));
 
 	stream.StreamPrimitive(on_apu_cycle);
-	stream.StreamPrimitive(cpu_cycle_sample_counter);
-	stream.StreamPrimitive(sample_buffer_index);
+	stream.StreamPrimitive(pulse_sum);
+	stream.StreamPrimitive(tnd_sum);
+	stream.StreamPrimitive(output_level);
+
+	/* Samples that were not yet output are not part of the state. After loading, a new block starts from the loaded output level;
+	   unless the output is suppressed, in which case it is left as it was (see SuppressOutput). */
+	if (stream.mode == SerializationStream::Mode::Deserialization)
+	{
+		if (!output_suppressed)
+			RestartOutput();
+		cycles_behind = 0;
+		ScheduleNextEvent();
+		if (render_replica && !output_suppressed)
+		{
+			/* Whatever was logged belongs to the state that was left */
+			StopRenderThread();
+			StartRenderThread();
+		}
+	}
+}
+
+
+void APU::SuppressOutput(const bool suppress)
+{
+	if (suppress == output_suppressed)
+		return;
+	CatchUp();
+	if (suppress)
+	{
+		register_only_mode_before_suppression = register_only_mode;
+		cycle_count_before_suppression = cycle_count;
+		output_suppressed = register_only_mode = true;
+	}
+	else
+	{
+		/* The state saved when the output was suppressed has been loaded since; the output goes on from where it stopped,
+		   and the render thread from the last cycle that was logged. */
+		output_suppressed = false;
+		register_only_mode = register_only_mode_before_suppression;
+		cycle_count = cycle_count_before_suppression;
+		UpdateRegisterOnlyMode();
+	}
+	ScheduleNextEvent();
+}
+
+
+void APU::RestartOutput()
+{
+	blip_buffer.Clear();
+	blip_buffer.AddDelta(0, output_level);
+	resampler.Reset();
+	output_filter.Reset();
+	StartSampleBlock();
+	ResetStems();
+}
+
+
+void APU::CopyStateFrom(const APU& other)
+{
+	/* Like loading a save state of 'other' (see StreamState), but from memory. */
+	static_cast<PulseChState&>(pulse_ch_1) = other.pulse_ch_1;
+	static_cast<PulseChState&>(pulse_ch_2) = other.pulse_ch_2;
+	triangle_ch = other.triangle_ch;
+	noise_ch = other.noise_ch;
+	static_cast<DMCState&>(dmc) = other.dmc;
+	static_cast<FrameCounterState&>(frame_counter) = other.frame_counter;
+
+	standard = other.standard;
+	on_apu_cycle = other.on_apu_cycle;
+	pulse_sum = other.pulse_sum;
+	tnd_sum = other.tnd_sum;
+	output_level = other.output_level;
+	cycle_count = other.cycle_count;
+	cycles_behind = 0;
+	logged_sample_bytes.clear();
+
+	blip_buffer.SetRates(standard.cpu_cycles_per_sec, synthesis_sample_rate);
+	RestartOutput();
+	UpdateRegisterOnlyMode();
+	ScheduleNextEvent();
+}
+
+
+void APU::StartRenderThread()
+{
+	/* The replica starts out from the current state; anything left in the log from before is dropped. */
+	CatchUp();
+	std::array<LoggedEvent, 256> events;
+	if (!render_event_log)
+		render_event_log = std::make_unique<SPSCRingBuffer<LoggedEvent>>(render_event_log_capacity);
+	while (render_event_log->Pop(events.data(), events.size()) > 0) {}
+
+	render_replica->CopyStateFrom(*this);
+	rendered_cycle.store(cycle_count, std::memory_order_relaxed);
+	last_advance_cycle = cycle_count;
+	stop_render_thread = false;
+	render_thread = std::thread([this] { RenderLoop(); });
+	UpdateRegisterOnlyMode();
+	ScheduleNextEvent();
+}
+
+
+void APU::StopRenderThread()
+{
+	if (!render_thread.joinable())
+		return;
+	stop_render_thread = true;
+	render_thread.join();
+}
+
 
-	stream.StreamArray(sample_buffer);
+void APU::LogEvent(const LoggedEventKind kind, const u16 addr, const u8 data)
+{
+	const LoggedEvent event{ cycle_count, addr, data, kind };
+	while (render_event_log->Push(&event, 1) == 0)
+		std::this_thread::sleep_for(std::chrono::microseconds(200));
+}
+
+
+void APU::RenderLoop()
+{
+	/* Runs on the render thread; see 'render_replica'. */
+	std::array<LoggedEvent, 256> events;
+	while (!stop_render_thread.load(std::memory_order_relaxed))
+	{
+		const size_t num_events = render_event_log->Pop(events.data(), events.size());
+		if (num_events == 0)
+		{
+			std::this_thread::sleep_for(std::chrono::microseconds(500));
+			continue;
+		}
+
+		std::scoped_lock lock{ render_mutex };
+		APU& replica = *render_replica;
+		for (size_t i = 0; i < num_events; i++)
+		{
+			const LoggedEvent& event = events[i];
+			if (event.kind == LoggedEventKind::DMCSampleByte)
+			{
+				/* Fetched while running up to the next write or advance, which the replica has not run up to yet. */
+				replica.logged_sample_bytes.push_back(event.data);
+				continue;
+			}
+			replica.cycles_behind = u32(event.cycle - replica.cycle_count);
+			replica.CatchUp();
+			if (event.kind == LoggedEventKind::RegisterWrite)
+				replica.WriteRegister(event.addr, event.data);
+		}
+		rendered_cycle.store(replica.cycle_count, std::memory_order_release);
+	}
 }
 
 
 void APU::StreamConfig(SerializationStream& stream)
 {
 	stream.StreamPrimitive(audio_is_enabled);
+	stream.StreamPrimitive(resampler_quality);
+	stream.StreamPrimitive(render_on_thread);
+	output_needs_configuring = true;
 }
 
 
 void APU::SetDefaultConfig()
 {
 	audio_is_enabled = default_audio_is_enabled;
+	SetResamplerQuality(default_resampler_quality);
+	render_on_thread = default_render_on_thread;
 }
\ No newline at end of file
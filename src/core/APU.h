@@ -1,9 +1,21 @@
 #pragma once
 
 #include <array>
-#include <chrono>
-
-#include "SDL.h"
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../audio/AudioCapture.h"
+#include "../audio/AudioOutput.h"
+#include "../audio/BlipBuffer.h"
+#include "../audio/OutputFilter.h"
+#include "../audio/Resampler.h"
+#include "../audio/SPSCRingBuffer.h"
 
 #include "Bus.h"
 #include "Component.h"
@@ -17,10 +29,20 @@ class APU final : public Component
 {
 public:
 	using Component::Component;
+	~APU();
 
+	void OpenAudioDevice();
 	void PowerOn(const System::VideoStandard standard);
 	void Reset();
-	void Update();
+
+	/* Called every CPU cycle. Rather than being stepped cycle by cycle, the APU falls behind, and catches up (see CatchUp)
+	   when one of its registers is accessed, or when something is due that is seen from the outside: a frame counter step
+	   (which may raise an IRQ), a DMC sample fetch (which stalls the CPU, and may raise an IRQ), or the end of an audio block. */
+	__forceinline void Update()
+	{
+		if (++cycles_behind == cycles_until_next_event)
+			CatchUp();
+	}
 	u8 ReadRegister(const u16 addr);
 	void WriteRegister(const u16 addr, const u8 data);
 
@@ -28,6 +50,30 @@ public:
 	void EnableAudio();
 	void DisableAudio();
 
+	/* 'listener' is called with every block of interleaved samples as soon as it has been mixed, whether or not audio is enabled.
+	   The samples are in the format of the audio device (see GetOutputSampleRate and GetNumOutputChannels). */
+	void SetSampleBlockListener(std::function<void(const f32*, size_t)> listener);
+
+	/* Records the output, and optionally each channel on its own, to files (see AudioCapture), whether or not audio is enabled. */
+	[[nodiscard]] bool StartAudioCapture(const std::string& path, AudioCapture::Format format, AudioCapture::SampleFormat sample_format, bool record_stems);
+	bool StopAudioCapture();
+	bool IsCapturingAudio() const { return render_replica ? render_replica->IsCapturingAudio() : audio_capture.IsCapturing(); }
+
+	unsigned GetOutputSampleRate() const { return render_replica ? render_replica->output_sample_rate : output_sample_rate; }
+	unsigned GetNumOutputChannels() const { return render_replica ? render_replica->num_output_channels : num_output_channels; }
+
+	Resampler::Quality GetResamplerQuality() const { return resampler_quality; }
+	void SetResamplerQuality(Resampler::Quality quality);
+
+	/* For frames that are run only to be undone, by loading the state that was saved when the output was suppressed (run-ahead;
+	   see Emulator). Meanwhile, the APU runs in register-only mode, and nothing is heard, recorded or passed to the render thread;
+	   loading the state leaves the output as it was, so that it carries on without a gap once it is no longer suppressed. */
+	void SuppressOutput(bool suppress);
+
+	/* Takes effect when the audio device is next opened, i.e. when the next game is started (see StartRenderThread). */
+	bool RendersOnThread() const { return render_on_thread; }
+	void SetRenderOnThread(bool enabled) { render_on_thread = enabled; }
+
 	void StreamState(SerializationStream& stream) override;
 	void StreamConfig(SerializationStream& stream) override;
 	void SetDefaultConfig() override;
@@ -102,12 +148,13 @@ private:
 
 	static constexpr unsigned cpu_cycles_per_sec_ntsc = 1789773;
 	static constexpr unsigned cpu_cycles_per_sec_pal = 1662607;
-	static constexpr unsigned num_audio_channels = 2;
+	/* The output is synthesized at a fixed rate, and resampled from there to the rate of the audio device (see Resampler).
+	   The synthesis buffer has room for the samples of a block at output rates down to about 6 kHz. */
+	static constexpr unsigned synthesis_sample_rate = 96000;
+	static constexpr unsigned synthesis_buffer_size = 8192;
+	static constexpr unsigned default_output_sample_rate = 44100;
+	static constexpr unsigned default_num_output_channels = 2;
 	static constexpr unsigned sample_buffer_size_per_channel = 512;
-	static constexpr unsigned sample_buffer_size = sample_buffer_size_per_channel * num_audio_channels;;
-	static constexpr unsigned sample_rate = 44100;
-	static constexpr u64 nanoseconds_per_audio_enqueue =
-		double(sample_buffer_size_per_channel) / double(sample_rate) * 1'000'000'000;
 
 	struct Standard
 	{
@@ -167,11 +214,9 @@ private:
 		unsigned target_timer_period = 0;
 	};
 
-	struct PulseCh
+	/* The state of a pulse channel is kept apart from its constant id, so that it can be saved, loaded and copied whole. */
+	struct PulseChState
 	{
-		explicit PulseCh(int id) : id(id) {};
-		const int id; /* 1 or 2 */
-
 		bool enabled = false;
 		u8 output = 0;
 		u8 volume = 0;
@@ -183,9 +228,16 @@ private:
 		Envelope envelope;
 		LengthCounter length_counter;
 		Sweep sweep;
+	};
+
+	struct PulseCh : PulseChState
+	{
+		explicit PulseCh(int id) : id(id) {};
+		const int id; /* 1 or 2 */
 
 		void ClockEnvelope();
 		void ClockLength();
+		void ClockSequencer();
 		void ClockSweep();
 		void ComputeTargetTimerPeriod();
 		void Step();
@@ -220,6 +272,7 @@ private:
 
 		void ClockLength();
 		void ClockLinear();
+		void ClockSequencer();
 		void Step();
 		/* Note: the triangle channel does not have volume control; the waveform is either cycling or suspended. */
 	} triangle_ch;
@@ -239,6 +292,7 @@ private:
 
 		void ClockEnvelope();
 		void ClockLength();
+		void ClockShiftRegister();
 		void Step();
 
 		void UpdateVolume()
@@ -252,11 +306,10 @@ private:
 		}
 	} noise_ch;
 
-	struct DMC
+	/* The DMC and frame counter need access to members outside of their structs, through a pointer to the APU.
+	   Their state is kept in base structs of their own, so that it is saved and loaded without the pointer. */
+	struct DMCState
 	{
-		DMC(APU* apu) : apu(apu) {};
-		APU* apu; /* This unit needs access to some members outside of the struct. */
-
 		bool enabled                = false;
 		bool interrupt              = false;
 		bool IRQ_enable             = false;
@@ -273,17 +326,24 @@ private:
 		u16 period                = 0;
 		u16 sample_addr_start     = 0;
 		u16 sample_length         = 0;
+	};
+
+	struct DMC : DMCState
+	{
+		DMC(APU* apu) : apu(apu) {};
+		APU* apu;
 
+		void ClockOutputUnit();
 		void ReadSampleByte();
 		void RestartSample();
 		void Step();
+
+		/* The number of APU cycles until the output unit is next clocked, counting the cycle that it is clocked on. */
+		unsigned StepsUntilOutputClock() const { return apu_cycles_until_step == 0 ? 256 : apu_cycles_until_step; } /* 'apu_cycles_until_step' wraps around */
 	} dmc{ this };
 
-	struct FrameCounter
+	struct FrameCounterState
 	{
-		FrameCounter(APU* apu) : apu(apu) {}
-		APU* apu; /* This unit needs access to some members outside of the struct. */
-
 		bool interrupt          = 0;
 		bool interrupt_inhibit  = 0;
 		bool mode               = 0;
@@ -291,8 +351,16 @@ private:
 		u8 data_written_to_4017;
 		unsigned cpu_cycle_count = 0;
 		unsigned cpu_cycles_until_apply_4017_write;
+	};
+
+	struct FrameCounter : FrameCounterState
+	{
+		FrameCounter(APU* apu) : apu(apu) {}
+		APU* apu;
 
 		void Step();
+		/* The number of CPU cycles until (and including) the next one on which 'Step' does more than count. */
+		unsigned CyclesUntilEvent() const;
 
 		void ClockEnvelopeUnits()
 		{
@@ -320,43 +388,149 @@ private:
 
 	bool on_apu_cycle = true;
 
-	unsigned cpu_cycle_sample_counter = 0;
+	/* With nothing to hear or record the output (see HasAudioSink), or when the output is rendered on another thread, only
+	   what the game can observe is emulated exactly: the length counters, the frame counter and its IRQ, and the DMC sample reader
+	   with its DMA stalls and IRQ. The timers and waveform generators of the pulse, triangle and noise channels are frozen,
+	   and nothing is mixed or synthesized. Envelopes, linear counters and sweeps are still clocked by the frame counter (which
+	   costs next to nothing), so that a save state made in this mode only lacks the phases of the waveforms.
+	   The mode is switched on catching up, so that it follows the audio settings without them having to notify the APU. */
+	bool register_only_mode = false;
+
+	/* See SuppressOutput(). What is restored when it ends; the cycle count goes back to that of the state that was saved. */
+	bool output_suppressed = false;
+	bool register_only_mode_before_suppression = false;
+	u64 cycle_count_before_suppression = 0;
+
+	/* The mixer inputs and the mixed output as of the last cycle. The output is synthesized from its changes (see BlipBuffer). */
+	u8 pulse_sum = 0;
+	u16 tnd_sum = 0;
+	f32 output_level = 0;
+
+	u32 blip_clock = 0; /* CPU cycles since the start of the current sample block */
+	u32 blip_clocks_per_block = 0; /* CPU cycles until the current sample block is complete */
+
+	u32 cycles_behind = 0; /* CPU cycles that have passed, but that the APU has not been run for yet */
+	u32 cycles_until_next_event = 1; /* The value of 'cycles_behind' at which the APU must catch up */
+
 	unsigned microsecond_counter = 0;
-	unsigned sample_buffer_index = 0;
 
-	SDL_AudioDeviceID audio_device_id;
+	BlipBuffer blip_buffer{ synthesis_buffer_size };
+	Resampler resampler;
+	OutputFilter output_filter;
+	u32 synthesis_samples_per_block = 0; /* The number of synthesized samples that the resampler needs for the current block */
+	bool output_needs_configuring = true; /* The output format or the quality has changed; applied at the start of the next block */
+
+	unsigned output_sample_rate = default_output_sample_rate;
+	unsigned num_output_channels = default_num_output_channels;
+
+	AudioOutput audio_output{ default_output_sample_rate, default_num_output_channels, sample_buffer_size_per_channel };
+	AudioCapture audio_capture;
+
+	/* While the channels are recorded on their own, each is synthesized, resampled and filtered on its own, in step with the main output. */
+	std::vector<BlipBuffer> stem_blip_buffers;
+	std::vector<Resampler> stem_resamplers;
+	std::vector<OutputFilter> stem_output_filters;
+	std::array<f32, AudioCapture::num_stems> stem_output_levels{};
+	std::array<std::array<f32, sample_buffer_size_per_channel>, AudioCapture::num_stems> stem_sample_buffers{};
+
+	std::function<void(const f32*, size_t)> sample_block_listener;
+
+	std::vector<f32> synthesis_buffer = std::vector<f32>(synthesis_buffer_size);
+	std::array<f32, sample_buffer_size_per_channel> mono_sample_buffer{};
+	std::vector<f32> sample_buffer; /* Interleaved, 'num_output_channels' samples per frame */
+
+	/* Threaded rendering. When enabled, this APU runs in register-only mode on the emulation thread, and logs every register
+	   write and every DMC sample byte fetched, stamped with the cycle it happened on. A replica APU on a thread of its own replays
+	   the log: it runs up to the cycle of each write before applying it, and its DMC takes the fetched bytes in order instead of
+	   reading memory. Since the replica starts from the same state and sees the same writes on the same cycles, it makes the same
+	   output that this APU would have. Only the replica talks to the audio device, the listener and the capture, and it paces
+	   the emulation: this APU waits whenever it gets more than 'max_render_lead_in_cycles' ahead of the replica. */
+	enum class LoggedEventKind : u8 { RegisterWrite, DMCSampleByte, Advance };
+
+	struct LoggedEvent
+	{
+		u64 cycle; /* Cycles run by the APU when the event happened */
+		u16 addr;
+		u8 data;
+		LoggedEventKind kind;
+	};
+
+	static constexpr size_t render_event_log_capacity = 1 << 15;
+	static constexpr u64 render_advance_interval_in_cycles = 2048; /* How often the replica is allowed to run on when nothing is written */
+	static constexpr u64 max_render_lead_in_cycles = 65536; /* A little over two frames */
 
-	std::array<f32, sample_buffer_size> sample_buffer{};
+	std::unique_ptr<APU> render_replica;
+	std::unique_ptr<SPSCRingBuffer<LoggedEvent>> render_event_log;
+	std::thread render_thread;
+	std::mutex render_mutex; /* Held by the render thread while it runs the replica, and by other threads while they change its settings */
+	std::atomic<bool> stop_render_thread = false;
+	std::atomic<u64> rendered_cycle = 0; /* Written by the render thread: how far the replica has run */
+	u64 cycle_count = 0; /* CPU cycles run since power on */
+	u64 last_advance_cycle = 0;
 
-	std::chrono::steady_clock::time_point last_audio_enqueue_time_point = std::chrono::steady_clock::now();
+	/* In the replica only: it is never connected to the rest of the system. */
+	bool is_render_replica = false;
+	std::deque<u8> logged_sample_bytes;
 
 	/* Settings-related */
+	const bool default_render_on_thread = false;
+	bool render_on_thread = default_render_on_thread;
 	const bool default_audio_is_enabled = true;
 	bool audio_is_enabled = default_audio_is_enabled;
+	const Resampler::Quality default_resampler_quality = Resampler::Quality::High;
+	Resampler::Quality resampler_quality = default_resampler_quality;
 
 	void SetFrameCounterIRQLow()
 	{
 		frame_counter.interrupt = 1;
-		nes->cpu->SetIRQLow(IRQSource::APU_FRAME);
+		if (!is_render_replica)
+			nes->cpu->SetIRQLow(IRQSource::APU_FRAME);
 	}
 
 	void SetFrameCounterIRQHigh()
 	{
 		frame_counter.interrupt = 0;
-		nes->cpu->SetIRQHigh(IRQSource::APU_FRAME);
+		if (!is_render_replica)
+			nes->cpu->SetIRQHigh(IRQSource::APU_FRAME);
 	}
 
 	void SetDMCIRQLow()
 	{
 		dmc.interrupt = 1;
-		nes->cpu->SetIRQLow(IRQSource::APU_DMC);
+		if (!is_render_replica)
+			nes->cpu->SetIRQLow(IRQSource::APU_DMC);
 	}
 
 	void SetDMCIRQHigh()
 	{
 		dmc.interrupt = 0;
-		nes->cpu->SetIRQHigh(IRQSource::APU_DMC);
+		if (!is_render_replica)
+			nes->cpu->SetIRQHigh(IRQSource::APU_DMC);
 	}
 
-	void SampleAndMix();
+	void CatchUp();
+	void ClockCycle();
+	void CopyStateFrom(const APU& other);
+	void ConfigureOutput();
+	void FastForward(u32 num_cycles);
+	void FastForwardDMC(u32 num_cycles);
+	void LogEvent(LoggedEventKind kind, u16 addr, u8 data);
+	bool LogsEvents() const { return render_thread.joinable() && !output_suppressed; }
+	void Mix(u32 clock);
+	void MixStems(u32 clock);
+	void OutputSampleBlock();
+	void SetOutputFormat(unsigned sample_rate, unsigned num_channels);
+	void RenderLoop();
+	void ResetStems();
+	void RestartOutput();
+	void RunCycles(u32 num_cycles);
+	void ScheduleNextEvent();
+	void StartRenderThread();
+	void StartSampleBlock();
+	void StopRenderThread();
+	u32 CyclesUntilBlockEnd() const;
+	u32 CyclesUntilDMCSampleFetch() const;
+	bool HasAudioSink() const;
+	bool HaltFlagWriteIsPending() const;
+	void UpdateRegisterOnlyMode();
 };
\ No newline at end of file
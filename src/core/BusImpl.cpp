@@ -129,10 +129,12 @@ void BusImpl::WaitCycle()
 
 void BusImpl::UpdateLogging()
 {
+#ifdef DEBUG
 	if (!update_logging_on_next_cycle)
 		return;
 	Logging::Update();
 	update_logging_on_next_cycle = false;
+#endif
 }
 
 
@@ -51,41 +51,46 @@ void CPU::Run()
 	const unsigned cycle_run_len = 20000; /* A frame is roughly 30,000 cpu cycles. */
 	cpu_cycle_counter = 0; /* The ReadCycle/WriteCycle/WaitCycle functions increment this variable. */
 	while (cpu_cycle_counter < cycle_run_len)
+		Step();
+}
+
+
+void CPU::Step()
+{
+	/* Executes one instruction, OAM DMA transfer or interrupt, or waits a single cycle if the CPU is stopped or stalled. */
+	if (stopped)
 	{
-		if (stopped)
-		{
-			WaitCycle();
-			continue;
-		}
-
-		if (stalled)
-		{
-			if (--cpu_cycles_until_no_longer_stalled == 0)
-				stalled = false;
-			WaitCycle();
-			continue;
-		}
-
-		if (write_to_interrupt_disable_flag_before_next_instr)
-		{
-			flags.I = bit_to_write_to_interrupt_disable_flag;
-			write_to_interrupt_disable_flag_before_next_instr = false;
-		}
-		if (oam_dma_transfer_pending)
-		{
-			PerformOAMDMATransfer();
-		}
-		else
-		{
-			ExecuteInstruction();
-
-			// Check for pending interrupts (NMI and IRQ); NMI has higher priority than IRQ
-			// Interrupts are only polled after executing an instruction; multiple interrupts cannot be serviced in a row
-			if (polled_need_NMI)
-				ServiceInterrupt<InterruptType::NMI>();
-			else if (polled_need_IRQ && !flags.I)
-				ServiceInterrupt<InterruptType::IRQ>();
-		}
+		WaitCycle();
+		return;
+	}
+
+	if (stalled)
+	{
+		if (--cpu_cycles_until_no_longer_stalled == 0)
+			stalled = false;
+		WaitCycle();
+		return;
+	}
+
+	if (write_to_interrupt_disable_flag_before_next_instr)
+	{
+		flags.I = bit_to_write_to_interrupt_disable_flag;
+		write_to_interrupt_disable_flag_before_next_instr = false;
+	}
+	if (oam_dma_transfer_pending)
+	{
+		PerformOAMDMATransfer();
+	}
+	else
+	{
+		ExecuteInstruction();
+
+		// Check for pending interrupts (NMI and IRQ); NMI has higher priority than IRQ
+		// Interrupts are only polled after executing an instruction; multiple interrupts cannot be serviced in a row
+		if (polled_need_NMI)
+			ServiceInterrupt<InterruptType::NMI>();
+		else if (polled_need_IRQ && !flags.I)
+			ServiceInterrupt<InterruptType::IRQ>();
 	}
 }
 
@@ -1204,5 +1209,7 @@ void CPU::LogStateBeforeAction(Action action)
 	Logging::cpu_state.cpu_cycle_counter = total_cpu_cycle_counter;
 	Logging::cpu_state.NMI = action == Action::NMI;
 	Logging::cpu_state.IRQ = action == Action::IRQ;
+#ifdef DEBUG
 	nes->bus->update_logging_on_next_cycle = true;
+#endif
 }
\ No newline at end of file
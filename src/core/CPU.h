@@ -22,6 +22,7 @@ public:
 	void Run();
 	void RunStartUpCycles();
 	void Stall();
+	void Step();
 
 	__forceinline void PollInterruptInputs()
 	{
@@ -3,31 +3,29 @@
 
 std::optional<std::unique_ptr<BaseMapper>> Cartridge::ConstructMapperFromRom(const std::string& rom_path)
 {
-	/* Attempt to open the rom file */
-	std::ifstream rom_ifs{rom_path, std::ifstream::in | std::ifstream::binary};
-	if (!rom_ifs)
+	/* Attempt to map the rom file. It is not read; the mapper references it where it is (see RomImage). */
+	std::shared_ptr<const RomImage> rom_image = RomImage::Open(rom_path);
+	if (!rom_image)
 	{
 		UserMessage::Show("Failed to open rom file.", UserMessage::Type::Error);
 		return std::nullopt;
 	}
+	const std::span<const u8> rom = rom_image->GetData();
+	const size_t rom_size = rom.size();
 
-	/* Compute the rom file size */
-	rom_ifs.seekg(0, rom_ifs.end);
-	const size_t rom_size = rom_ifs.tellg();
-	rom_ifs.seekg(0, rom_ifs.beg);
-
-	/* Read and parse the rom header (16 bytes), containing properties of the cartridge/mapper. */
+	/* Parse the rom header (16 bytes), containing properties of the cartridge/mapper. */
 	std::array<u8, header_size> header{};
 	MapperProperties mapper_properties{rom_path};
-	rom_ifs.read((char*)header.data(), header_size);
+	std::copy_n(rom.begin(), std::min(rom_size, header_size), header.begin());
+	if (IsNSFHeader(header))
+		return ConstructNSFMapper(rom, mapper_properties);
 	bool success = ParseHeader(header, mapper_properties);
 	if (!success)
 		return std::nullopt;
 
-	/* Setup the various vectors (e.g.prg_rom, chr_rom) inside of the mapper, by reading the full rom file.
-	   The rom layout is the following:    header | trainer (optional) | PRG ROM | CHR ROM    */
+	/* The rom layout is the following:    header | trainer (optional) | PRG ROM | CHR ROM    */
 	const size_t trainer_size = 0x200;
-	const size_t prg_rom_start = header_size + (mapper_properties.has_trainer ? trainer_size : 0);
+	const size_t prg_rom_start = std::min(rom_size, header_size + (mapper_properties.has_trainer ? trainer_size : 0));
 	const size_t chr_prg_rom_size = rom_size - prg_rom_start;
 	const size_t header_specified_chr_prg_rom_size = mapper_properties.chr_size + mapper_properties.prg_rom_size;
 
@@ -39,25 +37,71 @@ std::optional<std::unique_ptr<BaseMapper>> Cartridge::ConstructMapperFromRom(con
 			chr_prg_rom_size, header_specified_chr_prg_rom_size), UserMessage::Type::Warning);
 	}
 
-	std::vector<u8> rom_vec{};
-	rom_vec.resize(chr_prg_rom_size);
-	rom_ifs.seekg(prg_rom_start);
-	rom_ifs.read((char*)rom_vec.data(), chr_prg_rom_size);
+	/* The mapper takes the sizes from the header. If the file is too small for them, give it a copy padded with $00. */
+	std::span<const u8> chr_prg_rom = rom.subspan(prg_rom_start);
+	if (chr_prg_rom_size < header_specified_chr_prg_rom_size)
+	{
+		std::vector<u8> padded_chr_prg_rom(header_specified_chr_prg_rom_size, 0x00);
+		std::copy(chr_prg_rom.begin(), chr_prg_rom.end(), padded_chr_prg_rom.begin());
+		rom_image = RomImage::FromBytes(std::move(padded_chr_prg_rom));
+		chr_prg_rom = rom_image->GetData();
+	}
 
 	/* Match, construct and return a mapper. If the construction fails (e.g. due to unsupported mapper detected), return. */
-	std::optional<std::unique_ptr<BaseMapper>> mapper = ConstructMapperFromMapperNumber(rom_vec, mapper_properties);
+	std::optional<std::unique_ptr<BaseMapper>> mapper = ConstructMapperFromMapperNumber(std::move(rom_image), chr_prg_rom, mapper_properties);
 	if (!mapper.has_value())
 		return std::nullopt;
 	return mapper;
 }
 
 
-std::optional<std::unique_ptr<BaseMapper>> Cartridge::ConstructMapperFromMapperNumber(const std::vector<u8> rom_vec, MapperProperties& mapper_properties)
+std::optional<std::unique_ptr<BaseMapper>> Cartridge::ConstructNSFMapper(const std::span<const u8> rom, MapperProperties& mapper_properties)
+{
+	std::array<u8, nsf_header_size> header{};
+	NSFProperties nsf_properties{};
+	if (rom.size() < nsf_header_size)
+	{
+		UserMessage::Show("Could not parse NSF header; the file is too small.", UserMessage::Type::Error);
+		return std::nullopt;
+	}
+	std::copy_n(rom.begin(), nsf_header_size, header.begin());
+	if (!ParseNSFHeader(header, mapper_properties, nsf_properties))
+		return std::nullopt;
+
+	/* NSF2 files may have metadata after the program data; its length is then given by the header (0 means until the end of the file). */
+	const size_t program_data_length_in_header = header[0x7D] | header[0x7E] << 8 | header[0x7F] << 16;
+	size_t program_data_size = rom.size() - nsf_header_size;
+	if (header[0x05] >= 2 && program_data_length_in_header > 0)
+		program_data_size = std::min(program_data_size, program_data_length_in_header);
+
+	/* The program data is loaded at 'load_addr'. Put it at that offset into the PRG image, so that the image starts on a bank boundary:
+	   at the start of bank 0 if the tune is bankswitched, and at $8000 if not, with $8000-$FFFF being the first eight banks.
+	   Since it is not aligned in the file, the image is a copy rather than a part of the mapped file. */
+	const size_t padding = nsf_properties.bankswitched ? nsf_properties.load_addr & (NSF::bank_size - 1) : nsf_properties.load_addr - 0x8000;
+	const size_t min_image_size = nsf_properties.bankswitched ? NSF::bank_size : 8 * NSF::bank_size;
+	const size_t image_size = std::max(min_image_size, (padding + program_data_size + NSF::bank_size - 1) & ~(NSF::bank_size - 1));
+
+	std::vector<u8> prg_image(image_size, 0x00);
+	const std::span<const u8> program_data = rom.subspan(nsf_header_size, std::min(program_data_size, image_size - padding));
+	std::copy(program_data.begin(), program_data.end(), prg_image.begin() + padding);
+
+	mapper_properties.prg_rom_size = image_size;
+	mapper_properties.has_chr_ram = true;
+
+	std::unique_ptr<BaseMapper> mapper = std::make_unique<NSF>(RomImage::FromBytes(std::move(prg_image)), mapper_properties, std::move(nsf_properties));
+	mapper->UpdatePageTables();
+	return std::make_optional(std::move(mapper));
+}
+
+
+std::optional<std::unique_ptr<BaseMapper>> Cartridge::ConstructMapperFromMapperNumber(std::shared_ptr<const RomImage> rom_image,
+	const std::span<const u8> chr_prg_rom, MapperProperties& mapper_properties)
 {
 	auto Instantiate = [&] <typename Mapper> () -> std::optional<std::unique_ptr<BaseMapper>>
 	{
-		return std::make_optional<std::unique_ptr<BaseMapper>>(
-			std::make_unique<Mapper>(rom_vec, mapper_properties));
+		std::unique_ptr<BaseMapper> mapper = std::make_unique<Mapper>(std::move(rom_image), chr_prg_rom, mapper_properties);
+		mapper->UpdatePageTables();
+		return std::make_optional(std::move(mapper));
 	};
 
 	switch (mapper_properties.mapper_num)
@@ -77,14 +121,42 @@ std::optional<std::unique_ptr<BaseMapper>> Cartridge::ConstructMapperFromMapperN
 }
 
 
+bool Cartridge::PeekHeader(const std::span<const u8> rom, MapperProperties& mapper_properties, std::optional<NSFProperties>& nsf_properties)
+{
+	std::array<u8, header_size> header{};
+	if (rom.size() < header_size)
+		return false;
+	std::copy_n(rom.begin(), header_size, header.begin());
+	if (!IsNSFHeader(header))
+		return ParseHeader(header, mapper_properties, false);
+
+	std::array<u8, nsf_header_size> nsf_header{};
+	if (rom.size() < nsf_header_size)
+		return false;
+	std::copy_n(rom.begin(), nsf_header_size, nsf_header.begin());
+	nsf_properties.emplace();
+	if (ParseNSFHeader(nsf_header, mapper_properties, nsf_properties.value(), false))
+		return true;
+	nsf_properties.reset();
+	return false;
+}
+
+
+bool Cartridge::IsNSFHeader(const std::array<u8, header_size>& header)
+{
+	return header[0] == 'N' && header[1] == 'E' && header[2] == 'S' && header[3] == 'M' && header[4] == 0x1A;
+}
+
+
 /* Returns true on success */
-bool Cartridge::ParseHeader(const std::array<u8, header_size>& header, MapperProperties& mapper_properties)
+bool Cartridge::ParseHeader(const std::array<u8, header_size>& header, MapperProperties& mapper_properties, const bool report_errors)
 {
 	// https://wiki.nesdev.org/w/index.php/NES_2.0#Identification
 	/* Check if the header is a valid iNES header */
 	if (!(header[0] == 'N' && header[1] == 'E' && header[2] == 'S' && header[3] == 0x1A))
 	{
-		UserMessage::Show("Could not parse rom file header; rom is not a valid iNES or NES 2.0 image file.", UserMessage::Type::Error);
+		if (report_errors)
+			UserMessage::Show("Could not parse rom file header; rom is not a valid iNES or NES 2.0 image file.", UserMessage::Type::Error);
 		return false;
 	}
 
@@ -123,7 +195,7 @@ void Cartridge::ParseFirstEightBytesOfHeader(const std::array<u8, header_size>&
 	mapper_properties.has_trainer            = header[6] & 0x04;
 	mapper_properties.hard_wired_four_screen = header[6] & 0x08;
 
-	mapper_properties.mapper_num = header[7] & 0xF0 | header[6] >> 4;
+	mapper_properties.mapper_num = (header[7] & 0xF0) | header[6] >> 4;
 }
 
 
@@ -182,4 +254,56 @@ void Cartridge::ParseNES20Header(const std::array<u8, header_size>& header, Mapp
 		case 3: return System::VideoStandard::Dendy;
 		}
 	}();
-}
\ No newline at end of file
+}
+
+
+/* Returns true on success */
+bool Cartridge::ParseNSFHeader(const std::array<u8, nsf_header_size>& header, MapperProperties& mapper_properties, NSFProperties& nsf_properties,
+	const bool report_errors)
+{
+	// https://wiki.nesdev.org/w/index.php?title=NSF#Header_Overview
+	auto ReadWord = [&](size_t offset) { return u16(header[offset] | header[offset + 1] << 8); };
+	auto ReadString = [&](size_t offset) {
+		const char* str = (const char*)&header[offset];
+		return std::string(str, std::find(str, str + 32, '\0'));
+	};
+
+	nsf_properties.num_songs = header[0x06];
+	nsf_properties.starting_song = header[0x07] > 0 ? header[0x07] - 1 : 0;
+	nsf_properties.load_addr = ReadWord(0x08);
+	nsf_properties.init_addr = ReadWord(0x0A);
+	nsf_properties.play_addr = ReadWord(0x0C);
+	nsf_properties.title = ReadString(0x0E);
+	nsf_properties.artist = ReadString(0x2E);
+	nsf_properties.copyright = ReadString(0x4E);
+
+	/* A rate of 0 is not valid; fall back to the rate of the vblank NMI, which is what nearly all tunes use. */
+	nsf_properties.play_period_ntsc_us = ReadWord(0x6E) > 0 ? ReadWord(0x6E) : 16639;
+	nsf_properties.play_period_pal_us = ReadWord(0x78) > 0 ? ReadWord(0x78) : 19997;
+
+	std::copy(header.begin() + 0x70, header.begin() + 0x78, nsf_properties.initial_banks.begin());
+	nsf_properties.bankswitched = std::any_of(nsf_properties.initial_banks.begin(), nsf_properties.initial_banks.end(), [](u8 bank) { return bank != 0; });
+	if (!nsf_properties.bankswitched)
+	{
+		for (u8 bank = 0; bank < 8; bank++)
+			nsf_properties.initial_banks[bank] = bank;
+	}
+
+	if (nsf_properties.num_songs == 0 || (!nsf_properties.bankswitched && nsf_properties.load_addr < 0x8000))
+	{
+		if (report_errors)
+			UserMessage::Show("Could not parse NSF header; the tune has no songs, or is loaded below $8000.", UserMessage::Type::Error);
+		return false;
+	}
+	nsf_properties.starting_song = std::min(nsf_properties.starting_song, nsf_properties.num_songs - 1);
+
+	/* Bit 0 is set for PAL tunes, and bit 1 for tunes made for both; those are played as NTSC. */
+	mapper_properties.video_standard = (header[0x7A] & 3) == 1 ? System::VideoStandard::PAL : System::VideoStandard::NTSC;
+
+	if (header[0x7B] != 0 && report_errors)
+	{
+		UserMessage::Show("The NSF tune uses an expansion sound chip, which is not emulated; its channels will be silent.",
+			UserMessage::Type::Warning);
+	}
+	return true;
+}
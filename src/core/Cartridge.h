@@ -1,23 +1,33 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <format>
-#include <fstream>
+#include <memory>
 #include <optional>
+#include <span>
+#include <string>
 #include <vector>
 
 #include "../gui/UserMessage.h"
 
+#include "RomImage.h"
+
 #include "mappers/BaseMapper.h"
 #include "mappers/MapperIncludes.h"
 #include "mappers/MapperProperties.h"
 
-/* This class is used to construct a mapper object given a rom file. */
+/* This class is used to construct a mapper object given a rom file; either an iNES/NES 2.0 image, or an NSF tune (see NSF). */
 class Cartridge final
 {
 public:
 	static std::optional<std::unique_ptr<BaseMapper>> ConstructMapperFromRom(const std::string& rom_path);
 
+	/* Parses the header at the start of 'rom' without constructing a mapper, and without telling the user about anything
+	   (used for listing roms; see RomLibrary). 'nsf_properties' is set if the file is an NSF tune.
+	   Returns false if the file is neither a rom nor a tune. */
+	static bool PeekHeader(std::span<const u8> rom, MapperProperties& mapper_properties, std::optional<NSFProperties>& nsf_properties);
+
 private:
 	/* The header will specify the rom size in units of the below. */
 	static constexpr size_t chr_bank_size     = 0x2000;
@@ -25,12 +35,18 @@ private:
 	static constexpr size_t prg_rom_bank_size = 0x4000;
 
 	static constexpr size_t header_size = 0x10;
+	static constexpr size_t nsf_header_size = 0x80;
 
-	static std::optional<std::unique_ptr<BaseMapper>> ConstructMapperFromMapperNumber(std::vector<u8> rom_vec, MapperProperties& mapper_properties);
+	static std::optional<std::unique_ptr<BaseMapper>> ConstructNSFMapper(std::span<const u8> rom, MapperProperties& mapper_properties);
+	static std::optional<std::unique_ptr<BaseMapper>> ConstructMapperFromMapperNumber(std::shared_ptr<const RomImage> rom_image,
+		std::span<const u8> chr_prg_rom, MapperProperties& mapper_properties);
 
-	static bool ParseHeader(const std::array<u8, header_size>& header, MapperProperties& properties);
+	static bool IsNSFHeader(const std::array<u8, header_size>& header);
+	static bool ParseHeader(const std::array<u8, header_size>& header, MapperProperties& properties, bool report_errors = true);
 	static void ParseFirstEightBytesOfHeader(const std::array<u8, header_size>& header, MapperProperties& properties);
 	static void ParseiNESHeader(const std::array<u8, header_size>& header, MapperProperties& properties);
 	static void ParseNES20Header(const std::array<u8, header_size>& header, MapperProperties& properties);
+	static bool ParseNSFHeader(const std::array<u8, nsf_header_size>& header, MapperProperties& properties, NSFProperties& nsf_properties,
+		bool report_errors = true);
 };
 
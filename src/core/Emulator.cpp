@@ -35,26 +35,10 @@ void Emulator::LoadState()
 		return;
 	}
 
-	const std::string save_state_path = current_rom_path + save_state_path_postfix;
-	SerializationStream stream{ save_state_path, SerializationStream::Mode::Deserialization };
-	if (stream.HasError())
-	{
-		UserMessage::Show("Save state does not exist or could not be opened.", UserMessage::Type::Error);
-		load_state_on_next_cycle = false;
-		return;
-	}
-
-	for (auto& snapshottable : snapshottable_components)
-		snapshottable->StreamState(stream);
-
-	if (stream.HasError())
-	{
-		UserMessage::Show("Save state does not exist or could not be opened.", UserMessage::Type::Error);
-		load_state_on_next_cycle = false;
+	load_state_on_next_cycle = false;
+	if (!LoadStateFromFile(current_rom_path + save_state_path_postfix))
 		return;
-	}
 
-	load_state_on_next_cycle = false;
 	if (emu_is_paused)
 		Resume();
 }
@@ -75,26 +59,110 @@ void Emulator::SaveState()
 		return;
 	}
 
-	const std::string save_state_path = current_rom_path + save_state_path_postfix;
-	SerializationStream stream{ save_state_path, SerializationStream::Mode::Serialization };
-	if (stream.HasError())
-	{
+	save_state_on_next_cycle = false;
+	std::vector<u8> state;
+	SaveStateToMemory(state);
+	if (!StateFormat::WriteFile(current_rom_path + save_state_path_postfix, state, compress_save_states))
 		UserMessage::Show("Save state could not be created.", UserMessage::Type::Error);
-		save_state_on_next_cycle = false;
-		return;
+}
+
+
+/* Returns true on success. On failure, the user is told why, and the state of the machine is left as it was. */
+bool Emulator::LoadStateFromFile(const std::string& path)
+{
+	std::vector<u8> state;
+	switch (StateFormat::ReadFile(path, state))
+	{
+	case StateFormat::FileError::None:
+		break;
+	case StateFormat::FileError::CannotOpen:
+		UserMessage::Show("Save state does not exist or could not be opened.", UserMessage::Type::Error);
+		return false;
+	case StateFormat::FileError::NotASaveState:
+		UserMessage::Show("Save state was made by an older version of the emulator, or is not a save state, and cannot be loaded.", UserMessage::Type::Error);
+		return false;
+	case StateFormat::FileError::OtherVersion:
+		UserMessage::Show("Save state was made by another version of the emulator, and cannot be loaded.", UserMessage::Type::Error);
+		return false;
+	case StateFormat::FileError::Corrupt:
+		UserMessage::Show("Save state is corrupt.", UserMessage::Type::Error);
+		return false;
 	}
 
-	for (auto& snapshottable : snapshottable_components)
-		snapshottable->StreamState(stream);
+	/* A state that is corrupt may only be found not to fit partway through loading it */
+	std::vector<u8> current_state;
+	SaveStateToMemory(current_state);
+	if (!LoadStateFromMemory(state))
+	{
+		LoadStateFromMemory(current_state);
+		UserMessage::Show("Save state is not of this game, or is corrupt.", UserMessage::Type::Error);
+		return false;
+	}
+	return true;
+}
+
+
+void Emulator::SaveStateToMemory(std::vector<u8>& state)
+{
+	state.clear();
+	const size_t rom_chunk_pos = StateFormat::BeginChunk(state, rom_chunk_id);
+	const u64 hash = GetRomHash();
+	state.insert(state.end(), (const u8*)&hash, (const u8*)&hash + sizeof(u64));
+	StateFormat::EndChunk(state, rom_chunk_pos);
 
-	if (stream.HasError())
+	for (size_t i = 0; i < snapshottable_components.size(); i++)
 	{
-		UserMessage::Show("Save state could not be created.", UserMessage::Type::Error);
-		save_state_on_next_cycle = false;
-		return;
+		const size_t chunk_pos = StateFormat::BeginChunk(state, state_chunk_ids[i]);
+		SerializationStream stream{ state };
+		snapshottable_components[i]->StreamState(stream);
+		StateFormat::EndChunk(state, chunk_pos);
+	}
+}
+
+
+bool Emulator::LoadStateFromMemory(const std::span<const u8> state)
+{
+	/* The state must be of this rom, and every chunk is found, before any is loaded */
+	StateFormat::ChunkReader chunks{ state };
+	const std::optional<std::span<const u8>> rom_chunk = chunks.Next(rom_chunk_id);
+	if (!rom_chunk || rom_chunk->size() != sizeof(u64))
+		return false;
+	u64 hash;
+	std::memcpy(&hash, rom_chunk->data(), sizeof(u64));
+	if (hash != GetRomHash())
+		return false;
+	for (size_t i = 0; i < snapshottable_components.size(); i++)
+	{
+		if (!chunks.Next(state_chunk_ids[i]))
+			return false;
 	}
+	if (!chunks.ReachedEnd())
+		return false;
+
+	/* Each component must load all of its chunk and no more */
+	bool success = true;
+	chunks = StateFormat::ChunkReader{ state };
+	chunks.Next(rom_chunk_id);
+	for (size_t i = 0; i < snapshottable_components.size(); i++)
+	{
+		SerializationStream stream{ *chunks.Next(state_chunk_ids[i]) };
+		snapshottable_components[i]->StreamState(stream);
+		success = success && !stream.HasError() && stream.ReachedEnd();
+	}
+	nes.mapper->UpdatePageTables();
+	return success;
+}
 
-	save_state_on_next_cycle = false;
+
+/* Identifies the rom in save states, so that a state of another game, or of another version or dump of it, is refused. */
+u64 Emulator::GetRomHash()
+{
+	if (!rom_hash)
+	{
+		const std::span<const u8> rom = nes.mapper->GetRomData();
+		rom_hash = Hash::FNV1a(rom.data(), rom.size());
+	}
+	return *rom_hash;
 }
 
 
@@ -113,6 +181,53 @@ bool Emulator::SetupSDLVideo(const void* window_handle)
 
 /* Returns true on success, otherwise false. */
 bool Emulator::PrepareLaunchOfGame(const std::string& rom_path)
+{
+	if (!LoadGame(rom_path))
+		return false;
+
+	nes.apu->OpenAudioDevice();
+
+	/* Read potential save data */
+	nes.mapper->ReadPRGRAMFromDisk();
+
+	return true;
+}
+
+
+/* Returns true on success, otherwise false. */
+bool Emulator::PrepareHeadlessRun(const std::string& rom_path)
+{
+	/* Headless runs must give the same result every time, so they use the default settings rather than those of the user,
+	   never wait for the audio device, and start without save data. */
+	for (Configurable* configurable : GetConfigurableComponents())
+		configurable->SetDefaultConfig();
+	nes.apu->DisableAudio();
+
+	if (!LoadGame(rom_path))
+		return false;
+
+	nes.cpu->RunStartUpCycles();
+	return true;
+}
+
+
+void Emulator::RunFrame()
+{
+	if (nsf_bus)
+	{
+		const u64 num_play_periods = nsf_bus->GetNumPlayPeriods();
+		while (nsf_bus->GetNumPlayPeriods() == num_play_periods)
+			nes.cpu->Step();
+		return;
+	}
+	const u64 frame_count = nes.ppu->GetFrameCount();
+	while (nes.ppu->GetFrameCount() == frame_count)
+		nes.cpu->Step();
+}
+
+
+/* Constructs the mapper and powers on the system. Returns true on success, otherwise false. */
+bool Emulator::LoadGame(const std::string& rom_path)
 {
 	// Construct a mapper class instance given the rom file. If it failed (e.g. if the mapper is not supported), return.
 	std::optional<std::unique_ptr<BaseMapper>> mapper_opt = Cartridge::ConstructMapperFromRom(rom_path);
@@ -122,6 +237,24 @@ bool Emulator::PrepareLaunchOfGame(const std::string& rom_path)
 	snapshottable_components.push_back(nes.mapper.get());
 
 	this->current_rom_path = rom_path;
+	rom_hash.reset();
+	rewinder.Clear();
+	run_ahead_instance.reset();
+	run_ahead_instance_failed = false;
+
+	/* NSF tunes are played without a PPU, on a bus of their own. */
+	if (NSF* nsf = dynamic_cast<NSF*>(nes.mapper.get()))
+	{
+		std::unique_ptr<NSFBus> bus = std::make_unique<NSFBus>(&nes);
+		bus->LoadTune(nsf);
+		nsf_bus = bus.get();
+		ReplaceBus(std::move(bus));
+	}
+	else if (nsf_bus)
+	{
+		nsf_bus = nullptr;
+		ReplaceBus(std::make_unique<BusImpl>(&nes));
+	}
 
 	nes.bus->Reset();
 
@@ -131,9 +264,29 @@ bool Emulator::PrepareLaunchOfGame(const std::string& rom_path)
 	nes.cpu->PowerOn();
 	nes.ppu->PowerOn(video_standard);
 
-	/* Read potential save data */
-	nes.mapper->ReadPRGRAMFromDisk();
+	return true;
+}
+
+
+void Emulator::ReplaceBus(std::unique_ptr<Bus> bus)
+{
+	/* The bus keeps its place among the components streamed with save states. */
+	std::replace(snapshottable_components.begin(), snapshottable_components.end(),
+		static_cast<Snapshottable*>(nes.bus.get()), static_cast<Snapshottable*>(bus.get()));
+	nes.bus = std::move(bus);
+}
+
 
+bool Emulator::SelectNSFSong(unsigned song)
+{
+	if (!nsf_bus || song >= GetNumNSFSongs())
+		return false;
+	nsf_bus->SelectSong(song);
+	nes.apu->Reset();
+	nes.bus->Reset();
+	nes.cpu->Reset();
+	if (emu_is_running)
+		EmulatorLoop();
 	return true;
 }
 
@@ -162,9 +315,19 @@ void Emulator::EmulatorLoop()
 		else if (save_state_on_next_cycle)
 			SaveState();
 
-		// Run the CPU for roughly 2/3 of a frame (exact timing is not important; audio/video synchronization is done by the APU).
+		// Run the CPU for roughly 2/3 of a frame (exact timing is not important; audio/video synchronization is done by the APU),
+		// or for a whole frame and then some when running ahead. While rewind is held, step back through the rewind history instead.
 		try {
-			nes.cpu->Run();
+			if (!nes.joypad->IsRewindHeld() || !RewindOneState())
+			{
+				if (run_ahead_frames > 0 && !nsf_bus && run_ahead_on_second_instance)
+					RunAheadFrameOnSecondInstance();
+				else if (run_ahead_frames > 0 && !nsf_bus)
+					RunAheadFrame();
+				else
+					nes.cpu->Run();
+				PushRewindState();
+			}
 		}
 		catch (const std::runtime_error& e)
 		{
@@ -187,14 +350,114 @@ void Emulator::EmulatorLoop()
 			microseconds_since_fps_update -= microseconds_per_fps_update;
 		}
 
+		// save data is only copied here, and only if it has changed; it is written on a thread of its own (see SaveDataWriter)
 		microseconds_since_save_data_flushed_to_disk += microseconds_elapsed;
-		const long long microseconds_per_save_data_flush = 5'000'000;
+		const long long microseconds_per_save_data_flush = 1'000'000;
 		if (microseconds_since_save_data_flushed_to_disk >= microseconds_per_save_data_flush && emu_is_running)
 		{
-			nes.mapper->WritePRGRAMToDisk();
+			nes.mapper->WritePRGRAMToDisk(save_data_writer);
 			microseconds_since_save_data_flushed_to_disk -= microseconds_per_save_data_flush;
+			if (save_data_writer.TakeWriteFailure())
+				UserMessage::Show("Save file creation failed!", UserMessage::Type::Error);
+		}
+	}
+}
+
+
+void Emulator::PushRewindState()
+{
+	if (!rewinder.IsEnabled() || nsf_bus)
+		return;
+	const u64 frame_count = GetFrameCountExcludingRunAhead();
+	if (frame_count - frame_of_last_rewind_state < rewinder.GetInterval())
+		return;
+	SaveStateToMemory(rewind_state);
+	rewinder.Push(rewind_state);
+	frame_of_last_rewind_state = frame_count;
+}
+
+
+/* Goes back to the newest state in the rewind history, and runs a frame from there to show it.
+   Returns false if there is nothing to go back to. */
+bool Emulator::RewindOneState()
+{
+	if (!rewinder.IsEnabled() || nsf_bus || !rewinder.Pop(rewind_state))
+		return false;
+	if (!LoadStateFromMemory(rewind_state))
+	{
+		/* Cannot happen with states taken from this game; but if it did, the machine would be left half-loaded. */
+		rewinder.Clear();
+		throw std::runtime_error("Failed to load a rewind state.");
+	}
+	RunFrame();
+	frame_of_last_rewind_state = GetFrameCountExcludingRunAhead();
+	return true;
+}
+
+
+/* Runs a frame, and then 'run_ahead_frames' frames more, of which only the last is shown; then goes back to the end of the first.
+   The audio of the first frame is heard; that of the others is not. */
+void Emulator::RunAheadFrame()
+{
+	nes.ppu->SuppressFrameOutput(true);
+	RunFrame();
+	SaveStateToMemory(run_ahead_state);
+	nes.apu->SuppressOutput(true);
+	for (unsigned i = 1; i < run_ahead_frames; i++)
+		RunFrame();
+	nes.ppu->SuppressFrameOutput(false);
+	RunFrame();
+	num_frames_run_ahead += run_ahead_frames;
+	const bool success = LoadStateFromMemory(run_ahead_state);
+	nes.apu->SuppressOutput(false);
+	if (!success)
+		throw std::runtime_error("Failed to go back after running ahead.");
+}
+
+
+/* Like RunAheadFrame, but the frames ahead are run by the second instance, from the state at the start of the frame,
+   while this instance runs the frame itself. */
+void Emulator::RunAheadFrameOnSecondInstance()
+{
+	/* If the second instance cannot be started, the setting is kept, but this game is run ahead on this instance */
+	if (run_ahead_instance_failed)
+	{
+		RunAheadFrame();
+		return;
+	}
+	if (!run_ahead_instance)
+	{
+		run_ahead_instance = std::make_unique<RunAheadInstance>();
+		if (!run_ahead_instance->Start(current_rom_path))
+		{
+			run_ahead_instance.reset();
+			run_ahead_instance_failed = true;
+			UserMessage::Show("Could not start a second instance for run-ahead; running ahead on this one instead.", UserMessage::Type::Warning);
+			RunAheadFrame();
+			return;
 		}
 	}
+
+	SaveStateToMemory(run_ahead_state);
+	const u8 buttons[2] = { nes.joypad->GetButtonStates(Joypad::Player::ONE), nes.joypad->GetButtonStates(Joypad::Player::TWO) };
+	run_ahead_instance->Submit(run_ahead_state, buttons, run_ahead_frames + 1);
+
+	nes.ppu->SuppressFrameOutput(true);
+	RunFrame();
+	nes.ppu->SuppressFrameOutput(false);
+
+	if (!run_ahead_instance->Wait())
+		throw std::runtime_error("Failed to run ahead on the second instance.");
+	nes.ppu->PresentFrame(run_ahead_instance->GetFrameBuffer());
+}
+
+
+void Emulator::SetRunAheadOnSecondInstance(const bool enabled)
+{
+	run_ahead_on_second_instance = enabled;
+	run_ahead_instance_failed = false;
+	if (!enabled)
+		run_ahead_instance.reset();
 }
 
 
@@ -228,8 +491,27 @@ void Emulator::Stop()
 {
 	if (emu_is_running)
 	{
-		nes.mapper->WritePRGRAMToDisk();
+		nes.mapper->WritePRGRAMToDisk(save_data_writer);
+		save_data_writer.Flush(); /* The save file is read again if the game is started again */
+		if (save_data_writer.TakeWriteFailure())
+			UserMessage::Show("Save file creation failed!", UserMessage::Type::Error);
 		snapshottable_components.pop_back(); /* Remove mapper pointer (always last in the list) */
+		run_ahead_instance.reset();
 		emu_is_running = false;
 	}
+}
+
+
+void Emulator::StreamConfig(SerializationStream& stream)
+{
+	stream.StreamPrimitive(run_ahead_frames);
+	stream.StreamPrimitive(run_ahead_on_second_instance);
+	run_ahead_frames = std::min(run_ahead_frames, max_run_ahead_frames);
+}
+
+
+void Emulator::SetDefaultConfig()
+{
+	run_ahead_frames = default_run_ahead_frames;
+	SetRunAheadOnSecondInstance(default_run_ahead_on_second_instance);
 }
\ No newline at end of file
@@ -1,14 +1,23 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <span>
 #include <thread>
 #include <vector>
 
 #include "SDL.h"
 
 #include "../Configurable.h"
+#include "../Hash.h"
 #include "../Observer.h"
 #include "../Snapshottable.h"
+#include "../StateFormat.h"
 
 #include "../gui/AppUtils.h"
 #include "../gui/UserMessage.h"
@@ -20,19 +29,39 @@
 #include "CPU.h"
 #include "Joypad.h"
 #include "NES.h"
+#include "NSFBus.h"
 #include "PPU.h"
+#include "Rewinder.h"
+#include "RunAheadInstance.h"
+#include "SaveDataWriter.h"
 
-class Emulator final
+class Emulator final : public Configurable
 {
 public:
 	Emulator();
 
 	bool emu_is_paused = false, emu_is_running = false;
 
-	Observer* gui;
+	Observer* gui = nullptr;
 
 	[[nodiscard]] bool PrepareLaunchOfGame(const std::string& rom_path);
 
+	/* Headless operation: no window, audio device or input polling, and save data is neither read nor written.
+	   The caller drives the emulation one frame at a time, and supplies the input. Independent instances may run on different threads. */
+	[[nodiscard]] bool PrepareHeadlessRun(const std::string& rom_path);
+	/* Runs until the PPU has finished a frame, or, when an NSF tune is loaded, for one period of its play timer. */
+	void RunFrame();
+	const std::vector<u16>& GetFrameBuffer() const { return nes.ppu->GetFrameBuffer(); }
+	void SetButtonStates(u8 buttons, Joypad::Player player) { nes.joypad->SetButtonStates(buttons, player); }
+	void SetSampleBlockListener(std::function<void(const f32*, size_t)> listener) { nes.apu->SetSampleBlockListener(std::move(listener)); }
+
+	/* NSF tunes are loaded like any rom, and played on a machine without a PPU (see NSFBus). Songs count from 0. */
+	bool IsPlayingNSF() const { return nsf_bus != nullptr; }
+	unsigned GetNSFSong() const { return nsf_bus ? nsf_bus->GetSong() : 0; }
+	unsigned GetNumNSFSongs() const { return nsf_bus ? static_cast<const NSF&>(*nes.mapper).GetNSFProperties().num_songs : 0; }
+	/* Starts the given song from the beginning. Returns false if no tune is loaded, or if it has no such song. */
+	bool SelectNSFSong(unsigned song);
+
 	void LaunchGame();
 	void Pause();
 	void Reset();
@@ -41,12 +70,64 @@ public:
 	void LoadState();
 	void SaveState();
 
+	/* Save states held in memory rather than in a file (for rewind and run-ahead; see StateFormat). Saving into the same buffer
+	   again allocates nothing, and a state takes microseconds to save or load. Must be called between frames (see RunFrame).
+	   Loading returns false if 'state' is not a state of the game that is running. If it is of another rom, or its chunks are not
+	   those of the components of the system, nothing is loaded; if the data of one of them does not fit, the machine is left in
+	   an undefined state. */
+	void SaveStateToMemory(std::vector<u8>& state);
+	bool LoadStateFromMemory(std::span<const u8> state);
+
 	void AddObserver(Observer* observer);
 	bool SetupSDLVideo(const void* window_handle);
 
+	void SetFrameSkip(unsigned frames) { nes.ppu->SetFrameSkip(frames); }
+	void SetVideoFilter(VideoOutput::Filter filter) { nes.ppu->SetVideoFilter(filter); }
+	void SetAudioQuality(Resampler::Quality quality) { nes.apu->SetResamplerQuality(quality); }
+	void SetAudioRenderedOnThread(bool enabled) { nes.apu->SetRenderOnThread(enabled); }
 	void SetWindowScale(unsigned scale) { nes.ppu->SetWindowScale(scale); }
 	void SetWindowSize(unsigned width, unsigned height) { nes.ppu->SetWindowSize(width, height); }
 
+	/* Records the frames to a file (see VideoCapture). */
+	[[nodiscard]] bool StartVideoCapture(const std::string& path, VideoCapture::Format format, VideoCapture::OverflowPolicy overflow_policy)
+	{
+		return nes.ppu->StartVideoCapture(path, format, overflow_policy);
+	}
+	bool StopVideoCapture() { return nes.ppu->StopVideoCapture(); }
+	bool IsCapturingVideo() const { return nes.ppu->IsCapturingVideo(); }
+	u64 GetNumDroppedVideoCaptureFrames() const { return nes.ppu->GetNumDroppedVideoCaptureFrames(); }
+
+	/* Records the audio output to a file, and optionally each channel to a file of its own (see AudioCapture). */
+	[[nodiscard]] bool StartAudioCapture(const std::string& path, AudioCapture::Format format, AudioCapture::SampleFormat sample_format, bool record_stems)
+	{
+		return nes.apu->StartAudioCapture(path, format, sample_format, record_stems);
+	}
+	bool StopAudioCapture() { return nes.apu->StopAudioCapture(); }
+	bool IsCapturingAudio() const { return nes.apu->IsCapturingAudio(); }
+
+	/* For the PPU viewer (see PPUViewer). */
+	PPUSnapshotChannel& GetPPUSnapshotChannel() { return nes.ppu->GetSnapshotChannel(); }
+	const std::array<u32, 512>& GetRGBPalette() const { return nes.ppu->GetRGBPalette(); }
+
+	unsigned GetFrameSkip() const { return nes.ppu->GetFrameSkip(); }
+	VideoOutput::Filter GetVideoFilter() const { return nes.ppu->GetVideoFilter(); }
+	Resampler::Quality GetAudioQuality() const { return nes.apu->GetResamplerQuality(); }
+	bool AudioIsRenderedOnThread() const { return nes.apu->RendersOnThread(); }
+	/* Hold-to-rewind (see Rewinder). The history is cleared when a setting is changed, and when a game is loaded. NSF tunes are not rewound. */
+	void SetRewindEnabled(bool enabled) { rewinder.SetEnabled(enabled); }
+	void SetRewindDuration(unsigned seconds) { rewinder.SetDuration(seconds); }
+	bool RewindIsEnabled() const { return rewinder.IsEnabled(); }
+	unsigned GetRewindDuration() const { return rewinder.GetDuration(); }
+	/* Run-ahead: every frame, the emulation runs 'frames' frames further with the same input, shows the last of them, and goes back;
+	   which hides as many frames of the game's own input lag, at the cost of emulating 'frames' + 1 frames per frame shown.
+	   0 turns it off. NSF tunes are not run ahead, and neither is the emulation while it is rewound. */
+	void SetRunAheadFrames(unsigned frames) { run_ahead_frames = std::min(frames, max_run_ahead_frames); }
+	unsigned GetRunAheadFrames() const { return run_ahead_frames; }
+	/* Whether the frames ahead are run by a second instance of the emulator on another thread (see RunAheadInstance), rather than by
+	   this one. That takes a second core, but little more time on this thread than running without run-ahead. */
+	void SetRunAheadOnSecondInstance(bool enabled);
+	bool RunsAheadOnSecondInstance() const { return run_ahead_on_second_instance; }
+
 	unsigned GetWindowScale() const { return nes.ppu->GetWindowScale(); }
 	unsigned GetWindowHeight() const { return nes.ppu->GetWindowHeight(); }
 	unsigned GetWindowWidth() const { return nes.ppu->GetWindowWidth(); }
@@ -56,19 +137,62 @@ public:
 	void CapFramerate() { nes.apu->EnableAudio(); }
 	void UncapFramerate() { nes.apu->DisableAudio(); }
 
-	std::vector<Configurable*> GetConfigurableComponents() { return { nes.apu.get(), nes.joypad.get(), nes.ppu.get() }; }
+	std::vector<Configurable*> GetConfigurableComponents() { return { nes.apu.get(), nes.joypad.get(), nes.ppu.get(), &rewinder, this }; }
+
+	void StreamConfig(SerializationStream& stream) override;
+	void SetDefaultConfig() override;
 
 private:
 	const std::string save_state_path_postfix = "_SAVE_STATE.bin";
 
+	static constexpr bool compress_save_states = true;
+	/* States start with a chunk that holds the hash of the rom that they are of (see GetRomHash). */
+	static constexpr u32 rom_chunk_id = StateFormat::ChunkID("ROM ");
+	/* The chunk of a save state that each of 'snapshottable_components' is saved in, by index; the mapper is always last. */
+	static constexpr std::array<u32, 6> state_chunk_ids = {
+		StateFormat::ChunkID("APU "), StateFormat::ChunkID("BUS "), StateFormat::ChunkID("CPU "),
+		StateFormat::ChunkID("JOY "), StateFormat::ChunkID("PPU "), StateFormat::ChunkID("MAP ")
+	};
+
+	static constexpr unsigned max_run_ahead_frames = 4;
+	static constexpr unsigned default_run_ahead_frames = 0;
+	static constexpr bool default_run_ahead_on_second_instance = false;
+
 	bool load_state_on_next_cycle = false, save_state_on_next_cycle = false;
 
 	NES nes;
 
+	SaveDataWriter save_data_writer;
+
+	Rewinder rewinder;
+	std::vector<u8> rewind_state; /* Reused for every state pushed to or popped from the rewinder */
+	u64 frame_of_last_rewind_state = 0;
+
+	unsigned run_ahead_frames = default_run_ahead_frames;
+	bool run_ahead_on_second_instance = default_run_ahead_on_second_instance;
+	std::vector<u8> run_ahead_state; /* Reused every frame */
+	std::unique_ptr<RunAheadInstance> run_ahead_instance; /* Started on the first frame that it runs ahead for, for the game that is running */
+	bool run_ahead_instance_failed = false; /* The instance could not be started for the game that is running */
+	u64 num_frames_run_ahead = 0; /* Frames that were run ahead and undone since power on; they are counted by the PPU all the same */
+
 	std::string current_rom_path;
+	std::optional<u64> rom_hash; /* Of the game that is running; computed when first needed, as it reads all of the rom */
 
 	std::vector<Snapshottable*> snapshottable_components{};
 
+	NSFBus* nsf_bus = nullptr; /* Set while an NSF tune is loaded, in which case it is 'nes.bus' */
+
 	void EmulatorLoop();
+	u64 GetFrameCountExcludingRunAhead() const { return nes.ppu->GetFrameCount() - num_frames_run_ahead; }
+	u64 GetRomHash();
+	void PushRewindState();
+	void RunAheadFrame();
+	void RunAheadFrameOnSecondInstance();
+	bool RewindOneState();
+	bool LoadGame(const std::string& rom_path);
+	bool LoadStateFromFile(const std::string& path);
+	void ReplaceBus(std::unique_ptr<Bus> bus);
+
+	friend class RunAheadInstance;
 };
 
@@ -100,6 +100,25 @@ void Joypad::OpenGameControllers()
 }
 
 
+/* The buttons held by a player, in the form taken by SetButtonStates. */
+u8 Joypad::GetButtonStates(const Player player) const
+{
+	u8 buttons = 0;
+	for (int button = 0; button < num_buttons; button++)
+		buttons |= buttons_currently_held[button][player] << button;
+	return buttons;
+}
+
+
+/* Sets which buttons are held by a player, bypassing the input bindings; bit n of 'buttons' is the state of Button n.
+   Used to feed scripted input to an emulator that does not poll SDL for events. */
+void Joypad::SetButtonStates(const u8 buttons, const Player player)
+{
+	for (int button = 0; button < num_buttons; button++)
+		buttons_currently_held[button][player] = buttons >> button & 1;
+}
+
+
 void Joypad::PollInput()
 {
 	while (SDL_PollEvent(&event))
@@ -107,11 +126,15 @@ void Joypad::PollInput()
 		switch (event.type)
 		{
 		case SDL_KEYDOWN:
+			if (event.key.keysym.sym == rewind_key)
+				rewind_held = true;
 			// TODO: identify the player number...
 			MatchInputToBindings(event.key.keysym.sym, InputEvent::PRESS, InputMethod::KEYBOARD, Player::ONE);
 			break;
 
 		case SDL_KEYUP:
+			if (event.key.keysym.sym == rewind_key)
+				rewind_held = false;
 			MatchInputToBindings(event.key.keysym.sym, InputEvent::RELEASE, InputMethod::KEYBOARD, Player::ONE);
 			break;
 
@@ -27,10 +27,15 @@ public:
 	void ResetBindings(Player player);
 	void RevertBindingChanges();
 	void SaveBindings();
+	u8 GetButtonStates(Player player) const;
+	void SetButtonStates(u8 buttons, Player player);
 	void UnbindAll(Player player);
 	void UpdateBinding(Button button, SDL_GameControllerButton bind, Player player);
 	void UpdateBinding(Button button, SDL_Keycode key, Player player);
 
+	/* Whether the rewind key is held (see Emulator). It is not one of the NES buttons, and not bindable for now. */
+	bool IsRewindHeld() const { return rewind_held; }
+
 	void StreamConfig(SerializationStream& stream) override;
 	void StreamState(SerializationStream& stream) override;
 	void SetDefaultConfig() override;
@@ -49,6 +54,9 @@ private:
 
 	static const unsigned num_buttons = 8;
 
+	static constexpr SDL_Keycode rewind_key = SDLK_r;
+
+	bool rewind_held = false;
 	bool strobe = 0;
 	bool strobe_seq_completed = false;
 
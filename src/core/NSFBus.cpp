@@ -0,0 +1,156 @@
+#include "NSFBus.h"
+
+
+void NSFBus::LoadTune(NSF* nsf)
+{
+	this->nsf = nsf;
+	const NSFProperties& properties = nsf->GetNSFProperties();
+	song = properties.starting_song;
+	play_period = nsf->GetVideoStandard() == System::VideoStandard::PAL
+		? u64(properties.play_period_pal_us) * cpu_cycles_per_sec_pal
+		: u64(properties.play_period_ntsc_us) * cpu_cycles_per_sec_ntsc;
+	UpdateDriver();
+}
+
+
+void NSFBus::SelectSong(unsigned song)
+{
+	this->song = song;
+	UpdateDriver();
+}
+
+
+void NSFBus::UpdateDriver()
+{
+	const NSFProperties& properties = nsf->GetNSFProperties();
+	driver = driver_template;
+	driver[song_operand_offset] = u8(song);
+	driver[region_operand_offset] = nsf->GetVideoStandard() == System::VideoStandard::PAL;
+	driver[init_operand_offset] = properties.init_addr & 0xFF;
+	driver[init_operand_offset + 1] = properties.init_addr >> 8;
+	driver[play_operand_offset] = properties.play_addr & 0xFF;
+	driver[play_operand_offset + 1] = properties.play_addr >> 8;
+}
+
+
+void NSFBus::Reset()
+{
+	ram.fill(0);
+	nsf->Reset();
+	play_timer = 0;
+	play_pending = false;
+	nes->cpu->SetNMIHigh();
+}
+
+
+u8 NSFBus::Read(u16 addr)
+{
+	// Internal RAM ($0000 - $1FFF)
+	if (addr <= 0x1FFF)
+	{
+		return ram[addr & 0x7FF]; // wrap address to between 0-0x7FF
+	}
+
+	// The reset and NMI vectors point into the driver; the IRQ/BRK vector is the tune's.
+	if (addr >= Bus::Addr::NMI_VEC && addr < Bus::Addr::IRQ_BRK_VEC)
+	{
+		switch (addr)
+		{
+		case Bus::Addr::NMI_VEC:
+			/* The CPU is taking the NMI; let go of the line, so that the next one is seen as a new edge. */
+			nes->cpu->SetNMIHigh();
+			return (driver_addr + nmi_handler_offset) & 0xFF;
+		case Bus::Addr::NMI_VEC + 1:
+			return (driver_addr + nmi_handler_offset) >> 8;
+		case Bus::Addr::RESET_VEC:
+			return driver_addr & 0xFF;
+		default:
+			return driver_addr >> 8;
+		}
+	}
+
+	// Cartridge Space ($4020 - $FFFF)
+	if (addr >= 0x4020)
+	{
+		return nes->mapper->ReadPRG(addr);
+	}
+
+	// The driver ($3F00 - $3F26), where the PPU registers would be mirrored; the rest of $2000 - $3FFF is unmapped.
+	if (addr >= driver_addr && addr < driver_addr + driver_size)
+	{
+		/* Raise the NMI for PLAY when it is due, and the driver is idling. */
+		if (addr == driver_addr + idle_loop_offset && play_pending)
+		{
+			nes->cpu->SetNMILow();
+			play_pending = false;
+		}
+		return driver[addr - driver_addr];
+	}
+	if (addr <= 0x3FFF)
+	{
+		return 0xFF;
+	}
+
+	// APU & I/O Registers ($4000-$4017); there are no joypads.
+	if (addr <= 0x4017)
+	{
+		return nes->apu->ReadRegister(addr);
+	}
+
+	// APU Test Registers ($4018 - $401F)
+	return 0xFF;
+}
+
+
+void NSFBus::Write(u16 addr, u8 data)
+{
+	// Internal RAM ($0000 - $1FFF)
+	if (addr <= 0x1FFF)
+	{
+		ram[addr & 0x7FF] = data; // wrap address to between 0-0x7FF
+	}
+
+	// Cartridge Space ($4020 - $FFFF)
+	else if (addr >= 0x4020)
+	{
+		nes->mapper->WritePRG(addr, data);
+	}
+
+	// APU Registers ($4000-$4013, $4015, $4017); there is no OAM to DMA to, and no joypads to strobe.
+	else if (addr >= 0x4000 && addr <= 0x4017 && addr != Bus::Addr::OAMDMA && addr != Bus::Addr::JOY1)
+	{
+		nes->apu->WriteRegister(addr, data);
+	}
+}
+
+
+u8 NSFBus::ReadCycle(u16 addr)
+{
+	Update();
+	return Read(addr);
+}
+
+
+void NSFBus::WriteCycle(u16 addr, u8 data)
+{
+	Update();
+	Write(addr, data);
+}
+
+
+void NSFBus::WaitCycle()
+{
+	Update();
+}
+
+
+void NSFBus::StreamState(SerializationStream& stream)
+{
+	stream.StreamArray(ram);
+	stream.StreamPrimitive(song);
+	stream.StreamPrimitive(play_timer);
+	stream.StreamPrimitive(num_play_periods);
+	stream.StreamPrimitive(play_pending);
+	if (stream.mode == SerializationStream::Mode::Deserialization)
+		UpdateDriver();
+}
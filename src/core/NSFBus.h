@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+
+#include "APU.h"
+#include "Bus.h"
+#include "CPU.h"
+
+#include "mappers/NSF.h"
+
+/* The bus of an NSF player: the CPU, the APU and the tune's banks (see NSF), with no PPU at all, so that playing music
+   (or rendering it to a file) costs a fraction of emulating the whole console.
+
+   The tune is driven like the players on real hardware do it: a small driver is mapped to $3F00 (where the PPU registers
+   would be), and the reset and NMI vectors are made to point into it. On reset, the driver silences the APU and calls INIT
+   with the song number in A and the region in X, and then idles in a loop. In place of the vblank NMI, a timer running at
+   the rate given by the tune's header raises an NMI, whose handler calls PLAY. The NMI is only raised while the CPU is in the
+   idle loop, so that a call of PLAY (or INIT) that runs long is never interrupted, and the next call of PLAY comes after it. */
+class NSFBus final : public Bus, public Component
+{
+public:
+	using Component::Component;
+
+	/* 'nsf' is the mapper, which must be attached to the same NES. */
+	void LoadTune(NSF* nsf);
+
+	/* Takes effect on the next reset. */
+	void SelectSong(unsigned song);
+	unsigned GetSong() const { return song; }
+
+	/* The number of times the play timer has expired, i.e. the number of calls of PLAY that were due (see Emulator::RunFrame). */
+	u64 GetNumPlayPeriods() const { return num_play_periods; }
+
+	void Reset() override;
+
+	/* CPU reads/writes/waits, that also advances the state machine by one cycle */
+	u8   ReadCycle(u16 addr)           override;
+	void WaitCycle()                   override;
+	void WriteCycle(u16 addr, u8 data) override;
+
+	void StreamState(SerializationStream& stream) override;
+
+private:
+	static constexpr unsigned cpu_cycles_per_sec_ntsc = 1789773;
+	static constexpr unsigned cpu_cycles_per_sec_pal = 1662607;
+
+	static constexpr u16 driver_addr = 0x3F00;
+	static constexpr size_t driver_size = 0x27;
+	/* Offsets into the driver, of operands that are filled in for the tune, and of the entry points */
+	static constexpr size_t song_operand_offset = 0x1A;
+	static constexpr size_t region_operand_offset = 0x1C;
+	static constexpr size_t init_operand_offset = 0x1E;
+	static constexpr size_t idle_loop_offset = 0x20;
+	static constexpr size_t nmi_handler_offset = 0x23;
+	static constexpr size_t play_operand_offset = 0x24;
+
+	static constexpr std::array<u8, driver_size> driver_template = {
+		0x78,             // $3F00: SEI
+		0xD8,             // $3F01: CLD
+		0xA2, 0xFF,       // $3F02: LDX #$FF
+		0x9A,             // $3F04: TXS
+		0xA9, 0x00,       // $3F05: LDA #$00
+		0xA2, 0x13,       // $3F07: LDX #$13
+		0x9D, 0x00, 0x40, // $3F09: STA $4000,X    ; clear $4000-$4013
+		0xCA,             // $3F0C: DEX
+		0x10, 0xFA,       // $3F0D: BPL $3F09
+		0xA9, 0x0F,       // $3F0F: LDA #$0F
+		0x8D, 0x15, 0x40, // $3F11: STA $4015      ; enable all channels but the DMC
+		0xA9, 0x40,       // $3F14: LDA #$40
+		0x8D, 0x17, 0x40, // $3F16: STA $4017      ; 4-step sequence, frame IRQ inhibited
+		0xA9, 0x00,       // $3F19: LDA #song
+		0xA2, 0x00,       // $3F1B: LDX #region
+		0x20, 0x00, 0x00, // $3F1D: JSR init
+		0x4C, 0x20, 0x3F, // $3F20: JMP $3F20      ; idle loop
+		0x20, 0x00, 0x00, // $3F23: JSR play       ; NMI handler
+		0x40              // $3F26: RTI
+	};
+
+	std::array<u8, 0x800> ram{}; /* $0000-$07FF, mirrored until $1FFF */
+	std::array<u8, driver_size> driver = driver_template;
+
+	NSF* nsf = nullptr;
+	unsigned song = 0;
+
+	/* The play timer counts in units of a millionth of a CPU cycle, so that a period given in microseconds is a whole number of units. */
+	u64 play_timer = 0;
+	u64 play_period = 0;
+	u64 num_play_periods = 0;
+	bool play_pending = false;
+
+	__forceinline void Update()
+	{
+		nes->apu->Update();
+		/* There is no PPU to poll the interrupt lines 2/3 into each cycle. */
+		nes->cpu->PollInterruptInputs();
+		if ((play_timer += 1'000'000) >= play_period)
+		{
+			play_timer -= play_period;
+			play_pending = true;
+			num_play_periods++;
+		}
+	}
+
+	u8 Read(u16 addr);
+	void Write(u16 addr, u8 data);
+
+	void UpdateDriver();
+};
@@ -97,13 +97,6 @@
 #define RENDERING_IS_ENABLED (PPUMASK_BG_ENABLE || PPUMASK_SPRITE_ENABLE)
 
 
-PPU::~PPU()
-{
-	SDL_DestroyRenderer(renderer);
-	SDL_DestroyWindow(window);
-}
-
-
 void PPU::PowerOn(const System::VideoStandard standard)
 {
 	Reset();
@@ -131,30 +124,14 @@ void PPU::Reset()
 	scanline = 0;
 	pixel_x_pos = 0;
 	framebuffer_pos = 0;
+	compose_current_frame = present_frame_on_pre_render_line = true;
+	frames_until_composition = frame_skip;
 }
 
 
 bool PPU::CreateRenderer(const void* window_handle)
 {
-	this->window = SDL_CreateWindowFrom(window_handle);
-	if (window == nullptr)
-	{
-		const char* error_msg = SDL_GetError();
-		UserMessage::Show(std::format("Could not create the SDL window; {}", error_msg), UserMessage::Type::Error);
-		return false;
-	}
-
-	this->renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
-	if (renderer == nullptr)
-	{
-		const char* error_msg = SDL_GetError();
-		UserMessage::Show(std::format("Could not create the SDL renderer; {}", error_msg), UserMessage::Type::Error);
-		SDL_DestroyWindow(window);
-		window = nullptr;
-		return false;
-	}
-
-	return true;
+	return video_output.CreateRenderer(window_handle);
 }
 
 
@@ -246,14 +223,26 @@ void PPU::StepCycle()
 				{
 					PPUSTATUS &= ~(PPUSTATUS_VBLANK_MASK | PPUSTATUS_SPRITE_0_HIT_MASK | PPUSTATUS_SPRITE_OVERFLOW_MASK);
 					CheckNMI();
-					RenderGraphics();
+					if (!frame_output_suppressed)
+					{
+						if (present_frame_on_pre_render_line)
+							RenderGraphics(framebuffer.data());
+						else
+							video_output.SkipFrame();
+						if (gui != nullptr)
+							gui->frames_since_update++;
+					}
+					frame_count++;
 				}
 			}
 			else
 			{
 				if (rendering_is_enabled)
 					UpdateSpriteEvaluation();
-				ShiftPixel();
+				if (compose_current_frame && !frame_output_suppressed)
+					ShiftPixel();
+				else
+					ShiftPixelWithoutComposition();
 			}
 		}
 		else if (scanline_cycle <= 320) // Cycles 257-320
@@ -326,6 +315,8 @@ void PPU::StepCycle()
 		PPUSTATUS |= PPUSTATUS_VBLANK_MASK;
 		CheckNMI();
 		SetA12(scroll.v & 0x1000); /* At the start of vblank, the bus address is set back to the video ram address. */
+		if (snapshot_channel.IsRequested())
+			TakeSnapshot();
 		scanline_cycle = 2;
 		return;
 	}
@@ -341,6 +332,7 @@ void PPU::StepCycle()
 		{
 			scanline_cycle = 0;
 			cycle_340_was_skipped_on_last_scanline = true;
+			burst_phase = (burst_phase + 4) % 12;
 			PrepareForNewScanline();
 		}
 		else
@@ -743,46 +735,35 @@ u8 PPU::GetNESColorFromColorID(const u8 col_id, const u8 palette_id)
 
 void PPU::PushPixelToFramebuffer(const u8 nes_col)
 {
-	// From the nes colour (0-63), get an RGB24 colour from the predefined palette
-	// The palette from https://wiki.nesdev.org/w/index.php?title=PPU_palettes#2C02 was used for this
-	const SDL_Color& sdl_col = palette[nes_col];
-	framebuffer[framebuffer_pos    ] = sdl_col.r;
-	framebuffer[framebuffer_pos + 1] = sdl_col.g;
-	framebuffer[framebuffer_pos + 2] = sdl_col.b;
-	framebuffer_pos += 3;
+	// The nes colour (0-63) is stored together with the colour emphasis bits; the conversion to RGB is done by the video output.
+	framebuffer[framebuffer_pos++] = nes_col | (PPUMASK & (PPUMASK_EMPHASIZE_RED_MASK | PPUMASK_EMPHASIZE_GREEN_MASK | PPUMASK_EMPHASIZE_BLUE_MASK)) << 1;
 
 	pixel_x_pos++;
 }
 
 
-void PPU::RenderGraphics()
+void PPU::PresentFrame(const std::vector<u16>& pixels)
 {
-	void* pixels = framebuffer.data();
-	int width = num_pixels_per_scanline;
-	int height = standard.num_visible_scanlines;
-	int depth = 8 * num_colour_channels;
-	int pitch = num_pixels_per_scanline * num_colour_channels;
-	unsigned Rmask = 0x0000FF, Gmask = 0x00FF00, Bmask = 0xFF0000, Amask = 0x000000;
-	SDL_Surface* surface = SDL_CreateRGBSurfaceFrom(pixels, width, height, depth, pitch, Rmask, Gmask, Bmask, Amask);
+	if (present_frame_on_pre_render_line)
+		RenderGraphics(pixels.data());
+	else
+		video_output.SkipFrame();
+	if (gui != nullptr)
+		gui->frames_since_update++;
+}
 
-	SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer, surface);
 
+void PPU::RenderGraphics(const u16* pixels)
+{
 	SDL_Rect rect;
 	rect.w = GetWindowWidth();
 	rect.h = GetWindowHeight();
 	rect.x = window_pixel_offset_x;
 	rect.y = window_pixel_offset_y;
-	SDL_RenderCopy(renderer, texture, nullptr, &rect);
-
-	SDL_RenderPresent(renderer);
+	video_output.PresentFrame(pixels, standard.num_visible_scanlines, window_scale, rect, burst_phase);
 
 	if (reset_graphics_after_render)
 		ResetGraphics();
-
-	SDL_FreeSurface(surface);
-	SDL_DestroyTexture(texture);
-
-	gui->frames_since_update++;
 }
 
 
@@ -792,7 +773,7 @@ void PPU::ResetGraphics()
 	window_pixel_offset_x = window_pixel_offset_x_temp;
 	window_pixel_offset_y = window_pixel_offset_y_temp;
 
-	SDL_RenderClear(renderer);
+	video_output.Clear();
 	reset_graphics_after_render = false;
 }
 
@@ -891,6 +872,47 @@ void PPU::ShiftPixel()
 }
 
 
+void PPU::ShiftPixelWithoutComposition()
+{
+	/* Used instead of ShiftPixel() on frames that are not shown (see 'frame_skip').
+	   Nothing is written to the framebuffer, and no colours are looked up. The shift registers and sprite x-position counters
+	   are still updated in the same way, and the sprite 0 hit flag is still set at the same dot.
+	   For the latter, only the bg pixel and the pixel of the sprite in secondary OAM slot 0 need to be checked;
+	   if that sprite is sprite 0 and its pixel is opaque, it always wins the sprite priority check in ShiftPixel(). */
+	if (PPUMASK_SPRITE_ENABLE && PPUMASK_BG_ENABLE && !PPUSTATUS_SPRITE_0_HIT       &&
+		sprite_evaluation.sprite_0_included_current_scanline                       &&
+		sprite_x_pos_counter[0] <= 0 && sprite_x_pos_counter[0] > -8               &&
+		(pixel_x_pos >= 8 || (PPUMASK_BG_LEFT_COL_ENABLE && PPUMASK_SPRITE_LEFT_COL_ENABLE)) &&
+		pixel_x_pos != 255)
+	{
+		const bool bg_pixel_is_opaque = ((bg_pattern_shift_reg[0] | bg_pattern_shift_reg[1]) << scroll.x) & 0x8000;
+
+		u8 offset = -sprite_x_pos_counter[0];
+		if (sprite_attribute_latch[0] & 0x40) // flip sprite horizontally
+			offset = 7 - offset;
+		const bool sprite_pixel_is_opaque = ((sprite_pattern_shift_reg[0] | sprite_pattern_shift_reg[1]) << offset) & 0x80;
+
+		if (bg_pixel_is_opaque && sprite_pixel_is_opaque)
+		{
+			if (scanline_cycle >= 2)
+				PPUSTATUS |= PPUSTATUS_SPRITE_0_HIT_MASK;
+			else
+				set_sprite_0_hit_flag = true;
+		}
+	}
+
+	bg_pattern_shift_reg[0] <<= 1;
+	bg_pattern_shift_reg[1] <<= 1;
+	bg_palette_attr_reg[0] <<= 1;
+	bg_palette_attr_reg[1] <<= 1;
+
+	for (int i = 0; i < 8; i++)
+		sprite_x_pos_counter[i]--;
+
+	pixel_x_pos++;
+}
+
+
 void PPU::ReloadBackgroundShiftRegisters()
 {
 	// Reload the lower 8 bits of the two 16-bit background shifters with pattern data for the next tile.
@@ -1146,6 +1168,20 @@ void PPU::PrepareForNewFrame()
 {
 	odd_frame = !odd_frame;
 	framebuffer_pos = 0;
+	burst_phase = (burst_phase + 4) % 12;
+
+	/* The frame that was just finished is shown on the pre-render scanline, i.e. after this point. */
+	present_frame_on_pre_render_line = compose_current_frame;
+	if (frames_until_composition == 0)
+	{
+		compose_current_frame = true;
+		frames_until_composition = frame_skip;
+	}
+	else
+	{
+		compose_current_frame = false;
+		frames_until_composition--;
+	}
 }
 
 
@@ -1166,6 +1202,13 @@ void PPU::PrepareForNewScanline()
 }
 
 
+void PPU::SetFrameSkip(const unsigned frames)
+{
+	this->frame_skip = frames;
+	frames_until_composition = std::min(frames_until_composition, frames);
+}
+
+
 void PPU::SetWindowScale(const unsigned scale)
 {
 	this->window_scale = scale;
@@ -1184,6 +1227,28 @@ void PPU::SetWindowSize(const unsigned width, const unsigned height)
 }
 
 
+bool PPU::StartVideoCapture(const std::string& path, const VideoCapture::Format format, const VideoCapture::OverflowPolicy overflow_policy)
+{
+	return video_output.StartCapture(path, format, standard.num_visible_scanlines,
+		standard.frame_rate_numerator, standard.frame_rate_denominator, overflow_policy);
+}
+
+
+void PPU::TakeSnapshot()
+{
+	snapshot_channel.Fulfil([&](PPUSnapshot& snapshot) {
+		nes->mapper->CopyPPUMemory(snapshot.pattern_tables, snapshot.nametables);
+		snapshot.oam = oam;
+		snapshot.palette_ram = palette_ram;
+		snapshot.scroll_t = scroll.t;
+		snapshot.fine_x_scroll = scroll.x;
+		snapshot.ppuctrl = PPUCTRL;
+		snapshot.ppumask = PPUMASK;
+		snapshot.frame = frame_count;
+	});
+}
+
+
 void PPU::StreamState(SerializationStream& stream)
 {
 	/* I've tried to follow the order of the declarations in the class definition. */
@@ -1195,9 +1260,11 @@ void PPU::StreamState(SerializationStream& stream)
 	stream.StreamPrimitive(a12);
 	stream.StreamPrimitive(cpu_cycles_since_a12_set_low);
 
+	stream.StreamPrimitive(compose_current_frame);
 	stream.StreamPrimitive(cycle_340_was_skipped_on_last_scanline);
 	stream.StreamPrimitive(NMI_line);
 	stream.StreamPrimitive(odd_frame);
+	stream.StreamPrimitive(present_frame_on_pre_render_line);
 	stream.StreamPrimitive(reset_graphics_after_render);
 	stream.StreamPrimitive(set_sprite_0_hit_flag);
 
@@ -1213,8 +1280,10 @@ void PPU::StreamState(SerializationStream& stream)
 
 	stream.StreamPrimitive(scanline);
 
+	stream.StreamPrimitive(burst_phase);
 	stream.StreamPrimitive(cpu_cycle_counter);
 	stream.StreamPrimitive(framebuffer_pos);
+	stream.StreamPrimitive(frames_until_composition);
 	stream.StreamPrimitive(scanline_cycle);
 	stream.StreamPrimitive(secondary_oam_sprite_index);
 	stream.StreamPrimitive(window_scale);
@@ -1235,19 +1304,23 @@ void PPU::StreamState(SerializationStream& stream)
 
 	stream.StreamArray(sprite_x_pos_counter);
 
-	stream.StreamVector(framebuffer);
+	stream.StreamFixedSizeVector(framebuffer);
 }
 
 
 void PPU::StreamConfig(SerializationStream& stream)
 {
 	stream.StreamPrimitive(window_scale);
+	stream.StreamPrimitive(frame_skip);
+	video_output.StreamConfig(stream);
 }
 
 
 void PPU::SetDefaultConfig()
 {
 	window_scale = default_window_scale;
+	frame_skip = default_frame_skip;
+	video_output.SetDefaultConfig();
 }
 
 
@@ -6,6 +6,7 @@
 #include <format>
 #include <limits>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
 #include "../Observer.h"
@@ -13,7 +14,10 @@
 
 #include "../gui/UserMessage.h"
 
+#include "../video/VideoOutput.h"
+
 #include "../debug/Logging.h"
+#include "../debug/PPUSnapshot.h"
 
 #include "Bus.h"
 #include "Component.h"
@@ -26,14 +30,13 @@ class PPU final : public Component
 {
 public:
 	using Component::Component;
-	~PPU();
 	PPU(const PPU& other) = delete;
 	PPU(PPU&& other) = delete;
 
 	PPU& operator=(const PPU& other) = delete;
 	PPU& operator=(PPU&& other) = delete;
 
-	Observer* gui;
+	Observer* gui = nullptr;
 
 	unsigned GetWindowScale()  const { return window_scale; }
 	unsigned GetWindowHeight() const { return standard.num_visible_scanlines * window_scale; }
@@ -48,9 +51,32 @@ public:
 	u8 ReadRegister(u16 addr);
 	void WriteRegister(u16 addr, u8 data);
 
+	/* The number of frames that have been finished since power on. When it changes, 'GetFrameBuffer' holds the frame that was just finished,
+	   and does so until the next visible scanline starts. */
+	u64 GetFrameCount() const { return frame_count; }
+	const std::vector<u16>& GetFrameBuffer() const { return framebuffer; }
+	unsigned GetFrameSkip() const { return frame_skip; }
+	VideoOutput::Filter GetVideoFilter() const { return video_output.GetFilter(); }
+	void SetFrameSkip(unsigned frames);
+	/* While suppressed, frames are neither composed nor shown (nor recorded, nor counted by the GUI). For frames that are run
+	   only to be undone, or whose result is not shown (run-ahead; see Emulator). Must be changed between frames. */
+	void SuppressFrameOutput(bool suppress) { frame_output_suppressed = suppress; }
+	/* Shows 'pixels', a frame of another instance, in place of the frame that was just finished while frame output was suppressed;
+	   or shows nothing, if that frame would not have been shown either (see 'frame_skip'). */
+	void PresentFrame(const std::vector<u16>& pixels);
+	void SetVideoFilter(VideoOutput::Filter filter) { video_output.SetFilter(filter); }
 	void SetWindowScale(unsigned scale);
 	void SetWindowSize(unsigned width, unsigned height);
 
+	[[nodiscard]] bool StartVideoCapture(const std::string& path, VideoCapture::Format format, VideoCapture::OverflowPolicy overflow_policy);
+	bool StopVideoCapture() { return video_output.StopCapture(); }
+	bool IsCapturingVideo() const { return video_output.IsCapturing(); }
+	u64 GetNumDroppedVideoCaptureFrames() const { return video_output.GetNumDroppedCaptureFrames(); }
+
+	/* Snapshots for the PPU viewer are taken at the start of vblank, when one has been requested through the channel. */
+	PPUSnapshotChannel& GetSnapshotChannel() { return snapshot_channel; }
+	const std::array<u32, 512>& GetRGBPalette() const { return video_output.GetRGBPalette(); }
+
 	void StreamState(SerializationStream& stream) override;
 	void StreamConfig(SerializationStream& stream) override;
 	void SetDefaultConfig() override;
@@ -68,30 +94,19 @@ private:
 		int num_scanlines;
 		int num_scanlines_per_vblank;
 		int num_visible_scanlines;
+		u32 frame_rate_numerator, frame_rate_denominator; /* PPU clock rate / average number of dots per frame */
 	} standard = NTSC;
 
-	static constexpr Standard NTSC  = {  true,  true, 3.0f, 241, 262, 20, 240 };
-	static constexpr Standard PAL   = { false, false, 3.2f, 240, 312, 70, 239 };
-	static constexpr Standard Dendy = {  true, false, 3.0f, 290, 312, 20, 239 };
+	static constexpr Standard NTSC  = {  true,  true, 3.0f, 241, 262, 20, 240, 39375000, 655171 };
+	static constexpr Standard PAL   = { false, false, 3.2f, 240, 312, 70, 239, 10640685, 212784 };
+	static constexpr Standard Dendy = {  true, false, 3.0f, 290, 312, 20, 239, 10640685, 212784 };
 
 	static constexpr int default_window_scale = 3;
-	static constexpr int num_colour_channels = 3;
+	static constexpr unsigned default_frame_skip = 0;
 	static constexpr int num_cycles_per_scanline = 341; // On NTSC: is actually 340 on the pre-render scanline if on an odd-numbered frame
 	static constexpr int num_pixels_per_scanline = 256; // Horizontal resolution
 	static constexpr int pre_render_scanline = -1;
 
-	// https://wiki.nesdev.org/w/index.php?title=PPU_palettes#2C02
-	const std::array<SDL_Color, 64> palette = { {
-		{ 84,  84,  84}, {  0,  30, 116}, {  8,  16, 144}, { 48,   0, 136}, { 68,   0, 100}, { 92,   0,  48}, { 84,   4,   0}, { 60,  24,   0},
-		{ 32,  42,   0}, {  8,  58,   0}, {  0,  64,   0}, {  0,  60,   0}, {  0,  50,  60}, {  0,   0,   0}, {  0,   0,   0}, {  0,   0,   0},
-		{152, 150, 152}, {  8,  76, 196}, { 48,  50, 236}, { 92,  30, 228}, {136,  20, 176}, {160,  20, 100}, {152,  34,  32}, {120,  60,   0},
-		{ 84,  90,   0}, { 40, 114,   0}, {  8, 124,   0}, {  0, 118,  40}, {  0, 102, 120}, {  0,   0,   0}, {  0,   0,   0}, {  0,   0,   0},
-		{236, 238, 236}, { 76, 154, 236}, {120, 124, 236}, {176,  98, 236}, {228,  84, 236}, {236,  88, 180}, {236, 106, 100}, {212, 136,  32},
-		{160, 170,   0}, {116, 196,   0}, { 76, 208,  32}, { 56, 204, 108}, { 56, 180, 204}, { 60,  60,  60}, {  0,   0,   0}, {  0,   0,   0},
-		{236, 238, 236}, {168, 204, 236}, {188, 188, 236}, {212, 178, 236}, {236, 174, 236}, {236, 174, 212}, {236, 180, 176}, {228, 194, 144},
-		{204, 210, 120}, {180, 222, 120}, {168, 226, 144}, {152, 226, 180}, {160, 214, 228}, {160, 162, 160}, {  0,   0,   0}, {  0,   0,   0}
-	} };
-
 	const std::array<u8, 0x20> palette_ram_on_powerup = { /* Source: blargg_ppu_tests_2005.09.15b */
 		0x09, 0x01, 0x00, 0x01, 0x00, 0x02, 0x02, 0x0D, 0x08, 0x10, 0x08, 0x24, 0x00, 0x00, 0x04, 0x2C,
 		0x09, 0x01, 0x34, 0x03, 0x00, 0x04, 0x00, 0x14, 0x08, 0x3A, 0x00, 0x02, 0x00, 0x20, 0x2C, 0x08
@@ -249,9 +264,12 @@ private:
 		}
 	}
 
+	bool compose_current_frame = true; // Whether pixels are composed and pushed to the framebuffer during the current frame (see 'frame_skip').
+	bool frame_output_suppressed = false; // See SuppressFrameOutput(). Not part of save states.
 	bool cycle_340_was_skipped_on_last_scanline = false; // On NTSC, cycle 340 of the pre render scanline may be skipped every other frame.
 	bool NMI_line = 1;
 	bool odd_frame = false;
+	bool present_frame_on_pre_render_line = true; // Whether the frame that was just finished was composed, and should be shown on the pre-render scanline.
 	bool reset_graphics_after_render = false;
 	bool set_sprite_0_hit_flag = false;
 
@@ -267,8 +285,15 @@ private:
 
 	int scanline = 0;
 
+	u64 frame_count = 0;
+
+	/* The phase (0, 4 or 8, out of 12) of the colour subcarrier at the start of the current frame. Every scanline is 341 * 8 samples long,
+	   so each frame moves it by 4, and when the dot at the end of the pre-render scanline is skipped, it moves by another 4. */
+	unsigned burst_phase = 0;
 	unsigned cpu_cycle_counter = 0; /* Used in PAL mode to sync ppu to cpu */
+	unsigned frame_skip; // The number of frames that are neither composed nor shown between two frames that are.
 	unsigned framebuffer_pos = 0;
+	unsigned frames_until_composition = 0;
 	unsigned scanline_cycle;
 	unsigned secondary_oam_sprite_index /* (0-7) index of the sprite currently being fetched (ppu dots 257-320). */;
 	unsigned window_scale;
@@ -289,10 +314,11 @@ private:
 
 	std::array<int, 8> sprite_x_pos_counter{};
 
-	std::vector<u8> framebuffer{};
+	std::vector<u16> framebuffer{}; /* Palette index (bits 0-5) and colour emphasis bits (bits 6-8) of each pixel */
+
+	VideoOutput video_output;
 
-	SDL_Renderer* renderer;
-	SDL_Window* window;
+	PPUSnapshotChannel snapshot_channel;
 
 	/* Note: vblank is counted to begin on the first "post-render" scanline, not on the same scanline as when NMI is triggered. */
 	bool IsInVblank() const { return scanline >= standard.nmi_scanline - 1; }
@@ -304,10 +330,12 @@ private:
 	void PushPixelToFramebuffer(u8 nes_col);
 	void ReloadBackgroundShiftRegisters();
 	void ReloadSpriteShiftRegisters(unsigned sprite_index);
-	void RenderGraphics();
+	void RenderGraphics(const u16* pixels);
 	void ResetGraphics();
 	void ShiftPixel();
+	void ShiftPixelWithoutComposition();
 	void StepCycle();
+	void TakeSnapshot();
 	void UpdateBGTileFetching();
 	void UpdateSpriteEvaluation();
 	void UpdateSpriteTileFetching();
@@ -320,5 +348,5 @@ private:
 	u8 ReadMemory(u16 addr);
 	u8 ReadPaletteRAM(u16 addr);
 
-	size_t GetFrameBufferSize() const { return num_pixels_per_scanline * standard.num_visible_scanlines * num_colour_channels; };
+	size_t GetFrameBufferSize() const { return num_pixels_per_scanline * standard.num_visible_scanlines; };
 };
\ No newline at end of file
@@ -0,0 +1,116 @@
+#include "Rewinder.h"
+
+#include <algorithm>
+
+
+void Rewinder::SetEnabled(const bool enabled)
+{
+	this->enabled = enabled;
+	Clear();
+}
+
+
+void Rewinder::SetDuration(const unsigned seconds)
+{
+	duration = std::max(seconds, 1u);
+	Clear();
+}
+
+
+void Rewinder::SetMemoryBudget(const size_t bytes)
+{
+	memory_budget = bytes;
+	Clear();
+}
+
+
+void Rewinder::Clear()
+{
+	/* The buffers of the entries are kept, to be reused. */
+	ring.resize(enabled ? std::max(size_t(duration) * max_frame_rate / interval, size_t(1)) : 0);
+	for (std::vector<u8>& delta : ring)
+		delta.clear();
+	oldest_delta = num_states = num_bytes = 0;
+	newest_state.clear();
+}
+
+
+void Rewinder::Push(const std::span<const u8> state)
+{
+	if (!enabled || state.empty())
+		return;
+	if (state.size() != newest_state.size())
+	{
+		/* A state of another game (or another kind of machine); what came before is of no use. */
+		Clear();
+	}
+	if (num_states > 0)
+	{
+		if (num_states - 1 == ring.size())
+			DropOldestState();
+		/* The state that was the newest is from now on kept as its XOR with the new one. */
+		std::vector<u8>& delta = GetDelta(num_states - 1);
+		delta.clear();
+		StateCompression::Compress(newest_state, state, delta);
+		num_bytes += delta.size();
+	}
+	newest_state.assign(state.begin(), state.end());
+	num_states++;
+
+	while (num_bytes > memory_budget && num_states > 1)
+		DropOldestState();
+}
+
+
+bool Rewinder::Pop(std::vector<u8>& state)
+{
+	if (num_states == 0)
+		return false;
+
+	state.assign(newest_state.begin(), newest_state.end());
+	if (num_states > 1)
+	{
+		const std::vector<u8>& delta = GetDelta(num_states - 2);
+		if (!StateCompression::Decompress(delta, state, newest_state))
+		{
+			Clear();
+			return true;
+		}
+		num_bytes -= delta.size();
+		num_states--;
+	}
+	return true;
+}
+
+
+void Rewinder::DropOldestState()
+{
+	num_bytes -= GetDelta(0).size();
+	oldest_delta = (oldest_delta + 1) % ring.size();
+	num_states--;
+}
+
+
+void Rewinder::StreamConfig(SerializationStream& stream)
+{
+	stream.StreamPrimitive(enabled);
+	stream.StreamPrimitive(duration);
+	stream.StreamPrimitive(interval);
+	stream.StreamPrimitive(memory_budget);
+	if (stream.mode == SerializationStream::Mode::Deserialization)
+	{
+		duration = std::max(duration, 1u);
+		interval = std::max(interval, 1u);
+		Clear();
+	}
+}
+
+
+void Rewinder::SetDefaultConfig()
+{
+	enabled = default_enabled;
+	duration = default_duration;
+	interval = default_interval;
+	memory_budget = default_memory_budget;
+	Clear();
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include "../Configurable.h"
+#include "../StateCompression.h"
+#include "../Types.h"
+
+/* Keeps the recent history of the machine's state, so that a game can be played backwards (hold-to-rewind; see Emulator).
+   A state is pushed every 'interval' frames. The newest state is kept whole; every older one is XORed with the state after it
+   and compressed (see StateCompression). As states a few frames apart differ little, the XORed ones are mostly zeroes, and
+   compress to a small fraction of a state; and going back one state takes a single decompression.
+   The history is a ring of at most 'duration' seconds and 'memory_budget' bytes; when either would be exceeded, the oldest
+   state is dropped. The ring's buffers are reused, so that once it is full, nothing is allocated. */
+class Rewinder final : public Configurable
+{
+public:
+	Rewinder() { SetDefaultConfig(); }
+
+	bool IsEnabled() const { return enabled; }
+	unsigned GetDuration() const { return duration; }
+	unsigned GetInterval() const { return interval; }
+	size_t GetMemoryBudget() const { return memory_budget; }
+	size_t GetNumBytes() const { return num_bytes; }
+	size_t GetNumStates() const { return num_states; }
+
+	/* Changing a setting clears the history. */
+	void SetEnabled(bool enabled);
+	void SetDuration(unsigned seconds);
+	void SetMemoryBudget(size_t bytes);
+
+	void Clear();
+	void Push(std::span<const u8> state);
+	/* Replaces 'state' by the newest state in the history, and drops that from the history, unless it is the only one left
+	   (so that holding rewind stops at the oldest state). Returns false if the history is empty. */
+	bool Pop(std::vector<u8>& state);
+
+	void StreamConfig(SerializationStream& stream) override;
+	void SetDefaultConfig() override;
+
+private:
+	static constexpr unsigned max_frame_rate = 60; /* For sizing the ring; PAL and Dendy run at 50 fps */
+
+	static constexpr bool default_enabled = false;
+	static constexpr unsigned default_duration = 120; /* Seconds */
+	static constexpr unsigned default_interval = 2; /* Frames */
+	static constexpr size_t default_memory_budget = size_t(128) << 20;
+
+	bool enabled;
+	unsigned duration;
+	unsigned interval;
+	size_t memory_budget;
+
+	/* The states before the newest one, compressed; ring[oldest_delta] is the oldest, XORed with the one after it. */
+	std::vector<std::vector<u8>> ring;
+	size_t oldest_delta = 0;
+	size_t num_states = 0; /* Including the newest one */
+	size_t num_bytes = 0; /* Of compressed data */
+	std::vector<u8> newest_state; /* All states in the history are of its size */
+
+	std::vector<u8>& GetDelta(size_t index) { return ring[(oldest_delta + index) % ring.size()]; }
+	void DropOldestState();
+};
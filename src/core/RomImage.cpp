@@ -0,0 +1,122 @@
+#include "RomImage.h"
+
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <optional>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "Zip.h"
+
+
+RomImage::~RomImage()
+{
+	if (!bytes.empty() || data.empty())
+		return;
+#ifdef _WIN32
+	UnmapViewOfFile(data.data());
+	CloseHandle(mapping_handle);
+#else
+	munmap((void*)data.data(), data.size());
+#endif
+}
+
+
+std::shared_ptr<const RomImage> RomImage::Open(const std::string& path)
+{
+	std::error_code ec;
+	const std::filesystem::path canonical_path = std::filesystem::weakly_canonical(path, ec);
+	if (ec) return nullptr;
+	const std::uintmax_t size = std::filesystem::file_size(canonical_path, ec);
+	if (ec) return nullptr;
+	const std::filesystem::file_time_type modification_time = std::filesystem::last_write_time(canonical_path, ec);
+	if (ec) return nullptr;
+	const std::string key = std::format("{}|{}|{}", canonical_path.string(), size, modification_time.time_since_epoch().count());
+
+	std::scoped_lock lock{ open_images_mutex };
+	if (std::shared_ptr<const RomImage> image = open_images[key].lock())
+		return image;
+
+	std::shared_ptr<RomImage> image{ new RomImage{} };
+	if (size > 0 && !image->Map(canonical_path.string(), size_t(size)))
+	{
+		/* Mapping may not be supported for every file (e.g. on some network drives); then read it instead. */
+		std::ifstream ifs{ canonical_path, std::ifstream::in | std::ifstream::binary };
+		image->bytes.resize(size_t(size));
+		if (!ifs.read((char*)image->bytes.data(), image->bytes.size()))
+			return nullptr;
+		image->data = image->bytes;
+	}
+
+	/* A zip archive is opened as the rom within it (see Zip). The rom is decompressed straight into the buffer of the image
+	   that takes the archive's place, and the archive is unmapped once that is done. */
+	if (Zip::IsZip(image->data))
+	{
+		const std::optional<Zip::Entry> entry = Zip::FindRom(image->data);
+		if (!entry.has_value())
+			return nullptr;
+		std::shared_ptr<RomImage> extracted_image{ new RomImage{} };
+		extracted_image->bytes.resize(entry->uncompressed_size);
+		if (!Zip::Extract(image->data, entry.value(), extracted_image->bytes))
+			return nullptr;
+		extracted_image->data = extracted_image->bytes;
+		image = std::move(extracted_image);
+	}
+
+	/* Forget the images that no instance uses anymore. */
+	std::erase_if(open_images, [](const auto& entry) { return entry.second.expired(); });
+	open_images[key] = image;
+	return image;
+}
+
+
+std::shared_ptr<const RomImage> RomImage::FromBytes(std::vector<u8> bytes)
+{
+	std::shared_ptr<RomImage> image{ new RomImage{} };
+	image->bytes = std::move(bytes);
+	image->data = image->bytes;
+	return image;
+}
+
+
+/* Returns true on success */
+bool RomImage::Map(const std::string& path, const size_t size)
+{
+#ifdef _WIN32
+	const HANDLE file = CreateFileW(std::filesystem::path(path).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	/* The mapping keeps the file open. */
+	mapping_handle = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (mapping_handle == nullptr)
+		return false;
+	const void* view = MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, size);
+	if (view == nullptr)
+	{
+		CloseHandle(mapping_handle);
+		mapping_handle = nullptr;
+		return false;
+	}
+#else
+	const int fd = open(path.c_str(), O_RDONLY);
+	if (fd == -1)
+		return false;
+	/* The mapping keeps the file open. */
+	void* view = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (view == MAP_FAILED)
+		return false;
+#endif
+	data = std::span<const u8>((const u8*)view, size);
+	return true;
+}
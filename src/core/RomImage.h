@@ -0,0 +1,47 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "../Types.h"
+
+/* The contents of a rom file, mapped read-only into memory rather than read into a buffer, so that loading a rom costs
+   next to nothing, and pages of the file are only brought in once they are read. The mappers reference PRG ROM and CHR ROM
+   as spans into the image (see BaseMapper), and keep the image alive for as long as they exist.
+
+   Images are shared: opening a file that another emulator instance has open already (e.g. in a RegressionSuite run, where
+   many instances run the same rom) gives the same image, so that the process holds one copy of every rom, however many
+   instances use it. A file is only considered the same if its size and modification time are unchanged.
+
+   A zip archive is not mapped as it is, but gives an image of the rom within it, decompressed into memory (see Zip). */
+class RomImage
+{
+public:
+	RomImage(const RomImage&) = delete;
+	RomImage& operator=(const RomImage&) = delete;
+	~RomImage();
+
+	/* Returns nullptr if the file could not be opened or mapped. */
+	static std::shared_ptr<const RomImage> Open(const std::string& path);
+	/* An image that is not backed by a file, e.g. one that was assembled from a file rather than mapped from it. */
+	static std::shared_ptr<const RomImage> FromBytes(std::vector<u8> bytes);
+
+	std::span<const u8> GetData() const { return data; }
+
+private:
+	RomImage() = default;
+
+	std::span<const u8> data;
+	std::vector<u8> bytes; /* For images made with FromBytes */
+	void* mapping_handle = nullptr; /* Windows only */
+
+	/* Keyed by the canonical path, size and modification time of the file */
+	static inline std::map<std::string, std::weak_ptr<const RomImage>> open_images;
+	static inline std::mutex open_images_mutex;
+
+	bool Map(const std::string& path, size_t size);
+};
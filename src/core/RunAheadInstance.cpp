@@ -0,0 +1,94 @@
+#include "RunAheadInstance.h"
+
+#include "Emulator.h"
+
+
+RunAheadInstance::~RunAheadInstance()
+{
+	if (!thread.joinable())
+		return;
+	{
+		std::lock_guard lock(mutex);
+		stopping = true;
+	}
+	job_available.notify_one();
+	thread.join();
+}
+
+
+bool RunAheadInstance::Start(const std::string& rom_path)
+{
+	emulator = std::make_unique<Emulator>();
+	if (!emulator->PrepareHeadlessRun(rom_path))
+	{
+		emulator.reset();
+		return false;
+	}
+	thread = std::thread([this] { RunLoop(); });
+	return true;
+}
+
+
+void RunAheadInstance::Submit(const std::span<const u8> state, const u8 (&buttons)[2], const unsigned num_frames)
+{
+	{
+		std::lock_guard lock(mutex);
+		this->state.assign(state.begin(), state.end());
+		this->buttons[0] = buttons[0];
+		this->buttons[1] = buttons[1];
+		this->num_frames = num_frames;
+		job_pending = true;
+	}
+	job_available.notify_one();
+}
+
+
+bool RunAheadInstance::Wait()
+{
+	std::unique_lock lock(mutex);
+	job_done.wait(lock, [&] { return !job_pending; });
+	return !job_failed;
+}
+
+
+const std::vector<u16>& RunAheadInstance::GetFrameBuffer() const
+{
+	return emulator->GetFrameBuffer();
+}
+
+
+void RunAheadInstance::RunLoop()
+{
+	std::unique_lock lock(mutex);
+	while (true)
+	{
+		job_available.wait(lock, [&] { return stopping || job_pending; });
+		if (stopping)
+			return;
+		/* The submitting thread waits for the job to be done before it touches anything again, so it runs with the lock held. */
+		job_failed = !Run();
+		job_pending = false;
+		job_done.notify_one();
+	}
+}
+
+
+/* Returns true on success */
+bool RunAheadInstance::Run()
+{
+	if (!emulator->LoadStateFromMemory(state))
+		return false;
+	emulator->SetButtonStates(buttons[0], Joypad::Player::ONE);
+	emulator->SetButtonStates(buttons[1], Joypad::Player::TWO);
+
+	/* Only the last frame is composed. The state may be of a frame that the first instance skips (see PPU::SetFrameSkip);
+	   with no frame skip here, the frames after it are composed again. */
+	PPU& ppu = *emulator->nes.ppu;
+	ppu.SetFrameSkip(0);
+	ppu.SuppressFrameOutput(true);
+	for (unsigned i = 1; i < num_frames; i++)
+		emulator->RunFrame();
+	ppu.SuppressFrameOutput(false);
+	emulator->RunFrame();
+	return true;
+}
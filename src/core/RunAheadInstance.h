@@ -0,0 +1,56 @@
+#pragma once
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../Types.h"
+
+class Emulator;
+
+/* A second, headless instance of the emulator, on a thread of its own, that runs ahead for the first one (run-ahead; see Emulator).
+   Every frame, the first instance submits its state and input, and then runs its own frame while this one loads the state and
+   runs that same frame and the ones ahead of it. As it makes no sound and shows nothing but its last frame, it usually finishes
+   around the same time, so that running ahead costs the first instance little more than the wait and a copy of the state. */
+class RunAheadInstance
+{
+public:
+	RunAheadInstance() = default;
+	~RunAheadInstance();
+	RunAheadInstance(const RunAheadInstance& other) = delete;
+	RunAheadInstance(RunAheadInstance&& other) = delete;
+
+	RunAheadInstance& operator=(const RunAheadInstance& other) = delete;
+	RunAheadInstance& operator=(RunAheadInstance&& other) = delete;
+
+	/* Loads the game, and starts the thread. Returns true on success. */
+	[[nodiscard]] bool Start(const std::string& rom_path);
+	/* Has the state run for 'num_frames' frames with the given buttons held (one byte per player; see Joypad::SetButtonStates). */
+	void Submit(std::span<const u8> state, const u8 (&buttons)[2], unsigned num_frames);
+	/* Waits for the frames submitted last to have been run. Returns false if the state could not be loaded. */
+	bool Wait();
+	/* The last frame that was run. Valid from Wait() until the next Submit(). */
+	const std::vector<u16>& GetFrameBuffer() const;
+
+private:
+	std::unique_ptr<Emulator> emulator;
+
+	std::vector<u8> state;
+	u8 buttons[2]{};
+	unsigned num_frames = 0;
+	bool job_pending = false;
+	bool job_failed = false;
+	bool stopping = false;
+
+	std::mutex mutex;
+	std::condition_variable job_available;
+	std::condition_variable job_done;
+	std::thread thread;
+
+	void RunLoop();
+	bool Run();
+};
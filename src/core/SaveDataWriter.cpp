@@ -0,0 +1,99 @@
+#include "SaveDataWriter.h"
+
+#include <cstdio>
+#include <filesystem>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+
+SaveDataWriter::~SaveDataWriter()
+{
+	if (!writer_thread.joinable())
+		return;
+	{
+		std::lock_guard lock(mutex);
+		stopping = true;
+	}
+	save_available.notify_one();
+	writer_thread.join();
+}
+
+
+void SaveDataWriter::Submit(const std::string& path, const std::span<const u8> data)
+{
+	{
+		std::lock_guard lock(mutex);
+		if (!pending_save.has_value())
+			pending_save.emplace();
+		pending_save->path = path;
+		pending_save->data.assign(data.begin(), data.end());
+		if (!writer_thread.joinable())
+			writer_thread = std::thread([this] { WriterLoop(); });
+	}
+	save_available.notify_one();
+}
+
+
+void SaveDataWriter::Flush()
+{
+	std::unique_lock lock(mutex);
+	idle.wait(lock, [&] { return !pending_save.has_value() && !writing; });
+}
+
+
+void SaveDataWriter::WriterLoop()
+{
+	/* The save being written is kept apart from the pending one, so that new saves can be submitted meanwhile. */
+	Save save;
+	while (true)
+	{
+		{
+			std::unique_lock lock(mutex);
+			writing = false;
+			idle.notify_all();
+			save_available.wait(lock, [&] { return stopping || pending_save.has_value(); });
+			if (!pending_save.has_value())
+				return;
+			std::swap(save, pending_save.value());
+			pending_save.reset();
+			writing = true;
+		}
+
+		/* Message boxes can only be shown from the GUI thread; the failure is picked up there (see TakeWriteFailure). */
+		if (Write(save))
+			write_failed = false;
+		else if (!write_failed)
+			write_failed = write_failure_to_report = true;
+	}
+}
+
+
+/* Returns true on success */
+bool SaveDataWriter::Write(const Save& save)
+{
+	const std::string temporary_path = save.path + ".tmp";
+	std::FILE* file = std::fopen(temporary_path.c_str(), "wb");
+	if (file == nullptr)
+		return false;
+	bool success = std::fwrite(save.data.data(), 1, save.data.size(), file) == save.data.size()
+		&& std::fflush(file) == 0;
+	/* The data must be on the disk before the rename is; otherwise a crash could leave an empty save file behind. */
+#ifdef _WIN32
+	success = success && _commit(_fileno(file)) == 0;
+#else
+	success = success && fsync(fileno(file)) == 0;
+#endif
+	success = std::fclose(file) == 0 && success;
+	if (!success)
+	{
+		std::remove(temporary_path.c_str());
+		return false;
+	}
+	std::error_code ec;
+	std::filesystem::rename(temporary_path, save.path, ec);
+	return !ec;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../Types.h"
+
+/* Writes save data (battery-backed PRG RAM) to disk on a thread of its own, so that the emulation thread never waits for the disk;
+   it only copies the data it submits. Every save is written to a temporary file, which is flushed to disk and then renamed over the
+   save file, so that the save file is always either the old one or the new one in full, also if the emulator crashes or the
+   power goes out in the middle of a write. Saves that are submitted while an earlier one is still waiting replace it. */
+class SaveDataWriter
+{
+public:
+	SaveDataWriter() = default;
+	~SaveDataWriter();
+	SaveDataWriter(const SaveDataWriter& other) = delete;
+	SaveDataWriter(SaveDataWriter&& other) = delete;
+
+	SaveDataWriter& operator=(const SaveDataWriter& other) = delete;
+	SaveDataWriter& operator=(SaveDataWriter&& other) = delete;
+
+	void Submit(const std::string& path, std::span<const u8> data);
+	/* Returns once every submitted save has been written. */
+	void Flush();
+	/* Returns true if a save has failed to be written since the last call, so that the failure can be reported from the GUI thread.
+	   After a failure, the next is only reported once a save has been written successfully again. */
+	bool TakeWriteFailure() { return write_failure_to_report.exchange(false); }
+
+private:
+	struct Save
+	{
+		std::string path;
+		std::vector<u8> data;
+	};
+
+	std::optional<Save> pending_save;
+	bool writing = false;
+	bool stopping = false;
+	bool write_failed = false; /* Only accessed by the writer thread. Failures are reported once, rather than on every save. */
+	std::atomic<bool> write_failure_to_report = false;
+
+	std::mutex mutex;
+	std::condition_variable save_available;
+	std::condition_variable idle;
+	std::thread writer_thread;
+
+	void WriterLoop();
+	static bool Write(const Save& save);
+};
@@ -0,0 +1,411 @@
+#include "Zip.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstring>
+
+
+namespace
+{
+	/* A canonical Huffman code (RFC 1951, 3.2.2). Codes of up to 'fast_bits' bits are decoded with a single table lookup;
+	   longer ones, which are rare, one bit at a time from the number of codes of every length (as zlib's puff does). */
+	struct Huffman
+	{
+		static constexpr unsigned fast_bits = 10;
+		static constexpr unsigned max_bits = 15;
+
+		std::array<u16, max_bits + 1> counts{};
+		std::array<u16, 288> symbols{};
+		std::array<u16, 1 << fast_bits> fast{}; /* symbol << 4 | code length; 0 if the code is longer than 'fast_bits' */
+
+		/* Returns false if the lengths do not make up a valid code. */
+		bool Build(const u8* lengths, const unsigned num_symbols)
+		{
+			counts.fill(0);
+			fast.fill(0);
+			for (unsigned symbol = 0; symbol < num_symbols; symbol++)
+				counts[lengths[symbol]]++;
+			counts[0] = 0;
+
+			int left = 1;
+			for (unsigned len = 1; len <= max_bits; len++)
+			{
+				left = 2 * left - counts[len];
+				if (left < 0)
+					return false;
+			}
+
+			std::array<u16, max_bits + 1> offsets{};
+			std::array<u32, max_bits + 1> next_code{};
+			u32 code = 0;
+			for (unsigned len = 1; len <= max_bits; len++)
+			{
+				code = (code + counts[len - 1]) << 1;
+				next_code[len] = code;
+				if (len < max_bits)
+					offsets[len + 1] = offsets[len] + counts[len];
+			}
+
+			for (unsigned symbol = 0; symbol < num_symbols; symbol++)
+			{
+				const unsigned len = lengths[symbol];
+				if (len == 0)
+					continue;
+				symbols[offsets[len]++] = u16(symbol);
+				const u32 symbol_code = next_code[len]++;
+				if (len > fast_bits)
+					continue;
+				/* The code is read from the stream starting with its most significant bit; the table is indexed by the bits in stream order. */
+				u32 reversed_code = 0;
+				for (unsigned i = 0; i < len; i++)
+					reversed_code |= (symbol_code >> i & 1) << (len - 1 - i);
+				for (u32 index = reversed_code; index < fast.size(); index += 1 << len)
+					fast[index] = u16(symbol << 4 | len);
+			}
+			return true;
+		}
+	};
+
+
+	class Inflater
+	{
+	public:
+		Inflater(std::span<const u8> in, std::span<u8> out) : in(in), out(out) {}
+
+		/* Returns true if the stream was valid and filled 'out' exactly. */
+		bool Run()
+		{
+			bool final_block = false;
+			while (!final_block)
+			{
+				final_block = Bits(1);
+				bool success = false;
+				switch (Bits(2))
+				{
+				case 0: success = StoredBlock(); break;
+				case 1: success = FixedBlock(); break;
+				case 2: success = DynamicBlock(); break;
+				default: break;
+				}
+				if (!success || in_pos - bit_count / 8 > in.size())
+					return false;
+			}
+			return out_pos == out.size();
+		}
+
+	private:
+		static constexpr std::array<u16, 29> length_base = {
+			3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+		static constexpr std::array<u8, 29> length_extra_bits = {
+			0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+		static constexpr std::array<u16, 30> distance_base = {
+			1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097,
+			6145, 8193, 12289, 16385, 24577 };
+		static constexpr std::array<u8, 30> distance_extra_bits = {
+			0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+		static constexpr std::array<u8, 19> code_length_order = {
+			16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+		const std::span<const u8> in;
+		const std::span<u8> out;
+		size_t in_pos = 0; /* Past the bytes in 'bit_buffer'; may go past the end of 'in', which reads as zeroes */
+		size_t out_pos = 0;
+		u64 bit_buffer = 0;
+		unsigned bit_count = 0;
+
+		Huffman literal_length_code, distance_code;
+
+		void Refill()
+		{
+			while (bit_count <= 56)
+			{
+				const u64 byte = in_pos < in.size() ? in[in_pos] : 0;
+				in_pos++;
+				bit_buffer |= byte << bit_count;
+				bit_count += 8;
+			}
+		}
+
+		unsigned Bits(const unsigned num_bits)
+		{
+			if (bit_count < num_bits)
+				Refill();
+			const unsigned bits = unsigned(bit_buffer & ((u64(1) << num_bits) - 1));
+			bit_buffer >>= num_bits;
+			bit_count -= num_bits;
+			return bits;
+		}
+
+		/* Returns -1 if the bits are not a code. */
+		int Decode(const Huffman& code)
+		{
+			Refill();
+			const u16 entry = code.fast[bit_buffer & (code.fast.size() - 1)];
+			if (entry != 0)
+			{
+				bit_buffer >>= entry & 0xF;
+				bit_count -= entry & 0xF;
+				return entry >> 4;
+			}
+			int bits = 0, first = 0, index = 0;
+			for (unsigned len = 1; len <= Huffman::max_bits; len++)
+			{
+				bits |= Bits(1);
+				const int count = code.counts[len];
+				if (bits - count < first)
+					return code.symbols[index + (bits - first)];
+				index += count;
+				first = (first + count) << 1;
+				bits <<= 1;
+			}
+			return -1;
+		}
+
+		bool StoredBlock()
+		{
+			/* Stored blocks start at a byte boundary; give back the whole bytes that were buffered, and copy from the input. */
+			Bits(bit_count % 8);
+			in_pos -= bit_count / 8;
+			bit_buffer = 0;
+			bit_count = 0;
+			if (in_pos + 4 > in.size())
+				return false;
+			const size_t len = in[in_pos] | in[in_pos + 1] << 8;
+			const size_t nlen = in[in_pos + 2] | in[in_pos + 3] << 8;
+			in_pos += 4;
+			if (len != (~nlen & 0xFFFF) || in_pos + len > in.size() || out_pos + len > out.size())
+				return false;
+			std::memcpy(out.data() + out_pos, in.data() + in_pos, len);
+			in_pos += len;
+			out_pos += len;
+			return true;
+		}
+
+		bool FixedBlock()
+		{
+			std::array<u8, 288 + 30> lengths{};
+			std::fill(lengths.begin(), lengths.begin() + 144, 8);
+			std::fill(lengths.begin() + 144, lengths.begin() + 256, 9);
+			std::fill(lengths.begin() + 256, lengths.begin() + 280, 7);
+			std::fill(lengths.begin() + 280, lengths.begin() + 288, 8);
+			std::fill(lengths.begin() + 288, lengths.end(), 5);
+			literal_length_code.Build(lengths.data(), 288);
+			distance_code.Build(lengths.data() + 288, 30);
+			return Codes();
+		}
+
+		bool DynamicBlock()
+		{
+			const unsigned num_literal_length_codes = Bits(5) + 257;
+			const unsigned num_distance_codes = Bits(5) + 1;
+			const unsigned num_code_length_codes = Bits(4) + 4;
+			if (num_literal_length_codes > 286 || num_distance_codes > 30)
+				return false;
+
+			std::array<u8, 19> code_length_lengths{};
+			for (unsigned i = 0; i < num_code_length_codes; i++)
+				code_length_lengths[code_length_order[i]] = u8(Bits(3));
+			Huffman code_length_code;
+			if (!code_length_code.Build(code_length_lengths.data(), 19))
+				return false;
+
+			std::array<u8, 286 + 30> lengths{};
+			const unsigned num_lengths = num_literal_length_codes + num_distance_codes;
+			for (unsigned i = 0; i < num_lengths; )
+			{
+				const int symbol = Decode(code_length_code);
+				if (symbol < 0)
+					return false;
+				if (symbol < 16)
+				{
+					lengths[i++] = u8(symbol);
+					continue;
+				}
+				u8 len = 0;
+				unsigned repeat = 0;
+				if (symbol == 16)
+				{
+					if (i == 0)
+						return false;
+					len = lengths[i - 1];
+					repeat = 3 + Bits(2);
+				}
+				else if (symbol == 17)
+					repeat = 3 + Bits(3);
+				else
+					repeat = 11 + Bits(7);
+				if (i + repeat > num_lengths)
+					return false;
+				std::fill_n(lengths.begin() + i, repeat, len);
+				i += repeat;
+			}
+			if (lengths[256] == 0) /* There must be an end-of-block code */
+				return false;
+
+			return literal_length_code.Build(lengths.data(), num_literal_length_codes)
+				&& distance_code.Build(lengths.data() + num_literal_length_codes, num_distance_codes)
+				&& Codes();
+		}
+
+		/* Decodes the literals and matches of a block, up to and including its end-of-block code. */
+		bool Codes()
+		{
+			while (true)
+			{
+				const int symbol = Decode(literal_length_code);
+				if (symbol < 256)
+				{
+					if (symbol < 0 || out_pos == out.size())
+						return false;
+					out[out_pos++] = u8(symbol);
+					continue;
+				}
+				if (symbol == 256)
+					return true;
+				if (symbol > 285)
+					return false;
+				const size_t len = length_base[symbol - 257] + Bits(length_extra_bits[symbol - 257]);
+				const int distance_symbol = Decode(distance_code);
+				if (distance_symbol < 0 || distance_symbol >= 30)
+					return false;
+				const size_t distance = distance_base[distance_symbol] + Bits(distance_extra_bits[distance_symbol]);
+				if (distance > out_pos || out_pos + len > out.size())
+					return false;
+				/* The source and destination may overlap, which repeats the last 'distance' bytes. */
+				const u8* src = out.data() + out_pos - distance;
+				u8* dst = out.data() + out_pos;
+				for (size_t i = 0; i < len; i++)
+					dst[i] = src[i];
+				out_pos += len;
+			}
+		}
+	};
+
+
+	constexpr std::array<u32, 256> crc32_table = [] {
+		std::array<u32, 256> table{};
+		for (u32 i = 0; i < 256; i++)
+		{
+			u32 crc = i;
+			for (int bit = 0; bit < 8; bit++)
+				crc = crc & 1 ? crc >> 1 ^ 0xEDB88320 : crc >> 1;
+			table[i] = crc;
+		}
+		return table;
+	}();
+}
+
+
+bool Zip::IsZip(const std::span<const u8> archive)
+{
+	return archive.size() >= local_header_size && Read32(archive, 0) == local_header_signature;
+}
+
+
+std::optional<Zip::Entry> Zip::FindRom(const std::span<const u8> archive)
+{
+	/* The end of central directory record is at the end of the archive, followed only by a comment of at most 64 KiB. */
+	if (archive.size() < end_of_central_directory_size)
+		return std::nullopt;
+	size_t end_offset = archive.size() - end_of_central_directory_size;
+	const size_t min_end_offset = end_offset > 0xFFFF ? end_offset - 0xFFFF : 0;
+	while (Read32(archive, end_offset) != end_of_central_directory_signature)
+	{
+		if (end_offset == min_end_offset)
+			return std::nullopt;
+		end_offset--;
+	}
+	const size_t num_entries = Read16(archive, end_offset + 10);
+	size_t offset = Read32(archive, end_offset + 16);
+
+	std::optional<Entry> rom;
+	for (size_t i = 0; i < num_entries; i++)
+	{
+		if (offset + central_header_size > archive.size() || Read32(archive, offset) != central_header_signature)
+			return std::nullopt;
+		const u16 flags = Read16(archive, offset + 8);
+		Entry entry;
+		entry.method = Read16(archive, offset + 10);
+		entry.crc = Read32(archive, offset + 16);
+		entry.compressed_size = Read32(archive, offset + 20);
+		entry.uncompressed_size = Read32(archive, offset + 24);
+		const size_t name_length = Read16(archive, offset + 28);
+		const size_t extra_length = Read16(archive, offset + 30);
+		const size_t comment_length = Read16(archive, offset + 32);
+		const size_t local_header_offset = Read32(archive, offset + 42);
+		if (offset + central_header_size + name_length > archive.size())
+			return std::nullopt;
+		entry.name.assign((const char*)archive.data() + offset + central_header_size, name_length);
+		offset += central_header_size + name_length + extra_length + comment_length;
+
+		const bool encrypted = flags & 1;
+		const bool directory = !entry.name.empty() && entry.name.back() == '/';
+		if (encrypted || directory || (entry.method != method_stored && entry.method != method_deflated))
+			continue;
+
+		if (local_header_offset + local_header_size > archive.size() || Read32(archive, local_header_offset) != local_header_signature)
+			continue;
+		entry.data_offset = local_header_offset + local_header_size
+			+ Read16(archive, local_header_offset + 26) + Read16(archive, local_header_offset + 28);
+		if (entry.data_offset + entry.compressed_size > archive.size())
+			continue;
+		if (entry.uncompressed_size > max_rom_size)
+			return std::nullopt;
+		if (entry.method == method_stored ? entry.uncompressed_size != entry.compressed_size
+			: entry.uncompressed_size > entry.compressed_size * max_deflate_ratio)
+			return std::nullopt;
+
+		std::string extension = entry.name.substr(std::min(entry.name.size(), entry.name.find_last_of('.')));
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+		if (extension == ".nes" || extension == ".nsf")
+			return entry;
+		if (!rom.has_value())
+			rom = std::move(entry);
+	}
+	return rom;
+}
+
+
+bool Zip::Extract(const std::span<const u8> archive, const Entry& entry, const std::span<u8> out)
+{
+	if (out.size() != entry.uncompressed_size)
+		return false;
+	const std::span<const u8> data = archive.subspan(entry.data_offset, entry.compressed_size);
+	if (entry.method == method_stored)
+	{
+		if (data.size() != out.size())
+			return false;
+		std::copy(data.begin(), data.end(), out.begin());
+	}
+	else if (!Inflate(data, out))
+		return false;
+	return CRC32(out) == entry.crc;
+}
+
+
+bool Zip::Inflate(const std::span<const u8> in, const std::span<u8> out)
+{
+	return Inflater{ in, out }.Run();
+}
+
+
+u32 Zip::CRC32(const std::span<const u8> data)
+{
+	u32 crc = 0xFFFFFFFF;
+	for (const u8 byte : data)
+		crc = crc32_table[(crc ^ byte) & 0xFF] ^ crc >> 8;
+	return ~crc;
+}
+
+
+u16 Zip::Read16(const std::span<const u8> data, const size_t offset)
+{
+	return data[offset] | data[offset + 1] << 8;
+}
+
+
+u32 Zip::Read32(const std::span<const u8> data, const size_t offset)
+{
+	return data[offset] | data[offset + 1] << 8 | data[offset + 2] << 16 | u32(data[offset + 3]) << 24;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <optional>
+#include <span>
+#include <string>
+
+#include "../Types.h"
+
+/* Reading of roms from zip archives (https://pkware.cachefly.net/webdocs/casestudies/APPNOTE.TXT), for roms that are
+   stored (method 0) or deflated (method 8). Inflating is done here rather than by a library; see Zip.cpp.
+   Decompression goes straight into a buffer given by the caller, which is sized from the archive's central directory, so
+   that a rom is decompressed in one pass and never held twice (see RomImage::Open). ZIP64 and encrypted archives are not supported. */
+class Zip final
+{
+public:
+	struct Entry
+	{
+		std::string name;
+		u16 method{};
+		u32 crc{};
+		size_t compressed_size{};
+		size_t uncompressed_size{};
+		size_t data_offset{}; /* From the start of the archive */
+	};
+
+	static bool IsZip(std::span<const u8> archive);
+
+	/* Finds the rom in the archive: the first file with a .nes or .nsf extension, or else the first file.
+	   Fails if a file is larger than any rom, or if its sizes cannot be right. */
+	static std::optional<Entry> FindRom(std::span<const u8> archive);
+
+	/* Decompresses 'entry' into 'out', which must be of the entry's uncompressed size, and checks its CRC.
+	   Returns true on success. */
+	static bool Extract(std::span<const u8> archive, const Entry& entry, std::span<u8> out);
+
+private:
+	static constexpr u32 local_header_signature = 0x04034B50;
+	static constexpr u32 central_header_signature = 0x02014B50;
+	static constexpr u32 end_of_central_directory_signature = 0x06054B50;
+	static constexpr size_t local_header_size = 30;
+	static constexpr size_t central_header_size = 46;
+	static constexpr size_t end_of_central_directory_size = 22;
+
+	static constexpr u16 method_stored = 0;
+	static constexpr u16 method_deflated = 8;
+
+	/* The sizes in the central directory are checked against these before a buffer is allocated for an entry, so that a corrupt
+	   or hostile archive cannot have gigabytes allocated. The largest NES roms (multicarts) are a few tens of MiB,
+	   and deflate cannot compress by more than about 1032:1. */
+	static constexpr size_t max_rom_size = 64 * 1024 * 1024;
+	static constexpr size_t max_deflate_ratio = 1032;
+
+	static bool Inflate(std::span<const u8> in, std::span<u8> out);
+	static u32 CRC32(std::span<const u8> data);
+	static u16 Read16(std::span<const u8> data, size_t offset);
+	static u32 Read32(std::span<const u8> data, size_t offset);
+};
@@ -5,8 +5,8 @@
 class AxROM : public BaseMapper
 {
 public:
-	AxROM(const std::vector<u8> chr_prg_rom, MapperProperties properties) :
-		BaseMapper(chr_prg_rom, MutateProperties(properties)) {}
+	AxROM(std::shared_ptr<const RomImage> rom_image, std::span<const u8> chr_prg_rom, MapperProperties properties) :
+		BaseMapper(std::move(rom_image), chr_prg_rom, MutateProperties(properties)) {}
 
 	u8 ReadPRG(u16 addr) override
 	{
@@ -24,20 +24,10 @@ public:
 		{
 			prg_bank = (data & 0x07) % properties.num_prg_rom_banks; /* Select 32 KiB PRG ROM bank */
 			vram_page = data & 0x10;
+			UpdateNametablePages();
 		}
 	};
 
-	u8 ReadCHR(u16 addr) override
-	{
-		// PPU $0000-$1FFF: 8 KiB RAM (not bank switched)
-		return chr[addr];
-	};
-
-	void WriteCHR(u16 addr, u8 data) override
-	{
-		chr[addr] = data;
-	};
-
 	const std::array<int, 4>& GetNametableMap() const override
 	{
 		if (vram_page == 0)
@@ -1,12 +1,18 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
 #include <format>
+#include <fstream>
+#include <memory>
+#include <span>
 #include <vector>
 
 #include "MapperProperties.h"
 
 #include "../Component.h"
+#include "../RomImage.h"
+#include "../SaveDataWriter.h"
 #include "../System.h"
 
 #include "../../Types.h"
@@ -18,7 +24,10 @@ class BaseMapper : public Component
 public:
 	using Component::Component;
 
-	BaseMapper(const std::vector<u8> chr_prg_rom, MapperProperties properties) : properties(properties)
+	/* 'chr_prg_rom' is the part of 'rom_image' after the header (and trainer). It is not copied; the mapper references it
+	   directly, and keeps the image alive. */
+	BaseMapper(std::shared_ptr<const RomImage> rom_image, std::span<const u8> chr_prg_rom, MapperProperties properties) :
+		properties(properties), rom_image(std::move(rom_image))
 	{
 		/* These must be calculated here, and cannot be part of the properties passed to the submapper constructor,
 		   as bank sizes are not known before the submapper constructors have been called. */
@@ -26,28 +35,42 @@ public:
 		this->properties.num_prg_ram_banks = properties.prg_ram_size / properties.prg_ram_bank_size;
 		this->properties.num_prg_rom_banks = properties.prg_rom_size / properties.prg_rom_bank_size;
 
-		/* Resize all vectors */
-		chr.resize(properties.chr_size);
-		prg_ram.resize(properties.prg_ram_size);
-		prg_rom.resize(properties.prg_rom_size);
-
-		/* Fill vectors with either rom data or $00 */
-		std::copy(chr_prg_rom.begin(), chr_prg_rom.begin() + properties.prg_rom_size, prg_rom.begin());
-
-		if (!properties.has_chr_ram)
-			std::copy(chr_prg_rom.begin() + properties.prg_rom_size, chr_prg_rom.end(), chr.begin());
+		/* The image must hold as much PRG and CHR ROM as the header says (see Cartridge). RAM is filled with $00. */
+		prg_rom = chr_prg_rom.first(properties.prg_rom_size);
+		if (properties.has_chr_ram)
+			chr_ram.resize(properties.chr_size, 0x00);
 		else
-			std::fill(chr.begin(), chr.end(), 0x00);
+			chr_rom = chr_prg_rom.subspan(properties.prg_rom_size, properties.chr_size);
 
-		if (!prg_ram.empty())
-			std::fill(prg_ram.begin(), prg_ram.end(), 0x00);
+		prg_ram.resize(properties.prg_ram_size, 0x00);
 
 		for (auto& nametable_arr : nametable_ram)
 			nametable_arr.fill(0x00);
+
+		/* Every pattern table page must point somewhere, also on carts with less than 8 KiB of CHR.
+		   CHR ROM that small is copied, and the copy repeated over 8 KiB. */
+		if (properties.has_chr_ram && chr_ram.size() < pattern_table_size)
+		{
+			chr_ram.resize(pattern_table_size, 0x00);
+		}
+		else if (!properties.has_chr_ram && chr_rom.size() < pattern_table_size)
+		{
+			chr_ram.resize(pattern_table_size);
+			for (size_t i = 0; i < pattern_table_size; i++)
+				chr_ram[i] = chr_rom.empty() ? 0x00 : chr_rom[i % chr_rom.size()];
+			chr_rom = {};
+		}
+
+		/* Until the derived mapper has had its say (see UpdatePageTables), map CHR and the nametables as a mapper without banking would. */
+		MapCHRPages(0, num_pattern_table_pages, 0);
+		BaseMapper::UpdateNametablePages();
 	}
 
 	const System::VideoStandard GetVideoStandard() const { return properties.video_standard; };
 
+	/* The whole rom file, as it was loaded (for NSF tunes, their PRG image) */
+	std::span<const u8> GetRomData() const { return rom_image ? rom_image->GetData() : std::span<const u8>{}; }
+
 	void ReadPRGRAMFromDisk()
 	{
 		if (properties.has_persistent_prg_ram)
@@ -66,42 +89,58 @@ public:
 		}
 	}
 
-	void WritePRGRAMToDisk() const
+	/* Hands PRG RAM to 'writer' to be saved, if it is battery-backed and has changed since it was last saved. */
+	void WritePRGRAMToDisk(SaveDataWriter& writer)
 	{
-		if (properties.has_persistent_prg_ram)
+		if (properties.has_persistent_prg_ram && prg_ram_dirty)
 		{
-			static bool save_data_creation_has_failed = false;
-			if (!save_data_creation_has_failed) /* Avoid the spamming of user messages, since this function is called regularly. */
-			{
-				const std::string save_data_path = properties.rom_path + save_file_postfix;
-				std::ofstream ofs{ save_data_path, std::ofstream::out | std::ofstream::binary };
-				if (!ofs)
-				{
-					save_data_creation_has_failed = true;
-					UserMessage::Show("Save file creation failed!");
-					return;
-				}
-				ofs.write((const char*)prg_ram.data(), prg_ram.size());
-			}
+			writer.Submit(properties.rom_path + save_file_postfix, prg_ram);
+			prg_ram_dirty = false;
 		}
 	}
 
 	virtual u8 ReadPRG(u16 addr) = 0;
-	virtual u8 ReadCHR(u16 addr) = 0;
 
 	virtual void WritePRG(u16 addr, u8 data) {};
-	virtual void WriteCHR(u16 addr, u8 data) {};
 
-	u8 ReadNametableRAM(u16 addr)
+	/* The PPU reads and writes CHR and nametables through the page tables, without going through the derived mapper. */
+	u8 ReadCHR(u16 addr) const
+	{
+		return chr_pages[addr >> 10][addr & 0x3FF];
+	}
+
+	void WriteCHR(u16 addr, u8 data)
 	{
-		const int page = GetNametablePage(addr);
-		return nametable_ram[page][addr & 0x3FF];
+		/* Pages of CHR ROM have no writable page; 'chr_pages' may point into the rom image, which is mapped read-only. */
+		if (u8* page = chr_ram_pages[addr >> 10])
+			page[addr & 0x3FF] = data;
+	}
+
+	u8 ReadNametableRAM(u16 addr) const
+	{
+		return nametable_pages[addr >> 10 & 3][addr & 0x3FF];
 	}
 
 	void WriteNametableRAM(u16 addr, u8 data)
 	{
-		const int page = GetNametablePage(addr);
-		nametable_ram[page][addr & 0x3FF] = data;
+		nametable_pages[addr >> 10 & 3][addr & 0x3FF] = data;
+	}
+
+	/* Copies PPU $0000-$1FFF and $2000-$2FFF as they are currently mapped, a page at a time (used by the PPU viewer). */
+	void CopyPPUMemory(std::array<u8, 0x2000>& pattern_tables, std::array<u8, 0x1000>& nametables) const
+	{
+		for (unsigned page = 0; page < num_pattern_table_pages; page++)
+			std::copy(chr_pages[page], chr_pages[page] + page_size, pattern_tables.begin() + page * page_size);
+		for (unsigned page = 0; page < 4; page++)
+			std::copy(nametable_pages[page], nametable_pages[page] + page_size, nametables.begin() + page * page_size);
+	}
+
+	/* Recomputes both page tables from the current register values. Must be called after the mapper has been constructed,
+	   and after its state has been loaded. */
+	void UpdatePageTables()
+	{
+		UpdateCHRPages();
+		UpdateNametablePages();
 	}
 
 	virtual void ClockIRQ() {};
@@ -110,9 +149,23 @@ public:
 	void StreamState(SerializationStream& stream) override
 	{
 		stream.StreamArray(nametable_ram);
-		stream.StreamVector(prg_ram);
+		if (stream.mode == SerializationStream::Mode::Serialization)
+		{
+			stream.StreamFixedSizeVector(prg_ram);
+		}
+		else
+		{
+			/* PRG RAM only needs saving again if the state changes it; run-ahead loads a state every frame (see Emulator). */
+			loaded_prg_ram.resize(prg_ram.size());
+			stream.StreamFixedSizeVector(loaded_prg_ram);
+			if (!stream.HasError() && loaded_prg_ram != prg_ram)
+			{
+				prg_ram.swap(loaded_prg_ram);
+				prg_ram_dirty = true;
+			}
+		}
 		if (properties.has_chr_ram)
-			stream.StreamVector(chr);
+			stream.StreamFixedSizeVector(chr_ram);
 	}
 
 protected:
@@ -121,16 +174,32 @@ protected:
 	static constexpr std::array<int, 4> nametable_map_vertical            = { 0, 1, 0, 1 };
 	static constexpr std::array<int, 4> nametable_map_singlescreen_bottom = { 0, 0, 0, 0 };
 	static constexpr std::array<int, 4> nametable_map_singlescreen_top    = { 1, 1, 1, 1 };
-	static constexpr std::array<int, 4> nametable_map_fourscreen          = { 1, 2, 3, 4 };
+	static constexpr std::array<int, 4> nametable_map_fourscreen          = { 0, 1, 2, 3 };
 	static constexpr std::array<int, 4> nametable_map_diagonal            = { 1, 2, 2, 1 };
 
 	const std::string save_file_postfix = "_SAVE_DATA.bin";
 
 	MapperProperties properties;
 
-	std::vector<u8> chr; /* Either RAM or ROM (a cart cannot have both). */
+	std::shared_ptr<const RomImage> rom_image;
+
+	/* CHR is either RAM or ROM (a cart cannot have both); it is read from 'chr_ram' if that is not empty (see GetCHR). */
+	std::span<const u8> chr_rom;
+	std::vector<u8> chr_ram;
+	std::span<const u8> prg_rom;
 	std::vector<u8> prg_ram;
-	std::vector<u8> prg_rom;
+	std::vector<u8> loaded_prg_ram; /* Reused for loading states */
+	bool prg_ram_dirty = false; /* PRG RAM has changed since it was last saved (see WritePRGRAMToDisk) */
+
+	/* Mappers write PRG RAM through this, so that only changes are saved. */
+	void WritePRGRAM(size_t addr, u8 data)
+	{
+		if (prg_ram[addr] != data)
+		{
+			prg_ram[addr] = data;
+			prg_ram_dirty = true;
+		}
+	}
 
 	virtual const std::array<int, 4>& GetNametableMap() const
 	{
@@ -139,6 +208,39 @@ protected:
 		return nametable_map_vertical;
 	}
 
+	/* Mappers with CHR banking override this, and call it whenever a CHR bank register (or banking mode) is written to.
+	   Mappers with switchable mirroring call 'UpdateNametablePages' whenever the mirroring changes. */
+	virtual void UpdateCHRPages()
+	{
+		MapCHRPages(0, num_pattern_table_pages, 0);
+	}
+
+	void UpdateNametablePages()
+	{
+		const std::array<int, 4>& map = GetNametableMap();
+		for (int quadrant = 0; quadrant < 4; quadrant++)
+			nametable_pages[quadrant] = nametable_ram[map[quadrant]].data();
+	}
+
+	/* Maps the 1 KiB pattern table pages [first_page, first_page + num_pages) (PPU $0000-$1FFF is pages 0-7)
+	   to consecutive 1 KiB pages of CHR, starting at 'first_chr_page'. Pages past the end of CHR wrap around, like the address lines would. */
+	void MapCHRPages(unsigned first_page, unsigned num_pages, size_t first_chr_page)
+	{
+		const std::span<const u8> chr = GetCHR();
+		const size_t num_chr_pages = chr.size() / page_size;
+		for (unsigned i = 0; i < num_pages; i++)
+		{
+			const size_t offset = (first_chr_page + i) % num_chr_pages * page_size;
+			chr_pages[first_page + i] = &chr[offset];
+			chr_ram_pages[first_page + i] = properties.has_chr_ram ? &chr_ram[offset] : nullptr;
+		}
+	}
+
+	std::span<const u8> GetCHR() const
+	{
+		return chr_ram.empty() ? chr_rom : std::span<const u8>(chr_ram);
+	}
+
 	/* The following static functions may be called from submapper constructors.
 	   The submapper classes must apply these properties themselves; they cannot be deduced from the rom header. */
 	static void SetCHRBankSize(MapperProperties& properties, size_t size)
@@ -177,14 +279,14 @@ protected:
 	}
 
 private:
-	std::array<std::array<u8, 0x400>, 4> nametable_ram{};
+	static constexpr size_t page_size = 0x400;
+	static constexpr size_t pattern_table_size = 0x2000;
+	static constexpr unsigned num_pattern_table_pages = pattern_table_size / page_size;
 
-	int GetNametablePage(u16 addr) const
-	{
-		const std::array<int, 4>& map = GetNametableMap();
-		const int quadrant = (addr & 0xF00) >> 10; /* $2000-$23FF ==> 0; $2400-$27FF ==> 1; $2800-$2BFF ==> 2; $2C00-$2FFF ==> 3 */
-		const int page = map[quadrant];
-		return page;
-	}
+	std::array<std::array<u8, page_size>, 4> nametable_ram{};
+
+	std::array<const u8*, num_pattern_table_pages> chr_pages{}; /* PPU $0000-$1FFF, in 1 KiB pages */
+	std::array<u8*, num_pattern_table_pages> chr_ram_pages{}; /* The same pages where they are CHR RAM, for writing; otherwise nullptr */
+	std::array<u8*, 4> nametable_pages{}; /* PPU $2000-$2FFF (mirrored at $3000-$3EFF), in 1 KiB pages */
 };
 
@@ -5,8 +5,8 @@
 class CNROM : public BaseMapper
 {
 public:
-	CNROM(const std::vector<u8> chr_prg_rom, MapperProperties properties) :
-		BaseMapper(chr_prg_rom, properties) {}
+	CNROM(std::shared_ptr<const RomImage> rom_image, std::span<const u8> chr_prg_rom, MapperProperties properties) :
+		BaseMapper(std::move(rom_image), chr_prg_rom, properties) {}
 
 	u8 ReadPRG(u16 addr) override
 	{
@@ -28,15 +28,10 @@ public:
 		if (addr >= 0x8000)
 		{
 			chr_bank = data % properties.num_chr_banks; // The CHR capacity is at most 32 KiB (four 8 KiB banks). chr_bank is 2 bits.
+			UpdateCHRPages();
 		}
 	};
 
-	u8 ReadCHR(u16 addr) override
-	{
-		// PPU $0000-$1FFF: 8 KiB switchable CHR ROM bank.
-		return chr[addr + 0x2000 * chr_bank];
-	};
-
 	void StreamState(SerializationStream& stream) override
 	{
 		BaseMapper::StreamState(stream);
@@ -45,5 +40,11 @@ public:
 
 protected:
 	unsigned chr_bank : 2 = 0;
+
+	void UpdateCHRPages() override
+	{
+		// PPU $0000-$1FFF: 8 KiB switchable CHR ROM bank.
+		MapCHRPages(0, 8, chr_bank * 8);
+	};
 };
 
@@ -5,8 +5,8 @@
 class MMC1 : public BaseMapper
 {
 public:
-	MMC1(const std::vector<u8> chr_prg_rom, MapperProperties properties) :
-		BaseMapper(chr_prg_rom, MutateProperties(properties)) {}
+	MMC1(std::shared_ptr<const RomImage> rom_image, std::span<const u8> chr_prg_rom, MapperProperties properties) :
+		BaseMapper(std::move(rom_image), chr_prg_rom, MutateProperties(properties)) {}
 
 	// TODO: how to distinguish between the different SxROM boards with CHR ram?
 	// TODO: implement PRG RAM banking
@@ -62,7 +62,7 @@ public:
 		}
 		else if (addr <= 0x7FFF)
 		{
-			prg_ram[addr - 0x6000] = data;
+			WritePRGRAM(addr - 0x6000, data);
 		}
 		else
 		{
@@ -88,14 +88,17 @@ public:
 						chr_mirroring = shift_reg;
 						prg_rom_bank_mode = shift_reg >> 2;
 						chr_bank_mode = shift_reg & 0x10;
+						UpdatePageTables();
 						break;
 
 					case 0xA: case 0xB: /* CHR bank 0 (internal, $A000-$BFFF) */
 						chr_bank_0 = shift_reg % properties.num_chr_banks;
+						UpdateCHRPages();
 						break;
 
 					case 0xC: case 0xD: /* CHR bank 1 (internal, $C000-$DFFF) */
 						chr_bank_1 = shift_reg % properties.num_chr_banks;
+						UpdateCHRPages();
 						break;
 
 					case 0xE: case 0xF: /* PRG bank (internal, $E000-$FFFF) */
@@ -112,45 +115,6 @@ public:
 		}
 	};
 
-	u8 ReadCHR(u16 addr) override
-	{
-		// 8 KiB mode; $0000-$1FFF is mapped to a single 8 KiB bank (bit 0 of the bank number is ignored).
-		// Effectively, this is mapping $0000-$0FFF to 'chr_bank_0 & ~0x01', and $1000-$1FFF to '(chr_bank_0 & ~0x01) + 1'
-		// If 'chr_bank_0 & ~0x01' is the last 4 KiB bank, transform addresses in $1000-$1FFF into $0000-$0FFF
-		if (chr_bank_mode == 0)
-		{
-			u8 aligned_bank = chr_bank_0 & ~0x01;
-			if (aligned_bank == properties.num_chr_banks - 1)
-				addr &= 0xFFF;
-			return chr[addr + 0x1000 * aligned_bank];
-		}
-		// 4 KiB mode; $0000-$0FFF and $1000-$1FFF are mapped to separate 4 KiB banks.
-		if (addr <= 0x0FFF)
-			return chr[addr + 0x1000 * chr_bank_0];
-		return chr[addr - 0x1000 + 0x1000 * chr_bank_1];
-	};
-
-	void WriteCHR(u16 addr, u8 data) override
-	{
-		if (!properties.has_chr_ram)
-			return;
-
-		if (chr_bank_mode == 0)
-		{
-			u8 aligned_bank = chr_bank_0 & ~0x01;
-			if (aligned_bank == properties.num_chr_banks - 1)
-				addr &= 0xFFF;
-			chr[addr + 0x1000 * aligned_bank] = data;
-		}
-		else
-		{
-			if (addr <= 0x0FFF)
-				chr[addr + 0x1000 * chr_bank_0] = data;
-			else
-				chr[addr - 0x1000 + 0x1000 * chr_bank_1] = data;
-		}
-	};
-
 	const std::array<int, 4>& GetNametableMap() const override
 	{
 		switch (chr_mirroring)
@@ -191,6 +155,25 @@ protected:
 	unsigned shift_reg : 5 = 0x10;
 	unsigned times_written_to_control_register = 0;
 
+	void UpdateCHRPages() override
+	{
+		// 8 KiB mode; $0000-$1FFF is mapped to a single 8 KiB bank (bit 0 of the bank number is ignored).
+		// Effectively, this is mapping $0000-$0FFF to 'chr_bank_0 & ~0x01', and $1000-$1FFF to '(chr_bank_0 & ~0x01) + 1'
+		// If 'chr_bank_0 & ~0x01' is the last 4 KiB bank, $1000-$1FFF is mapped to the same bank as $0000-$0FFF.
+		if (chr_bank_mode == 0)
+		{
+			u8 aligned_bank = chr_bank_0 & ~0x01;
+			MapCHRPages(0, 4, aligned_bank * 4);
+			MapCHRPages(4, 4, (aligned_bank == properties.num_chr_banks - 1 ? aligned_bank : aligned_bank + 1) * 4);
+		}
+		// 4 KiB mode; $0000-$0FFF and $1000-$1FFF are mapped to separate 4 KiB banks.
+		else
+		{
+			MapCHRPages(0, 4, chr_bank_0 * 4);
+			MapCHRPages(4, 4, chr_bank_1 * 4);
+		}
+	};
+
 private:
 	static MapperProperties MutateProperties(MapperProperties properties)
 	{
@@ -8,8 +8,8 @@
 class MMC3 : public BaseMapper
 {
 public:
-	MMC3(const std::vector<u8> chr_prg_rom, MapperProperties properties) :
-		BaseMapper(chr_prg_rom, MutateProperties(properties)) {}
+	MMC3(std::shared_ptr<const RomImage> rom_image, std::span<const u8> chr_prg_rom, MapperProperties properties) :
+		BaseMapper(std::move(rom_image), chr_prg_rom, MutateProperties(properties)) {}
 
 	u8 ReadPRG(u16 addr) override
 	{
@@ -50,7 +50,7 @@ public:
 		{
 		// CPU $6000-$7FFF: 8 KiB PRG RAM bank (optional)
 		case 0x6: case 0x7:
-			prg_ram[addr - 0x6000] = data;
+			WritePRGRAM(addr - 0x6000, data);
 			break;
 
 		// CPU $8000-$9FFF; bank select (even), bank data (odd)
@@ -65,12 +65,15 @@ public:
 				/* R6 and R7 (PRG) will ignore the top two bits, as MMC3 has only 6 PRG ROM address lines. */
 				else if (bank_reg_select == 6 || bank_reg_select == 7)
 					rom_bank[bank_reg_select] &= 0x3F;
+				if (bank_reg_select <= 5)
+					UpdateCHRPages();
 			}
 			else
 			{
 				bank_reg_select = data;
 				prg_rom_bank_mode = data & 0x40;
 				chr_a12_inversion = data & 0x80;
+				UpdateCHRPages();
 			}
 			break;
 
@@ -84,6 +87,7 @@ public:
 			else
 			{
 				nametable_mirroring = data & 0x01; // (0: vertical; 1: horizontal)
+				UpdateNametablePages();
 			}
 			break;
 
@@ -111,20 +115,6 @@ public:
 		}
 	};
 
-	u8 ReadCHR(u16 addr) override
-	{
-		size_t physical_addr = GetPhysicalCHRAddress(addr);
-		return chr[physical_addr];
-	}
-
-	void WriteCHR(u16 addr, u8 data) override
-	{
-		if (!properties.has_chr_ram)
-			return;
-		size_t physical_addr = GetPhysicalCHRAddress(addr);
-		chr[physical_addr] = data;
-	}
-
 	const std::array<int, 4>& GetNametableMap() const override
 	{
 		/* $A000.0 is ignored on cartridges with hardwired 4-screen VRAM. */
@@ -204,7 +194,7 @@ protected:
 	u8 prg_ram_open_bus = 0;
 	std::array<u8, 8> rom_bank{}; // 0..5 : CHR; 6, 7 : PRG
 
-	size_t GetPhysicalCHRAddress(const u16 addr) const
+	void UpdateCHRPages() override
 	{
 		/* CHR map mode -> $8000.D7 = 0  $8000.D7 = 1
 		   PPU Bank	         Value of MMC3 register
@@ -220,58 +210,14 @@ protected:
 		   CHR inversion:
 		   0: two 2 KB banks at $0000-$0FFF, four 1 KB banks at $1000-$1FFF;
 		   1: two 2 KB banks at $1000-$1FFF, four 1 KB banks at $0000-$0FFF.
+		   The bank numbers count 1 KiB units; the 2 KiB banks (R0, R1) always have bit 0 cleared.
 		*/
-		switch (addr >> 8)
-		{
-		// PPU $0000-$07FF (or $1000-$17FF): 2 KiB switchable CHR bank
-		case 0x00: case 0x01: case 0x02: case 0x03:
-			if (chr_a12_inversion == 0)
-				return addr + 0x400 * rom_bank[0];
-			return addr + 0x400 * rom_bank[2];
-
-		case 0x04: case 0x05: case 0x06: case 0x07:
-			if (chr_a12_inversion == 0)
-				return addr + 0x400 * rom_bank[0];
-			return addr + 0x400 * rom_bank[3] - 0x400;
-
-		// PPU $0800-$0FFF (or $1800-$1FFF): 2 KiB switchable CHR bank
-		case 0x08: case 0x09: case 0x0A: case 0x0B:
-			if (chr_a12_inversion == 0)
-				return addr + 0x400 * rom_bank[1] - 0x800;
-			return addr + 0x400 * rom_bank[4] - 0x800;
-
-		case 0x0C: case 0x0D: case 0x0E: case 0x0F:
-			if (chr_a12_inversion == 0)
-				return addr + 0x400 * rom_bank[1] - 0x800;
-			return addr + 0x400 * rom_bank[5] - 0xC00;
-
-		// PPU $1000-$13FF (or $0000-$03FF): 1 KiB switchable CHR bank
-		case 0x10: case 0x11: case 0x12: case 0x13:
-			if (chr_a12_inversion == 0)
-				return addr + 0x400 * rom_bank[2] - 0x1000;
-			return addr + 0x400 * rom_bank[0] - 0x1000;
-
-		// PPU $1400-$17FF (or $0400-$07FF): 1 KiB switchable CHR bank
-		case 0x14: case 0x15: case 0x16: case 0x17:
-			if (chr_a12_inversion == 0)
-				return addr + 0x400 * rom_bank[3] - 0x1400;
-			return addr + 0x400 * rom_bank[0] - 0x1000;
-
-		// PPU $1800-$1BFF (or $0800-$0BFF): 1 KiB switchable CHR bank
-		case 0x18: case 0x19: case 0x1A: case 0x1B:
-			if (chr_a12_inversion == 0)
-				return addr + 0x400 * rom_bank[4] - 0x1800;
-			return addr + 0x400 * rom_bank[1] - 0x1800;
-
-		// PPU $1C00-$1FFF (or $0C00-$0FFF): 1 KiB switchable CHR bank
-		case 0x1C: case 0x1D: case 0x1E: case 0x1F:
-			if (chr_a12_inversion == 0)
-				return addr + 0x400 * rom_bank[5] - 0x1C00;
-			return addr + 0x400 * rom_bank[1] - 0x1800;
-
-		default: /* Should never happen */
-			throw std::runtime_error(std::format("Invalid address ${:X} given as argument to MMC3::GetPhysicalCHRAddress(u16). The range is $0000-$1FFF.", addr));
-		}
+		const unsigned two_kib_banks_page = chr_a12_inversion ? 4 : 0;
+		const unsigned one_kib_banks_page = chr_a12_inversion ? 0 : 4;
+		MapCHRPages(two_kib_banks_page, 2, rom_bank[0]);
+		MapCHRPages(two_kib_banks_page + 2, 2, rom_bank[1]);
+		for (unsigned i = 0; i < 4; i++)
+			MapCHRPages(one_kib_banks_page + i, 1, rom_bank[2 + i]);
 	}
 
 private:
@@ -5,8 +5,8 @@
 class Mapper094 : public UxROM
 {
 public:
-	Mapper094(const std::vector<u8> chr_prg_rom, MapperProperties properties) :
-		UxROM(chr_prg_rom, properties) {}
+	Mapper094(std::shared_ptr<const RomImage> rom_image, std::span<const u8> chr_prg_rom, MapperProperties properties) :
+		UxROM(std::move(rom_image), chr_prg_rom, properties) {}
 
 	void WritePRG(u16 addr, u8 data) override
 	{
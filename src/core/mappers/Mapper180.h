@@ -5,8 +5,8 @@
 class Mapper180 : public UxROM
 {
 public:
-	Mapper180(const std::vector<u8> chr_prg_rom, MapperProperties properties) :
-		UxROM(chr_prg_rom, properties) {}
+	Mapper180(std::shared_ptr<const RomImage> rom_image, std::span<const u8> chr_prg_rom, MapperProperties properties) :
+		UxROM(std::move(rom_image), chr_prg_rom, properties) {}
 
 	u8 ReadPRG(u16 addr) override
 	{
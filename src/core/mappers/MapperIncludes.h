@@ -7,4 +7,5 @@
 #include "MMC1.h"
 #include "MMC3.h"
 #include "NROM.h"
+#include "NSF.h"
 #include "UxROM.h"
\ No newline at end of file
@@ -5,8 +5,8 @@
 class NROM : public BaseMapper
 {
 public:
-	NROM(const std::vector<u8> chr_prg_rom, MapperProperties properties) :
-		BaseMapper(chr_prg_rom, MutateProperties(properties)) {}
+	NROM(std::shared_ptr<const RomImage> rom_image, std::span<const u8> chr_prg_rom, MapperProperties properties) :
+		BaseMapper(std::move(rom_image), chr_prg_rom, MutateProperties(properties)) {}
 
 	u8 ReadPRG(u16 addr) override
 	{
@@ -32,22 +32,10 @@ public:
 	{
 		if (addr >= 0x6000 && addr <= 0x7FFF)
 		{
-			prg_ram[addr - 0x6000] = data;
+			WritePRGRAM(addr - 0x6000, data);
 		}
 	};
 
-	u8 ReadCHR(u16 addr) override
-	{
-		// PPU $0000-$1FFF: 8 KiB (not bank switched)
-		return chr[addr];
-	};
-
-	void WriteCHR(u16 addr, u8 data) override
-	{
-		if (properties.has_chr_ram)
-			chr[addr] = data;
-	};
-
 	void StreamState(SerializationStream& stream) override
 	{
 		BaseMapper::StreamState(stream);
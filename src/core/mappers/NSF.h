@@ -0,0 +1,100 @@
+#pragma once
+
+#include <array>
+#include <string>
+
+#include "BaseMapper.h"
+
+/* The properties of an NSF tune, as given by its header (https://wiki.nesdev.org/w/index.php?title=NSF). */
+struct NSFProperties
+{
+	std::string title;
+	std::string artist;
+	std::string copyright;
+
+	unsigned num_songs{};
+	unsigned starting_song{}; /* Counting from 0 (the header counts from 1) */
+
+	u16 load_addr{};
+	u16 init_addr{};
+	u16 play_addr{};
+
+	/* The interval between two calls of the PLAY routine, in microseconds */
+	unsigned play_period_ntsc_us{};
+	unsigned play_period_pal_us{};
+
+	bool bankswitched{};
+	std::array<u8, 8> initial_banks{};
+};
+
+/* Not a mapper in the sense of the other ones, but the cartridge side of an NSF player: the tune's data is mapped to
+   $8000-$FFFF in eight 4 KiB banks, which are switched through $5FF8-$5FFF if the tune uses bankswitching, and there is
+   8 KiB of PRG RAM at $6000-$7FFF. The rest of the player (the driver that calls INIT and PLAY) lives in NSFBus.
+   The tune's data is given as a PRG image that starts at the beginning of the first bank. */
+class NSF : public BaseMapper
+{
+public:
+	NSF(std::shared_ptr<const RomImage> prg_image, MapperProperties properties, NSFProperties nsf_properties) :
+		BaseMapper(prg_image, prg_image->GetData(), MutateProperties(properties)), nsf_properties(std::move(nsf_properties))
+	{
+		Reset();
+	}
+
+	const NSFProperties& GetNSFProperties() const { return nsf_properties; }
+
+	/* Restores the banks the tune starts with, and clears PRG RAM, as is done before every call of INIT. */
+	void Reset()
+	{
+		banks = nsf_properties.initial_banks;
+		std::fill(prg_ram.begin(), prg_ram.end(), 0x00);
+	}
+
+	u8 ReadPRG(u16 addr) override
+	{
+		// CPU $8000-$FFFF: eight 4 KiB banks
+		if (addr >= 0x8000)
+		{
+			return prg_rom[banks[addr >> 12 & 7] % num_banks * bank_size + (addr & (bank_size - 1))];
+		}
+		// CPU $6000-$7FFF: 8 KiB of PRG RAM
+		if (addr >= 0x6000)
+		{
+			return prg_ram[addr - 0x6000];
+		}
+		return 0xFF;
+	};
+
+	void WritePRG(u16 addr, u8 data) override
+	{
+		if (addr >= 0x6000 && addr <= 0x7FFF)
+		{
+			prg_ram[addr - 0x6000] = data;
+		}
+		// CPU $5FF8-$5FFF: bank select for $8000-$8FFF, $9000-$9FFF, ..., $F000-$FFFF
+		else if (addr >= 0x5FF8 && addr <= 0x5FFF && nsf_properties.bankswitched)
+		{
+			banks[addr - 0x5FF8] = data;
+		}
+	};
+
+	void StreamState(SerializationStream& stream) override
+	{
+		BaseMapper::StreamState(stream);
+		stream.StreamArray(banks);
+	};
+
+	static constexpr size_t bank_size = 0x1000;
+
+private:
+	const NSFProperties nsf_properties;
+	const size_t num_banks = prg_rom.size() / bank_size;
+
+	std::array<u8, 8> banks{};
+
+	static MapperProperties MutateProperties(MapperProperties properties)
+	{
+		SetCHRRAMSize(properties, 0x2000);
+		SetPRGRAMSize(properties, 0x2000);
+		return properties;
+	};
+};
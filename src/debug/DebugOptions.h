@@ -10,4 +10,7 @@
 #define DEBUG_LOG_PATH "F:\\nes_trace.log"
 #define MESEN_LOG_PATH "C:\\Users\\Christoffer\\Documents\\Emulators\\Mesen.0.9.9\\Debugger\\Trace - Kirby's Adventure (USA) (Rev 1).txt"
 
-#define DEBUG (DEBUG_LOG || DEBUG_COMPARE_MESEN)
\ No newline at end of file
+/* Only defined if one of the above is, since the state of every emulator instance is then copied into the (global) logging state on each cycle. */
+#if defined(DEBUG_LOG) || defined(DEBUG_COMPARE_MESEN)
+#define DEBUG
+#endif
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+#include "../Types.h"
+
+/* The parts of the PPU state that the PPU viewer draws from, as they were at the start of a vblank. */
+struct PPUSnapshot
+{
+	std::array<u8, 0x2000> pattern_tables{}; /* PPU $0000-$1FFF, through the CHR banks mapped at the time */
+	std::array<u8, 0x1000> nametables{}; /* PPU $2000-$2FFF, with the mirroring at the time */
+	std::array<u8, 0x100> oam{};
+	std::array<u8, 0x20> palette_ram{};
+	u16 scroll_t = 0; /* The 't' scroll register (yyy NN YYYYY XXXXX), i.e. where the next frame starts rendering from */
+	u8 fine_x_scroll = 0;
+	u8 ppuctrl = 0;
+	u8 ppumask = 0;
+	u64 frame = 0;
+};
+
+/* Hands snapshots of the PPU over from the emulation thread to a viewer thread. The PPU copies its state only after a viewer
+   has asked for it, at the start of the next vblank. The cost thus follows how often the viewer refreshes, not how fast the emulation runs,
+   and is a single atomic load per frame when no viewer is open. */
+class PPUSnapshotChannel
+{
+public:
+	/* Called by the viewer. Blocks until the PPU has filled in 'snapshot', or until 'timeout' has passed (e.g. since the emulation is paused).
+	   Returns whether the snapshot was filled in. */
+	bool Request(PPUSnapshot& snapshot, std::chrono::milliseconds timeout)
+	{
+		std::unique_lock lock{ mutex };
+		destination = &snapshot;
+		requested.store(true, std::memory_order_relaxed);
+		const bool filled = snapshot_taken.wait_for(lock, timeout, [&] { return !requested.load(std::memory_order_relaxed); });
+		requested.store(false, std::memory_order_relaxed);
+		destination = nullptr;
+		return filled;
+	}
+
+	/* Called by the PPU at the start of every vblank. */
+	bool IsRequested() const { return requested.load(std::memory_order_relaxed); }
+
+	/* Called by the PPU when 'IsRequested' returns true. 'fill' is given the snapshot to write to. */
+	template<typename Fill>
+	void Fulfil(Fill fill)
+	{
+		std::lock_guard lock{ mutex };
+		if (!requested.load(std::memory_order_relaxed))
+			return; /* The viewer gave up waiting in between. */
+		fill(*destination);
+		requested.store(false, std::memory_order_relaxed);
+		snapshot_taken.notify_one();
+	}
+
+private:
+	std::atomic<bool> requested = false;
+	std::condition_variable snapshot_taken;
+	std::mutex mutex;
+	PPUSnapshot* destination = nullptr;
+};
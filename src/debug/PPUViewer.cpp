@@ -0,0 +1,214 @@
+#include "PPUViewer.h"
+
+
+PPUViewer::PPUViewer(PPUSnapshotChannel& snapshot_channel, const std::array<u32, 512>& rgb_palette) :
+	snapshot_channel(snapshot_channel), rgb_palette(rgb_palette)
+{
+}
+
+
+PPUViewer::~PPUViewer()
+{
+	Stop();
+}
+
+
+void PPUViewer::Start(const unsigned refresh_rate)
+{
+	Stop();
+	this->refresh_rate = std::max(refresh_rate, 1u);
+	stop_requested = false;
+	viewer_thread = std::thread{ &PPUViewer::ViewerLoop, this };
+}
+
+
+void PPUViewer::Stop()
+{
+	if (!viewer_thread.joinable())
+		return;
+	{
+		std::lock_guard lock{ mutex };
+		stop_requested = true;
+	}
+	stop_condition.notify_one();
+	viewer_thread.join();
+}
+
+
+std::optional<PPUViewer::Images> PPUViewer::TakeImages()
+{
+	std::lock_guard lock{ mutex };
+	if (!has_new_images)
+		return std::nullopt;
+	has_new_images = false;
+	return std::move(latest_images);
+}
+
+
+void PPUViewer::ViewerLoop()
+{
+	const auto refresh_period = std::chrono::nanoseconds(std::chrono::seconds(1)) / refresh_rate;
+	auto next_refresh_t = std::chrono::steady_clock::now();
+	while (true)
+	{
+		/* While the emulation is paused or stopped, no snapshot arrives, and the last images are left as they are. */
+		if (snapshot_channel.Request(snapshot, snapshot_timeout))
+		{
+			Images images = Draw(snapshot);
+			std::lock_guard lock{ mutex };
+			latest_images = std::move(images);
+			has_new_images = true;
+		}
+
+		next_refresh_t = std::max(next_refresh_t + refresh_period, std::chrono::steady_clock::now());
+		std::unique_lock lock{ mutex };
+		if (stop_condition.wait_until(lock, next_refresh_t, [&] { return stop_requested; }))
+			return;
+	}
+}
+
+
+PPUViewer::Images PPUViewer::Draw(const PPUSnapshot& snapshot) const
+{
+	Images images;
+	images.nametables = DrawNametables(snapshot);
+	images.pattern_tables = DrawPatternTables(snapshot, pattern_table_palette);
+	images.sprites = DrawSprites(snapshot);
+	images.palettes = DrawPalettes(snapshot);
+	images.frame = snapshot.frame;
+	return images;
+}
+
+
+PPUViewer::Image PPUViewer::DrawNametables(const PPUSnapshot& snapshot) const
+{
+	Image image{ 512, 480, std::vector<u32>(512 * 480) };
+	const u16 pattern_table_addr = snapshot.ppuctrl & 0x10 ? 0x1000 : 0x0000;
+	for (unsigned nametable = 0; nametable < 4; nametable++)
+	{
+		const u8* nametable_data = &snapshot.nametables[nametable * 0x400];
+		const unsigned nametable_x = (nametable & 1) * 256;
+		const unsigned nametable_y = (nametable >> 1) * 240;
+		for (unsigned tile_y = 0; tile_y < 30; tile_y++)
+		{
+			for (unsigned tile_x = 0; tile_x < 32; tile_x++)
+			{
+				/* Every attribute table byte covers 4x4 tiles, with two bits for each 2x2 tile quadrant. */
+				const u8 attribute = nametable_data[0x3C0 + tile_y / 4 * 8 + tile_x / 4];
+				const unsigned palette = attribute >> ((tile_y & 2) << 1 | (tile_x & 2)) & 3;
+				DrawTile(image, nametable_x + tile_x * 8, nametable_y + tile_y * 8, snapshot,
+					pattern_table_addr, nametable_data[tile_y * 32 + tile_x], palette);
+			}
+		}
+	}
+
+	/* Outline the 256x240 area that rendering starts from, wrapping around the edges like the scrolling does.
+	   The outline inverts the colours below it, so that it can be seen on any background. */
+	const unsigned scroll_x = (snapshot.scroll_t & 0x1F) * 8 + snapshot.fine_x_scroll + (snapshot.scroll_t >> 10 & 1) * 256;
+	const unsigned scroll_y = (snapshot.scroll_t >> 5 & 0x1F) * 8 + (snapshot.scroll_t >> 12 & 7) + (snapshot.scroll_t >> 11 & 1) * 240;
+	auto InvertPixel = [&](unsigned x, unsigned y) {
+		image.pixels[(y % 480) * 512 + x % 512] ^= 0xFFFFFF;
+	};
+	for (unsigned x = 0; x < 256; x++)
+	{
+		InvertPixel(scroll_x + x, scroll_y);
+		InvertPixel(scroll_x + x, scroll_y + 239);
+	}
+	for (unsigned y = 1; y < 239; y++)
+	{
+		InvertPixel(scroll_x, scroll_y + y);
+		InvertPixel(scroll_x + 255, scroll_y + y);
+	}
+	return image;
+}
+
+
+PPUViewer::Image PPUViewer::DrawPatternTables(const PPUSnapshot& snapshot, const unsigned palette) const
+{
+	Image image{ 256, 128, std::vector<u32>(256 * 128) };
+	for (unsigned table = 0; table < 2; table++)
+	{
+		for (unsigned tile = 0; tile < 256; tile++)
+			DrawTile(image, table * 128 + tile % 16 * 8, tile / 16 * 8, snapshot, u16(table * 0x1000), u8(tile), palette);
+	}
+	return image;
+}
+
+
+PPUViewer::Image PPUViewer::DrawSprites(const PPUSnapshot& snapshot) const
+{
+	const unsigned width = 8 * sprite_cell_width, height = 8 * sprite_cell_height;
+	Image image{ width, height, std::vector<u32>(width * height, border_colour) };
+	const bool sprites_are_8x16 = snapshot.ppuctrl & 0x20;
+	for (unsigned sprite = 0; sprite < 64; sprite++)
+	{
+		const u8 tile = snapshot.oam[4 * sprite + 1];
+		const u8 attributes = snapshot.oam[4 * sprite + 2];
+		const unsigned palette = 4 + (attributes & 3);
+		const bool flip_horizontally = attributes & 0x40, flip_vertically = attributes & 0x80;
+		const unsigned x = sprite % 8 * sprite_cell_width + 1, y = sprite / 8 * sprite_cell_height + 1;
+
+		for (unsigned row = 0; row < 16; row++)
+			std::fill_n(&image.pixels[(y + row) * width + x], 8, GetColour(snapshot, 0, 0));
+
+		if (sprites_are_8x16)
+		{
+			/* Bit 0 of the tile number selects the pattern table, and the sprite is made up of the tile pair starting at the even tile number.
+			   Flipping vertically also swaps the two tiles. */
+			const u16 pattern_table_addr = tile & 1 ? 0x1000 : 0x0000;
+			const u8 top_tile = tile & 0xFE;
+			DrawTile(image, x, y    , snapshot, pattern_table_addr, top_tile + flip_vertically , palette, flip_horizontally, flip_vertically);
+			DrawTile(image, x, y + 8, snapshot, pattern_table_addr, top_tile + !flip_vertically, palette, flip_horizontally, flip_vertically);
+		}
+		else
+		{
+			const u16 pattern_table_addr = snapshot.ppuctrl & 0x08 ? 0x1000 : 0x0000;
+			DrawTile(image, x, y, snapshot, pattern_table_addr, tile, palette, flip_horizontally, flip_vertically);
+		}
+	}
+	return image;
+}
+
+
+PPUViewer::Image PPUViewer::DrawPalettes(const PPUSnapshot& snapshot) const
+{
+	Image image{ 256, 32, std::vector<u32>(256 * 32) };
+	for (unsigned entry = 0; entry < 0x20; entry++)
+	{
+		/* $3F10/$3F14/$3F18/$3F1C are mirrors of $3F00/$3F04/$3F08/$3F0C. */
+		const unsigned addr = (entry & 0x13) == 0x10 ? entry - 0x10 : entry;
+		const u32 colour = rgb_palette[snapshot.palette_ram[addr] & 0x3F];
+		const unsigned x = entry % 16 * 16, y = entry / 16 * 16;
+		for (unsigned row = 0; row < 16; row++)
+			std::fill_n(&image.pixels[(y + row) * 256 + x], 16, colour);
+	}
+	return image;
+}
+
+
+void PPUViewer::DrawTile(Image& image, const unsigned x, const unsigned y, const PPUSnapshot& snapshot, const u16 pattern_table_addr,
+	const u8 tile, const unsigned palette, const bool flip_horizontally, const bool flip_vertically) const
+{
+	/* A tile is 16 bytes: bit 0 of the colour ids of its eight rows, then bit 1. The leftmost pixel is in the most significant bit. */
+	const u8* pattern = &snapshot.pattern_tables[pattern_table_addr + tile * 16];
+	for (unsigned row = 0; row < 8; row++)
+	{
+		const unsigned pattern_row = flip_vertically ? 7 - row : row;
+		const u8 low = pattern[pattern_row], high = pattern[pattern_row + 8];
+		u32* dst = &image.pixels[(y + row) * image.width + x];
+		for (unsigned col = 0; col < 8; col++)
+		{
+			const unsigned bit = flip_horizontally ? col : 7 - col;
+			const unsigned colour_id = (low >> bit & 1) | (high >> bit & 1) << 1;
+			dst[col] = GetColour(snapshot, palette, colour_id);
+		}
+	}
+}
+
+
+u32 PPUViewer::GetColour(const PPUSnapshot& snapshot, const unsigned palette, const unsigned colour_id) const
+{
+	/* Colour 0 of every palette shows the backdrop colour ($3F00). */
+	const u8 entry = colour_id == 0 ? snapshot.palette_ram[0] : snapshot.palette_ram[4 * palette + colour_id];
+	return rgb_palette[entry & 0x3F];
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "../Types.h"
+
+#include "PPUSnapshot.h"
+
+/* Draws the PPU state for debugging: the four nametables with the area shown on screen outlined, both pattern tables
+   (in a selectable palette), the 64 sprites in OAM, and palette RAM. Drawing happens on a thread of its own, from snapshots
+   that it asks the PPU for 'refresh_rate' times per second (see PPUSnapshotChannel), so that the emulation thread does nothing
+   but copy the snapshot, and does not even do that when no viewer is running. */
+class PPUViewer
+{
+public:
+	struct Image
+	{
+		unsigned width = 0, height = 0;
+		std::vector<u32> pixels; /* XRGB8888, row by row */
+	};
+
+	struct Images
+	{
+		Image nametables; /* 512x480: the nametables at PPU $2000, $2400, $2800 and $2C00, laid out left to right, top to bottom */
+		Image pattern_tables; /* 256x128: the pattern tables at PPU $0000 and $1000 */
+		Image sprites; /* The 64 sprites in OAM, in eight rows of eight */
+		Image palettes; /* 256x32: the background palettes on the top row, the sprite palettes on the bottom one */
+		u64 frame = 0;
+	};
+
+	PPUViewer(PPUSnapshotChannel& snapshot_channel, const std::array<u32, 512>& rgb_palette);
+	~PPUViewer();
+	PPUViewer(const PPUViewer& other) = delete;
+	PPUViewer(PPUViewer&& other) = delete;
+
+	PPUViewer& operator=(const PPUViewer& other) = delete;
+	PPUViewer& operator=(PPUViewer&& other) = delete;
+
+	static constexpr unsigned default_refresh_rate = 15;
+
+	void Start(unsigned refresh_rate = default_refresh_rate);
+	void Stop();
+	bool IsRunning() const { return viewer_thread.joinable(); }
+
+	/* The palette (0-3: background, 4-7: sprites) that the pattern tables are drawn in. */
+	void SetPatternTablePalette(unsigned palette) { pattern_table_palette = palette & 7; }
+
+	/* Returns the images drawn since the last call, if any. */
+	std::optional<Images> TakeImages();
+
+	Images Draw(const PPUSnapshot& snapshot) const;
+
+private:
+	static constexpr unsigned sprite_cell_width = 10; /* An 8x16 sprite, with a border of one pixel around it */
+	static constexpr unsigned sprite_cell_height = 18;
+	static constexpr u32 border_colour = 0x404040;
+	static constexpr std::chrono::milliseconds snapshot_timeout{ 100 };
+
+	PPUSnapshotChannel& snapshot_channel;
+	const std::array<u32, 512>& rgb_palette;
+
+	bool stop_requested = false;
+	bool has_new_images = false;
+	std::atomic<unsigned> pattern_table_palette = 0;
+	unsigned refresh_rate = default_refresh_rate;
+
+	Images latest_images;
+	PPUSnapshot snapshot;
+	std::condition_variable stop_condition;
+	std::mutex mutex;
+	std::thread viewer_thread;
+
+	void ViewerLoop();
+
+	Image DrawNametables(const PPUSnapshot& snapshot) const;
+	Image DrawPatternTables(const PPUSnapshot& snapshot, unsigned palette) const;
+	Image DrawSprites(const PPUSnapshot& snapshot) const;
+	Image DrawPalettes(const PPUSnapshot& snapshot) const;
+
+	/* Draws the 8x8 tile 'tile' of the pattern table at 'pattern_table_addr', with its top left corner at (x, y). Colour 0 is the backdrop colour. */
+	void DrawTile(Image& image, unsigned x, unsigned y, const PPUSnapshot& snapshot, u16 pattern_table_addr, u8 tile,
+		unsigned palette, bool flip_horizontally = false, bool flip_vertically = false) const;
+	u32 GetColour(const PPUSnapshot& snapshot, unsigned palette, unsigned colour_id) const;
+};
@@ -0,0 +1,435 @@
+#include "RegressionSuite.h"
+
+#include <algorithm>
+#include <filesystem>
+
+
+int RegressionSuite::Run(const std::string& suite_path, const std::string& database_path, const Mode mode,
+	const unsigned num_threads, std::ostream& report)
+{
+	const std::optional<std::vector<Job>> jobs = ParseSuite(suite_path, report);
+	if (!jobs.has_value())
+		return 2;
+
+	Database database;
+	if (mode == Mode::Verify)
+	{
+		std::optional<Database> database_opt = ReadDatabase(database_path, report);
+		if (!database_opt.has_value())
+			return 2;
+		database = std::move(database_opt.value());
+	}
+
+	const auto start_t = std::chrono::steady_clock::now();
+
+	/* Every job gets its own emulator instance, so they can all run at the same time. The results are reported in the order of the suite. */
+	std::vector<JobResult> results(jobs->size());
+	size_t num_failed = 0, num_mismatched = 0;
+	{
+		ThreadPool thread_pool{ std::max(num_threads, 1u) };
+		std::vector<std::future<void>> futures;
+		for (size_t i = 0; i < jobs->size(); i++)
+			futures.push_back(thread_pool.Submit([&, i] { results[i] = RunJob((*jobs)[i]); }));
+
+		for (size_t i = 0; i < jobs->size(); i++)
+		{
+			futures[i].get();
+			const Job& job = (*jobs)[i];
+			const JobResult& result = results[i];
+			if (!result.error.empty())
+			{
+				report << std::format("FAIL {}: {}\n", job.name, result.error);
+				num_failed++;
+			}
+			else if (mode == Mode::Verify && !Verify(job, result, database, report))
+			{
+				report << std::format("FAIL {}\n", job.name);
+				num_mismatched++;
+			}
+			else
+			{
+				report << std::format("{} {} ({} checkpoints)\n", mode == Mode::Verify ? "PASS" : "DONE", job.name, result.checkpoints.size());
+			}
+		}
+	}
+
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_t).count();
+	unsigned long long num_frames = 0;
+	for (const Job& job : *jobs)
+		num_frames += job.num_frames;
+
+	report << std::format("{} jobs, {} frames in {:.2f} s ({:.0f} frames/s); {} failed to run, {} did not match.\n",
+		jobs->size(), num_frames, seconds, num_frames / std::max(seconds, 1e-9), num_failed, num_mismatched);
+
+	if (mode == Mode::Record)
+	{
+		if (!WriteDatabase(database_path, *jobs, results))
+		{
+			report << std::format("Could not write the database {}.\n", database_path);
+			return 2;
+		}
+		report << std::format("Recorded the hashes to {}.\n", database_path);
+	}
+
+	return num_failed == 0 && num_mismatched == 0 ? 0 : 1;
+}
+
+
+RegressionSuite::JobResult RegressionSuite::RunJob(const Job& job)
+{
+	JobResult result;
+
+	Emulator emulator;
+
+	/* Attached before powering on, so that the audio is synthesized from the first cycle; jobs that do not hash the audio
+	   have no audio sink, and the APU runs in register-only mode. */
+	u64 audio_hash = Hash::fnv_offset_basis;
+	if (job.hash_audio)
+	{
+		emulator.SetSampleBlockListener([&](const f32* samples, size_t num_samples) {
+			audio_hash = Hash::FNV1a(samples, num_samples * sizeof(f32), audio_hash);
+		});
+	}
+
+	if (!emulator.PrepareHeadlessRun(job.rom_path))
+	{
+		result.error = std::format("could not load {}", job.rom_path);
+		return result;
+	}
+
+	if (job.nsf_song.has_value() && !emulator.SelectNSFSong(job.nsf_song.value() - 1))
+	{
+		result.error = std::format("{} is not an NSF tune with a song number {}", job.rom_path, job.nsf_song.value());
+		return result;
+	}
+
+	/* No frame is dropped when capturing, since it costs only time to wait for the encoder here. */
+	if (!job.capture_path.empty() && !emulator.StartVideoCapture(job.capture_path,
+		VideoCapture::GetFormatFromPath(job.capture_path).value(), VideoCapture::OverflowPolicy::Block))
+	{
+		result.error = std::format("could not start capturing video to {}", job.capture_path);
+		return result;
+	}
+
+	if (!job.audio_capture_path.empty() && !emulator.StartAudioCapture(job.audio_capture_path,
+		AudioCapture::GetFormatFromPath(job.audio_capture_path).value(), AudioCapture::SampleFormat::F32, job.capture_stems))
+	{
+		result.error = std::format("could not start capturing audio to {}", job.audio_capture_path);
+		return result;
+	}
+
+	auto next_input_change = job.input_changes.begin();
+	auto next_checkpoint = job.checkpoints.begin();
+	try {
+		for (unsigned frame = 0; frame < job.num_frames; frame++)
+		{
+			for (; next_input_change != job.input_changes.end() && next_input_change->frame == frame; ++next_input_change)
+				emulator.SetButtonStates(next_input_change->buttons, next_input_change->player);
+
+			emulator.RunFrame();
+
+			const unsigned frames_run = frame + 1;
+			bool is_checkpoint = job.checkpoint_interval > 0 && frames_run % job.checkpoint_interval == 0;
+			if (next_checkpoint != job.checkpoints.end() && *next_checkpoint == frames_run)
+			{
+				is_checkpoint = true;
+				++next_checkpoint;
+			}
+			if (is_checkpoint)
+			{
+				const std::vector<u16>& framebuffer = emulator.GetFrameBuffer();
+				Checkpoint checkpoint{ frames_run, Hash::FNV1a(framebuffer.data(), framebuffer.size() * sizeof(u16)) };
+				if (job.hash_audio)
+					checkpoint.audio_hash = audio_hash;
+				result.checkpoints.push_back(checkpoint);
+			}
+		}
+	}
+	catch (const std::runtime_error& e)
+	{
+		result.error = e.what();
+	}
+
+	if (emulator.IsCapturingVideo() && !emulator.StopVideoCapture() && result.error.empty())
+		result.error = std::format("could not write the video capture {}", job.capture_path);
+	if (emulator.IsCapturingAudio() && !emulator.StopAudioCapture() && result.error.empty())
+		result.error = std::format("could not write the audio capture {}", job.audio_capture_path);
+
+	return result;
+}
+
+
+bool RegressionSuite::Verify(const Job& job, const JobResult& result, const Database& database, std::ostream& report)
+{
+	bool matched = true;
+	for (const Checkpoint& checkpoint : result.checkpoints)
+	{
+		auto it = database.find({ job.name, checkpoint.frame });
+		if (it == database.end())
+		{
+			report << std::format("  {} frame {}: no hash has been recorded\n", job.name, checkpoint.frame);
+			matched = false;
+			continue;
+		}
+		const Checkpoint& expected = it->second;
+		if (checkpoint.frame_hash != expected.frame_hash)
+		{
+			report << std::format("  {} frame {}: frame hash {:016X}, expected {:016X}\n",
+				job.name, checkpoint.frame, checkpoint.frame_hash, expected.frame_hash);
+			matched = false;
+		}
+		if (checkpoint.audio_hash.has_value() != expected.audio_hash.has_value())
+		{
+			report << std::format("  {} frame {}: {}\n", job.name, checkpoint.frame, checkpoint.audio_hash.has_value()
+				? "the audio was hashed, but no audio hash has been recorded" : "an audio hash has been recorded, but the audio was not hashed");
+			matched = false;
+		}
+		else if (checkpoint.audio_hash.has_value() && checkpoint.audio_hash != expected.audio_hash)
+		{
+			report << std::format("  {} frame {}: audio hash {:016X}, expected {:016X}\n",
+				job.name, checkpoint.frame, checkpoint.audio_hash.value(), expected.audio_hash.value());
+			matched = false;
+		}
+	}
+
+	/* Checkpoints that were recorded, but that the job no longer reaches */
+	for (auto it = database.lower_bound({ job.name, 0 }); it != database.end() && it->first.first == job.name; ++it)
+	{
+		const unsigned frame = it->first.second;
+		const bool was_run = std::any_of(result.checkpoints.begin(), result.checkpoints.end(),
+			[&](const Checkpoint& checkpoint) { return checkpoint.frame == frame; });
+		if (!was_run)
+		{
+			report << std::format("  {} frame {}: a hash has been recorded, but the checkpoint was not reached\n", job.name, frame);
+			matched = false;
+		}
+	}
+	return matched;
+}
+
+
+std::optional<u8> RegressionSuite::ParseButtons(const std::string& buttons)
+{
+	static constexpr std::pair<const char*, Joypad::Button> button_names[] = {
+		{ "A", Joypad::Button::A }, { "B", Joypad::Button::B }, { "SELECT", Joypad::Button::SELECT }, { "START", Joypad::Button::START },
+		{ "UP", Joypad::Button::UP }, { "DOWN", Joypad::Button::DOWN }, { "LEFT", Joypad::Button::LEFT }, { "RIGHT", Joypad::Button::RIGHT }
+	};
+
+	if (buttons == "-")
+		return 0;
+
+	u8 result = 0;
+	std::istringstream iss{ buttons };
+	std::string name;
+	while (std::getline(iss, name, '+'))
+	{
+		auto it = std::find_if(std::begin(button_names), std::end(button_names), [&](const auto& button_name) { return name == button_name.first; });
+		if (it == std::end(button_names))
+			return std::nullopt;
+		result |= 1 << it->second;
+	}
+	return result;
+}
+
+
+std::optional<std::vector<RegressionSuite::Job>> RegressionSuite::ParseSuite(const std::string& suite_path, std::ostream& report)
+{
+	std::ifstream ifs{ suite_path };
+	if (!ifs)
+	{
+		report << std::format("Could not open the suite {}.\n", suite_path);
+		return std::nullopt;
+	}
+
+	const std::filesystem::path suite_dir = std::filesystem::path(suite_path).parent_path();
+	std::vector<Job> jobs;
+	std::string line;
+	unsigned line_num = 0;
+
+	auto Error = [&](const std::string& message) {
+		report << std::format("{}:{}: {}\n", suite_path, line_num, message);
+		return std::nullopt;
+	};
+
+	while (std::getline(ifs, line))
+	{
+		line_num++;
+		line = line.substr(0, line.find('#'));
+		std::istringstream iss{ line };
+		std::string keyword;
+		if (!(iss >> keyword))
+			continue;
+
+		if (keyword == "rom")
+		{
+			std::string rom_path;
+			std::getline(iss >> std::ws, rom_path);
+			rom_path.erase(rom_path.find_last_not_of(" \t\r") + 1);
+			if (rom_path.empty())
+				return Error("expected a rom path");
+			Job job;
+			job.name = rom_path;
+			job.rom_path = (suite_dir / rom_path).string();
+			jobs.push_back(std::move(job));
+			continue;
+		}
+
+		if (jobs.empty())
+			return Error(std::format("'{}' must come after a 'rom' line", keyword));
+		Job& job = jobs.back();
+
+		if (keyword == "name")
+		{
+			std::getline(iss >> std::ws, job.name);
+			job.name.erase(job.name.find_last_not_of(" \t\r") + 1);
+			if (job.name.empty())
+				return Error("expected a name");
+		}
+		else if (keyword == "frames")
+		{
+			if (!(iss >> job.num_frames) || job.num_frames == 0)
+				return Error("expected a number of frames");
+		}
+		else if (keyword == "checkpoint")
+		{
+			unsigned frame;
+			while (iss >> frame)
+				job.checkpoints.push_back(frame);
+			if (!iss.eof())
+				return Error("expected frame numbers");
+		}
+		else if (keyword == "every")
+		{
+			if (!(iss >> job.checkpoint_interval) || job.checkpoint_interval == 0)
+				return Error("expected a number of frames");
+		}
+		else if (keyword == "input")
+		{
+			unsigned frame, player;
+			std::string buttons;
+			if (!(iss >> frame >> player >> buttons) || player < 1 || player > 2)
+				return Error("expected 'input <frame> <player 1 or 2> <buttons>'");
+			const std::optional<u8> button_states = ParseButtons(buttons);
+			if (!button_states.has_value())
+				return Error(std::format("unknown buttons '{}'", buttons));
+			job.input_changes.push_back({ frame, Joypad::Player(player - 1), button_states.value() });
+		}
+		else if (keyword == "song")
+		{
+			unsigned song;
+			if (!(iss >> song) || song == 0)
+				return Error("expected a song number");
+			job.nsf_song = song;
+		}
+		else if (keyword == "audio")
+		{
+			job.hash_audio = true;
+		}
+		else if (keyword == "capture")
+		{
+			std::string capture_path;
+			std::getline(iss >> std::ws, capture_path);
+			capture_path.erase(capture_path.find_last_not_of(" \t\r") + 1);
+			if (capture_path.empty())
+				return Error("expected a video path");
+			if (!VideoCapture::GetFormatFromPath(capture_path).has_value())
+				return Error("the video path must end in .avi, .y4m or .png");
+			job.capture_path = (suite_dir / capture_path).string();
+		}
+		else if (keyword == "capture_audio")
+		{
+			std::string capture_path;
+			std::getline(iss >> std::ws, capture_path);
+			capture_path.erase(capture_path.find_last_not_of(" \t\r") + 1);
+			if (capture_path.empty())
+				return Error("expected an audio path");
+			if (!AudioCapture::GetFormatFromPath(capture_path).has_value())
+				return Error("the audio path must end in .wav, .raw or .pcm");
+			job.audio_capture_path = (suite_dir / capture_path).string();
+		}
+		else if (keyword == "capture_stems")
+		{
+			job.capture_stems = true;
+		}
+		else
+		{
+			return Error(std::format("unknown keyword '{}'", keyword));
+		}
+	}
+
+	for (Job& job : jobs)
+	{
+		if (job.checkpoints.empty() && job.checkpoint_interval == 0)
+			job.checkpoints.push_back(job.num_frames);
+		std::sort(job.checkpoints.begin(), job.checkpoints.end());
+		job.checkpoints.erase(std::unique(job.checkpoints.begin(), job.checkpoints.end()), job.checkpoints.end());
+		std::stable_sort(job.input_changes.begin(), job.input_changes.end(),
+			[](const InputChange& a, const InputChange& b) { return a.frame < b.frame; });
+	}
+	return jobs;
+}
+
+
+std::optional<RegressionSuite::Database> RegressionSuite::ReadDatabase(const std::string& database_path, std::ostream& report)
+{
+	std::ifstream ifs{ database_path };
+	if (!ifs)
+	{
+		report << std::format("Could not open the database {}; record it first.\n", database_path);
+		return std::nullopt;
+	}
+
+	Database database;
+	std::string line;
+	unsigned line_num = 0;
+	while (std::getline(ifs, line))
+	{
+		line_num++;
+		if (line.empty())
+			continue;
+		std::istringstream iss{ line };
+		Checkpoint checkpoint;
+		std::string audio_hash, name;
+		if (!(iss >> checkpoint.frame >> std::hex >> checkpoint.frame_hash >> audio_hash) || !std::getline(iss >> std::ws, name))
+		{
+			report << std::format("{}:{}: malformed line\n", database_path, line_num);
+			return std::nullopt;
+		}
+		name.erase(name.find_last_not_of(" \t\r") + 1);
+		if (audio_hash != "-")
+		{
+			u64 hash;
+			const char* end = audio_hash.data() + audio_hash.size();
+			auto [ptr, ec] = std::from_chars(audio_hash.data(), end, hash, 16);
+			if (ec != std::errc() || ptr != end)
+			{
+				report << std::format("{}:{}: malformed line\n", database_path, line_num);
+				return std::nullopt;
+			}
+			checkpoint.audio_hash = hash;
+		}
+		database[{ name, checkpoint.frame }] = checkpoint;
+	}
+	return database;
+}
+
+
+bool RegressionSuite::WriteDatabase(const std::string& database_path, const std::vector<Job>& jobs, const std::vector<JobResult>& results)
+{
+	std::ofstream ofs{ database_path };
+	if (!ofs)
+		return false;
+
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		/* Jobs that did not run to completion are left out, so that verifying them fails until they run again. */
+		if (!results[i].error.empty())
+			continue;
+		for (const Checkpoint& checkpoint : results[i].checkpoints)
+		{
+			ofs << std::format("{} {:016X} {} {}\n", checkpoint.frame, checkpoint.frame_hash,
+				checkpoint.audio_hash.has_value() ? std::format("{:016X}", checkpoint.audio_hash.value()) : "-", jobs[i].name);
+		}
+	}
+	return bool(ofs);
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <charconv>
+#include <chrono>
+#include <format>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../Hash.h"
+#include "../ThreadPool.h"
+#include "../Types.h"
+
+#include "../core/Emulator.h"
+#include "../core/Joypad.h"
+
+/* Runs a list of roms headless, with scripted input, for a fixed number of frames each, and hashes the frame
+   (and optionally all audio output up until then) at given checkpoints. The hashes are either recorded to a database,
+   or compared against the ones recorded earlier, so that changes to the emulation can be checked against many games at once.
+   Every rom runs on its own emulator instance, and the instances are spread over a thread pool.
+
+   A rom may also be an NSF tune (see NSFBus); a frame is then one period of its play timer, and the frame hashes are of a blank screen.
+   This makes the suite a way of rendering music to files faster than real time, or of checking the APU on its own.
+
+   A suite file holds one job per 'rom' line, followed by lines that apply to that job. '#' starts a comment.
+     rom <path>                     Starts a new job. Relative paths are relative to the suite file.
+     name <name>                    Identifies the job in the database (default: the rom path as written). Needed if several jobs run the same rom.
+     frames <n>                     The number of frames to run (default: 600).
+     checkpoint <frame> ...         Hash after this many frames. If no checkpoint is given, the last frame is hashed.
+     every <n>                      Hash after every n:th frame.
+     input <frame> <player> <buttons>
+                                    From the start of frame number <frame> (counting from 0), player 1 or 2 holds <buttons>:
+                                    '+'-separated names out of A, B, SELECT, START, UP, DOWN, LEFT, RIGHT, or '-' for none.
+     song <n>                       For an NSF tune, play song number <n> (counting from 1) rather than the tune's starting song.
+     audio                          Also hash the audio output.
+     capture <path>                 Also record the frames to a video file (see VideoCapture), in the format given by the extension
+                                    (.avi, .y4m or .png). Relative paths are relative to the suite file.
+     capture_audio <path>           Also record the audio output as 32-bit float samples (see AudioCapture), to a WAV file (.wav)
+                                    or a raw stream (.raw or .pcm). Relative paths are relative to the suite file.
+     capture_stems                  With 'capture_audio', also record each channel to a file of its own.
+
+   The database has one line per checkpoint: <frame> <frame hash> <audio hash, or '-'> <job name>. */
+class RegressionSuite
+{
+public:
+	enum class Mode { Record, Verify };
+
+	/* Returns the exit code of the run: 0 if every job ran (and, when verifying, matched the database), 1 if not,
+	   and 2 if the suite or the database could not be read. */
+	static int Run(const std::string& suite_path, const std::string& database_path, Mode mode,
+		unsigned num_threads = std::thread::hardware_concurrency(), std::ostream& report = std::cout);
+
+private:
+	static constexpr unsigned default_num_frames = 600;
+
+	struct InputChange
+	{
+		unsigned frame;
+		Joypad::Player player;
+		u8 buttons;
+	};
+
+	struct Job
+	{
+		std::string name;
+		std::string rom_path;
+		unsigned num_frames = default_num_frames;
+		unsigned checkpoint_interval = 0;
+		std::vector<unsigned> checkpoints;
+		std::vector<InputChange> input_changes;
+		std::optional<unsigned> nsf_song;
+		bool hash_audio = false;
+		std::string capture_path;
+		std::string audio_capture_path;
+		bool capture_stems = false;
+	};
+
+	struct Checkpoint
+	{
+		unsigned frame;
+		u64 frame_hash;
+		std::optional<u64> audio_hash;
+	};
+
+	struct JobResult
+	{
+		std::vector<Checkpoint> checkpoints;
+		std::string error; /* Empty if the job ran to completion. */
+	};
+
+	using Database = std::map<std::pair<std::string, unsigned>, Checkpoint>; /* Keyed by job name and frame. */
+
+	static std::optional<u8> ParseButtons(const std::string& buttons);
+	static std::optional<std::vector<Job>> ParseSuite(const std::string& suite_path, std::ostream& report);
+	static std::optional<Database> ReadDatabase(const std::string& database_path, std::ostream& report);
+	static JobResult RunJob(const Job& job);
+	static bool Verify(const Job& job, const JobResult& result, const Database& database, std::ostream& report);
+	static bool WriteDatabase(const std::string& database_path, const std::vector<Job>& jobs, const std::vector<JobResult>& results);
+};
@@ -15,7 +15,70 @@ App::~App()
 
 bool App::OnInit()
 {
+	if (!ParseCommandLine())
+		return false;
+	if (regression_run.has_value())
+		return true;
+
 	main_window = new MainWindow();
 	main_window->Show();
 	return true;
+}
+
+
+int App::OnRun()
+{
+	if (regression_run.has_value())
+	{
+		return RegressionSuite::Run(regression_run->suite_path, regression_run->database_path,
+			regression_run->mode, regression_run->num_threads);
+	}
+	return wxApp::OnRun();
+}
+
+
+/* Returns false if the command line is invalid. */
+bool App::ParseCommandLine()
+{
+	std::vector<std::string> args;
+	for (int i = 1; i < argc; i++)
+		args.push_back(argv[i].ToStdString());
+
+	if (args.empty())
+		return true;
+
+	if (args[0] != "--regression" || args.size() < 2)
+	{
+		std::cerr << "Usage: nes-dono [--regression <suite file> [--database <file>] [--record] [--threads <n>]]" << std::endl;
+		return false;
+	}
+
+	RegressionRun run;
+	run.suite_path = args[1];
+	run.database_path = run.suite_path + ".hashes";
+	for (size_t i = 2; i < args.size(); i++)
+	{
+		if (args[i] == "--record")
+			run.mode = RegressionSuite::Mode::Record;
+		else if (args[i] == "--database" && i + 1 < args.size())
+			run.database_path = args[++i];
+		else if (args[i] == "--threads" && i + 1 < args.size())
+		{
+			const std::string& num_threads = args[++i];
+			const char* end = num_threads.data() + num_threads.size();
+			auto [ptr, ec] = std::from_chars(num_threads.data(), end, run.num_threads);
+			if (ec != std::errc() || ptr != end || run.num_threads == 0)
+			{
+				std::cerr << std::format("Invalid number of threads '{}'", num_threads) << std::endl;
+				return false;
+			}
+		}
+		else
+		{
+			std::cerr << std::format("Unknown argument '{}'", args[i]) << std::endl;
+			return false;
+		}
+	}
+	regression_run = run;
+	return true;
 }
\ No newline at end of file
@@ -1,7 +1,13 @@
 #pragma once
 
+#include <charconv>
+#include <optional>
+#include <string>
+
 #include "wx/wx.h"
 
+#include "../debug/RegressionSuite.h"
+
 #include "MainWindow.h"
 
 class App : public wxApp
@@ -11,7 +17,21 @@ public:
 	~App();
 
 	bool OnInit() override;
+	int OnRun() override;
 
 private:
+	/* Set if the app was started with '--regression <suite file> [--database <file>] [--record] [--threads <n>]'.
+	   The suite is then run headless (see RegressionSuite), and the app exits without opening a window. */
+	struct RegressionRun
+	{
+		std::string suite_path;
+		std::string database_path;
+		RegressionSuite::Mode mode = RegressionSuite::Mode::Verify;
+		unsigned num_threads = std::thread::hardware_concurrency();
+	};
+	std::optional<RegressionRun> regression_run;
+
 	MainWindow* main_window = nullptr;
+
+	bool ParseCommandLine();
 };
\ No newline at end of file
@@ -0,0 +1,66 @@
+#include "GameListCtrl.h"
+
+#include <algorithm>
+
+
+GameListCtrl::GameListCtrl(wxWindow* parent, wxWindowID id, const wxPoint& pos, const wxSize& size, const RomLibrary& rom_library, const wxString& empty_text) :
+	wxListCtrl(parent, id, pos, size, wxLC_REPORT | wxLC_VIRTUAL | wxLC_SINGLE_SEL),
+	rom_library(rom_library),
+	empty_text(empty_text)
+{
+	InsertColumn(Column::name, "Name", wxLIST_FORMAT_LEFT, 250);
+	InsertColumn(Column::mapper, "Mapper", wxLIST_FORMAT_RIGHT, 60);
+	InsertColumn(Column::region, "Region", wxLIST_FORMAT_LEFT, 60);
+	InsertColumn(Column::prg_rom, "PRG", wxLIST_FORMAT_RIGHT, 60);
+	InsertColumn(Column::chr, "CHR", wxLIST_FORMAT_RIGHT, 60);
+	UpdateItemCount();
+}
+
+
+void GameListCtrl::UpdateItemCount()
+{
+	const size_t num_entries = rom_library.GetNumEntries();
+	SetItemCount(std::max(num_entries, size_t(1)));
+	Refresh();
+}
+
+
+wxString GameListCtrl::OnGetItemText(const long item, const long column) const
+{
+	const std::optional<RomLibrary::Entry> entry = rom_library.GetEntry(item);
+	if (!entry.has_value())
+		return column == Column::name && item == 0 && rom_library.GetNumEntries() == 0 ? empty_text : wxString();
+
+	if (column == Column::name)
+		return wxString(entry->title.empty() ? entry->file_name : entry->title + " (" + entry->file_name + ")");
+	if (!entry->indexed)
+		return column == Column::mapper ? wxString("...") : wxString();
+	if (!entry->is_rom)
+		return column == Column::mapper ? wxString("?") : wxString();
+
+	switch (column)
+	{
+	case Column::mapper:
+		return entry->is_nsf ? wxString("NSF") : wxString::Format("%u", unsigned(entry->mapper_num));
+
+	case Column::region:
+		switch (entry->video_standard)
+		{
+		case System::VideoStandard::NTSC: return "NTSC";
+		case System::VideoStandard::PAL: return "PAL";
+		case System::VideoStandard::Dendy: return "Dendy";
+		default: return wxString();
+		}
+
+	case Column::prg_rom:
+		return entry->is_nsf ? wxString() : wxString::Format("%u KiB", unsigned(entry->prg_rom_size / 0x400));
+
+	case Column::chr:
+		if (entry->is_nsf)
+			return wxString();
+		return entry->chr_size == 0 ? wxString("RAM") : wxString::Format("%u KiB", unsigned(entry->chr_size / 0x400));
+
+	default:
+		return wxString();
+	}
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <wx/wx.h>
+#include <wx/listctrl.h>
+
+#include "RomLibrary.h"
+
+/* The list of games in the game directory, as found by a RomLibrary. The list is virtual: rows are only asked for once they
+   are shown, so that a directory of any size is listed at once, and entries that are still being indexed show up as they are done.
+   If the directory has no games, a single row with 'empty_text' is shown instead. */
+class GameListCtrl : public wxListCtrl
+{
+public:
+	GameListCtrl(wxWindow* parent, wxWindowID id, const wxPoint& pos, const wxSize& size, const RomLibrary& rom_library, const wxString& empty_text);
+
+	/* To be called whenever the library has changed. */
+	void UpdateItemCount();
+
+private:
+	enum Column { name, mapper, region, prg_rom, chr, num_columns };
+
+	const RomLibrary& rom_library;
+	const wxString empty_text;
+
+	wxString OnGetItemText(long item, long column) const override;
+};
@@ -6,10 +6,15 @@ wxBEGIN_EVENT_TABLE(MainWindow, wxFrame)
 	EVT_MENU(MenuBarID::set_game_dir, MainWindow::OnMenuSetGameDir)
 	EVT_MENU(MenuBarID::save_state, MainWindow::OnMenuSaveState)
 	EVT_MENU(MenuBarID::load_state, MainWindow::OnMenuLoadState)
+	EVT_MENU(MenuBarID::video_capture, MainWindow::OnMenuVideoCapture)
+	EVT_MENU(MenuBarID::audio_capture, MainWindow::OnMenuAudioCapture)
 	EVT_MENU(MenuBarID::quit, MainWindow::OnMenuQuit)
 	EVT_MENU(MenuBarID::pause_play, MainWindow::OnMenuPausePlay)
 	EVT_MENU(MenuBarID::reset, MainWindow::OnMenuReset)
 	EVT_MENU(MenuBarID::stop, MainWindow::OnMenuStop)
+	EVT_MENU(MenuBarID::next_track, MainWindow::OnMenuTrack)
+	EVT_MENU(MenuBarID::previous_track, MainWindow::OnMenuTrack)
+	EVT_MENU(MenuBarID::ppu_viewer, MainWindow::OnMenuPPUViewer)
 	EVT_MENU(MenuBarID::size_1x, MainWindow::OnMenuSize)
 	EVT_MENU(MenuBarID::size_2x, MainWindow::OnMenuSize)
 	EVT_MENU(MenuBarID::size_3x, MainWindow::OnMenuSize)
@@ -24,12 +29,41 @@ wxBEGIN_EVENT_TABLE(MainWindow, wxFrame)
 	EVT_MENU(MenuBarID::size_fullscreen, MainWindow::OnMenuSize)
 	EVT_MENU(MenuBarID::speed_100, MainWindow::OnMenuSpeed)
 	EVT_MENU(MenuBarID::speed_uncapped, MainWindow::OnMenuSpeed)
+	EVT_MENU(MenuBarID::frame_skip_none, MainWindow::OnMenuFrameSkip)
+	EVT_MENU(MenuBarID::frame_skip_1, MainWindow::OnMenuFrameSkip)
+	EVT_MENU(MenuBarID::frame_skip_2, MainWindow::OnMenuFrameSkip)
+	EVT_MENU(MenuBarID::frame_skip_3, MainWindow::OnMenuFrameSkip)
+	EVT_MENU(MenuBarID::frame_skip_5, MainWindow::OnMenuFrameSkip)
+	EVT_MENU(MenuBarID::frame_skip_7, MainWindow::OnMenuFrameSkip)
+	EVT_MENU(MenuBarID::video_filter_none, MainWindow::OnMenuVideoFilter)
+	EVT_MENU(MenuBarID::video_filter_nearest, MainWindow::OnMenuVideoFilter)
+	EVT_MENU(MenuBarID::video_filter_scale2x, MainWindow::OnMenuVideoFilter)
+	EVT_MENU(MenuBarID::video_filter_scale3x, MainWindow::OnMenuVideoFilter)
+	EVT_MENU(MenuBarID::video_filter_hq2x, MainWindow::OnMenuVideoFilter)
+	EVT_MENU(MenuBarID::video_filter_hq3x, MainWindow::OnMenuVideoFilter)
+	EVT_MENU(MenuBarID::video_filter_xbr, MainWindow::OnMenuVideoFilter)
+	EVT_MENU(MenuBarID::video_filter_ntsc, MainWindow::OnMenuVideoFilter)
+	EVT_MENU(MenuBarID::audio_quality_low, MainWindow::OnMenuAudioQuality)
+	EVT_MENU(MenuBarID::audio_quality_medium, MainWindow::OnMenuAudioQuality)
+	EVT_MENU(MenuBarID::audio_quality_high, MainWindow::OnMenuAudioQuality)
+	EVT_MENU(MenuBarID::toggle_audio_thread, MainWindow::OnMenuToggleAudioThread)
+	EVT_MENU(MenuBarID::toggle_rewind, MainWindow::OnMenuToggleRewind)
+	EVT_MENU(MenuBarID::rewind_duration_30s, MainWindow::OnMenuRewindDuration)
+	EVT_MENU(MenuBarID::rewind_duration_1min, MainWindow::OnMenuRewindDuration)
+	EVT_MENU(MenuBarID::rewind_duration_2min, MainWindow::OnMenuRewindDuration)
+	EVT_MENU(MenuBarID::rewind_duration_5min, MainWindow::OnMenuRewindDuration)
+	EVT_MENU(MenuBarID::run_ahead_none, MainWindow::OnMenuRunAhead)
+	EVT_MENU(MenuBarID::run_ahead_1, MainWindow::OnMenuRunAhead)
+	EVT_MENU(MenuBarID::run_ahead_2, MainWindow::OnMenuRunAhead)
+	EVT_MENU(MenuBarID::run_ahead_3, MainWindow::OnMenuRunAhead)
+	EVT_MENU(MenuBarID::run_ahead_4, MainWindow::OnMenuRunAhead)
+	EVT_MENU(MenuBarID::toggle_run_ahead_second_instance, MainWindow::OnMenuToggleRunAheadSecondInstance)
 	EVT_MENU(MenuBarID::input, MainWindow::OnMenuInput)
 	EVT_MENU(MenuBarID::toggle_filter_nes_files, MainWindow::OnMenuToggleFilterFiles)
 	EVT_MENU(MenuBarID::reset_settings, MainWindow::OnMenuResetSettings)
 	EVT_MENU(MenuBarID::github_link, MainWindow::OnMenuGitHubLink)
 
-	EVT_LISTBOX_DCLICK(listBoxID, MainWindow::OnListBoxGameSelection)
+	EVT_LIST_ITEM_ACTIVATED(listBoxID, MainWindow::OnListBoxGameSelection)
 	EVT_SIZE(MainWindow::OnWindowSizeChanged)
 	EVT_KEY_DOWN(MainWindow::OnKeyDown)
 	EVT_CLOSE(MainWindow::OnClose)
@@ -38,6 +72,7 @@ wxEND_EVENT_TABLE()
 
 #define PRESPECIFIED_SPEED_NOT_FOUND -1
 #define PRESPECIFIED_SIZE_NOT_FOUND -1
+#define PRESPECIFIED_FRAME_SKIP_NOT_FOUND -1
 
 
 const wxString MainWindow::emulator_name("nes-dono");
@@ -70,7 +105,7 @@ void MainWindow::SetupInitialMenuView()
 	CreateMenuBar();
 	default_client_size = GetClientSize(); // what remains of the window outside of the menubar
 
-	game_list_box = new wxListBox(this, listBoxID, wxPoint(0, 0), default_client_size);
+	game_list_box = new GameListCtrl(this, listBoxID, wxPoint(0, 0), default_client_size, rom_library, empty_listbox_item);
 	SDL_window_panel = new wxPanel(this, SDLWindowID, wxPoint(0, 0), default_client_size);
 
 	game_list_box->Bind(wxEVT_KEY_DOWN, &MainWindow::OnKeyDown, this);
@@ -142,6 +177,10 @@ void MainWindow::LaunchGame()
 
 void MainWindow::QuitGame()
 {
+	if (emulator.IsCapturingVideo())
+		StopVideoCapture();
+	if (emulator.IsCapturingAudio())
+		StopAudioCapture();
 	emulator.Stop();
 	SwitchToMenuView();
 }
@@ -177,11 +216,19 @@ void MainWindow::CreateMenuBar()
 	menu_file->Append(MenuBarID::save_state, wxT("&Save state (F5)"));
 	menu_file->Append(MenuBarID::load_state, wxT("&Load state (F8)"));
 	menu_file->AppendSeparator();
+	menu_file->Append(MenuBarID::video_capture, wxT("Start &video capture"));
+	menu_file->Append(MenuBarID::audio_capture, wxT("Start &audio capture"));
+	menu_file->AppendSeparator();
 	menu_file->Append(MenuBarID::quit, wxT("&Quit"));
 
 	menu_emulation->Append(MenuBarID::pause_play, wxT("&Pause"));
 	menu_emulation->Append(MenuBarID::reset, wxT("&Reset"));
 	menu_emulation->Append(MenuBarID::stop, wxT("&Stop"));
+	menu_emulation->AppendSeparator();
+	menu_emulation->Append(MenuBarID::next_track, wxT("&Next track (NSF)"));
+	menu_emulation->Append(MenuBarID::previous_track, wxT("Pre&vious track (NSF)"));
+	menu_emulation->AppendSeparator();
+	menu_emulation->Append(MenuBarID::ppu_viewer, wxT("PPU &viewer"));
 
 	menu_size->AppendRadioItem(MenuBarID::size_1x, FormatSizeMenubarLabel(1));
 	menu_size->AppendRadioItem(MenuBarID::size_2x, FormatSizeMenubarLabel(2));
@@ -202,10 +249,51 @@ void MainWindow::CreateMenuBar()
 	menu_speed->AppendRadioItem(MenuBarID::speed_uncapped, wxT("&Uncapped (no audio)"));
 	menu_settings->AppendSubMenu(menu_speed, wxT("&Emulation speed"));
 
+	menu_frame_skip->AppendRadioItem(MenuBarID::frame_skip_none, wxT("&Off"));
+	menu_frame_skip->AppendRadioItem(MenuBarID::frame_skip_1, FormatFrameSkipMenubarLabel(1));
+	menu_frame_skip->AppendRadioItem(MenuBarID::frame_skip_2, FormatFrameSkipMenubarLabel(2));
+	menu_frame_skip->AppendRadioItem(MenuBarID::frame_skip_3, FormatFrameSkipMenubarLabel(3));
+	menu_frame_skip->AppendRadioItem(MenuBarID::frame_skip_5, FormatFrameSkipMenubarLabel(5));
+	menu_frame_skip->AppendRadioItem(MenuBarID::frame_skip_7, FormatFrameSkipMenubarLabel(7));
+	menu_settings->AppendSubMenu(menu_frame_skip, wxT("&Frame skip"));
+
+	menu_video_filter->AppendRadioItem(MenuBarID::video_filter_none, wxT("&None"));
+	menu_video_filter->AppendRadioItem(MenuBarID::video_filter_nearest, wxT("Nearest neighbour (&integer)"));
+	menu_video_filter->AppendRadioItem(MenuBarID::video_filter_scale2x, wxT("Scale&2x"));
+	menu_video_filter->AppendRadioItem(MenuBarID::video_filter_scale3x, wxT("Scale&3x"));
+	menu_video_filter->AppendRadioItem(MenuBarID::video_filter_hq2x, wxT("&hq2x (simplified)"));
+	menu_video_filter->AppendRadioItem(MenuBarID::video_filter_hq3x, wxT("h&q3x (simplified)"));
+	menu_video_filter->AppendRadioItem(MenuBarID::video_filter_xbr, wxT("2x&BR"));
+	menu_video_filter->AppendRadioItem(MenuBarID::video_filter_ntsc, wxT("&NTSC composite"));
+	menu_settings->AppendSubMenu(menu_video_filter, wxT("&Video filter"));
+
+	menu_audio_quality->AppendRadioItem(MenuBarID::audio_quality_low, wxT("&Low"));
+	menu_audio_quality->AppendRadioItem(MenuBarID::audio_quality_medium, wxT("&Medium"));
+	menu_audio_quality->AppendRadioItem(MenuBarID::audio_quality_high, wxT("&High"));
+	menu_settings->AppendSubMenu(menu_audio_quality, wxT("Audio &quality"));
+	menu_settings->AppendCheckItem(MenuBarID::toggle_audio_thread, wxT("Render audio on a separate &thread (from the next game started)"));
+
+	menu_rewind->AppendCheckItem(MenuBarID::toggle_rewind, wxT("&Enabled (hold R to rewind)"));
+	menu_rewind->AppendSeparator();
+	menu_rewind->AppendRadioItem(MenuBarID::rewind_duration_30s, wxT("&30 seconds"));
+	menu_rewind->AppendRadioItem(MenuBarID::rewind_duration_1min, wxT("&1 minute"));
+	menu_rewind->AppendRadioItem(MenuBarID::rewind_duration_2min, wxT("&2 minutes"));
+	menu_rewind->AppendRadioItem(MenuBarID::rewind_duration_5min, wxT("&5 minutes"));
+	menu_settings->AppendSubMenu(menu_rewind, wxT("Re&wind"));
+
+	menu_run_ahead->AppendRadioItem(MenuBarID::run_ahead_none, wxT("&Off"));
+	menu_run_ahead->AppendRadioItem(MenuBarID::run_ahead_1, wxT("&1 frame"));
+	menu_run_ahead->AppendRadioItem(MenuBarID::run_ahead_2, wxT("&2 frames"));
+	menu_run_ahead->AppendRadioItem(MenuBarID::run_ahead_3, wxT("&3 frames"));
+	menu_run_ahead->AppendRadioItem(MenuBarID::run_ahead_4, wxT("&4 frames"));
+	menu_run_ahead->AppendSeparator();
+	menu_run_ahead->AppendCheckItem(MenuBarID::toggle_run_ahead_second_instance, wxT("Run ahead on a &second core"));
+	menu_settings->AppendSubMenu(menu_run_ahead, wxT("Run-&ahead (hides input lag)"));
+
 	menu_settings->Append(MenuBarID::input, wxT("&Configure input bindings"));
 
 	menu_settings->AppendSeparator();
-	menu_settings->AppendCheckItem(MenuBarID::toggle_filter_nes_files, wxT("&Filter game list to .nes files only"));
+	menu_settings->AppendCheckItem(MenuBarID::toggle_filter_nes_files, wxT("&Filter game list to .nes, .nsf and .zip files only"));
 
 	menu_settings->AppendSeparator();
 	menu_settings->Append(MenuBarID::reset_settings, wxT("&Reset settings"));
@@ -217,26 +305,16 @@ void MainWindow::CreateMenuBar()
 
 
 // fill the game list with the games in specified rom directory
+// the directory is indexed in the background; the list is updated as entries come in
 void MainWindow::SetupGameList()
 {
-	rom_folder_name_arr.Clear();
-	rom_folder_path_arr.Clear();
-	game_list_box->Clear();
-
-	wxString filespec = wxEmptyString;
+	std::vector<std::string> extensions;
 	if (menu_settings->IsChecked(MenuBarID::toggle_filter_nes_files))
-		filespec = "*.nes";
-	size_t num_files = wxDir::GetAllFiles(rom_folder_path, &rom_folder_path_arr, filespec, wxDIR_FILES);
-
-	if (num_files == 0)
-	{
-		game_list_box->InsertItems(1, &empty_listbox_item, 0);
-		return;
-	}
-
-	for (size_t i = 0; i < num_files; i++)
-		rom_folder_name_arr.Add(wxFileName(rom_folder_path_arr[i]).GetFullName());
-	game_list_box->InsertItems(rom_folder_name_arr, 0);
+		extensions = { ".nes", ".nsf", ".zip" };
+	rom_library.Index(rom_folder_path.ToStdString(), extensions, [this] {
+		CallAfter([this] { game_list_box->UpdateItemCount(); });
+	});
+	game_list_box->UpdateItemCount();
 }
 
 
@@ -266,6 +344,33 @@ void MainWindow::ApplyGUISettings()
 	{
 		menu_speed->Check(MenuBarID::speed_uncapped, true);
 	}
+
+	unsigned frame_skip = emulator.GetFrameSkip();
+	menu_id = frame_skip == 0 ? MenuBarID::frame_skip_none : GetIdOfFrameSkipMenubarItem(frame_skip);
+	if (menu_id == wxNOT_FOUND)
+	{
+		/* Only the prespecified values can be chosen from the menu. */
+		emulator.SetFrameSkip(0);
+		menu_id = MenuBarID::frame_skip_none;
+	}
+	menu_frame_skip->Check(menu_id, true);
+
+	menu_video_filter->Check(GetIdOfVideoFilterMenubarItem(emulator.GetVideoFilter()), true);
+	menu_audio_quality->Check(GetIdOfAudioQualityMenubarItem(emulator.GetAudioQuality()), true);
+	menu_settings->Check(MenuBarID::toggle_audio_thread, emulator.AudioIsRenderedOnThread());
+
+	menu_rewind->Check(MenuBarID::toggle_rewind, emulator.RewindIsEnabled());
+	menu_id = GetIdOfRewindDurationMenubarItem(emulator.GetRewindDuration());
+	if (menu_id == wxNOT_FOUND)
+	{
+		/* Only the prespecified values can be chosen from the menu. */
+		emulator.SetRewindDuration(GetRewindDurationFromMenuBarID(MenuBarID::rewind_duration_2min));
+		menu_id = MenuBarID::rewind_duration_2min;
+	}
+	menu_rewind->Check(menu_id, true);
+
+	menu_run_ahead->Check(MenuBarID::run_ahead_none + emulator.GetRunAheadFrames(), true);
+	menu_run_ahead->Check(MenuBarID::toggle_run_ahead_second_instance, emulator.RunsAheadOnSecondInstance());
 }
 
 
@@ -295,7 +400,7 @@ void MainWindow::OnMenuOpen(wxCommandEvent& event)
 	// Creates an "open file" dialog
 	wxFileDialog* fileDialog = new wxFileDialog(
 		this, "Choose a file to open", wxEmptyString,
-		wxEmptyString, "NES files (*.nes)|*.nes|All files (*.*)|*.*",
+		wxEmptyString, "NES files (*.nes;*.nsf;*.zip)|*.nes;*.nsf;*.zip|All files (*.*)|*.*",
 		wxFD_OPEN | wxFD_FILE_MUST_EXIST, wxDefaultPosition);
 
 	int buttonPressed = fileDialog->ShowModal(); // show the dialog
@@ -355,6 +460,109 @@ void MainWindow::OnMenuLoadState(wxCommandEvent& event)
 }
 
 
+void MainWindow::OnMenuVideoCapture(wxCommandEvent& event)
+{
+	if (emulator.IsCapturingVideo())
+	{
+		StopVideoCapture();
+		return;
+	}
+	if (!emulator.emu_is_running)
+	{
+		UserMessage::Show("No game is loaded. Cannot capture video.", UserMessage::Type::Error);
+		return;
+	}
+
+	static constexpr VideoCapture::Format formats_by_filter_index[] = {
+		VideoCapture::Format::AVI, VideoCapture::Format::Y4M, VideoCapture::Format::PNGSequence
+	};
+	wxFileDialog* fileDialog = new wxFileDialog(
+		this, "Choose where to save the video", wxEmptyString, wxEmptyString,
+		"AVI, uncompressed (*.avi)|*.avi|YUV4MPEG2 (*.y4m)|*.y4m|PNG sequence (*.png)|*.png",
+		wxFD_SAVE | wxFD_OVERWRITE_PROMPT, wxDefaultPosition);
+
+	int buttonPressed = fileDialog->ShowModal();
+	const std::string path = std::string(fileDialog->GetPath().mb_str());
+	const int filter_index = fileDialog->GetFilterIndex();
+	fileDialog->Destroy();
+	if (buttonPressed != wxID_OK)
+		return;
+
+	// the format follows the file extension if it has one that is known, and the chosen file type otherwise
+	const VideoCapture::Format format = VideoCapture::GetFormatFromPath(path)
+		.value_or(formats_by_filter_index[std::clamp(filter_index, 0, 2)]);
+
+	// frames are dropped rather than waited for if the encoder falls behind, so that the game keeps running at full speed
+	if (emulator.StartVideoCapture(path, format, VideoCapture::OverflowPolicy::Drop))
+		menu_file->SetLabel(MenuBarID::video_capture, wxT("Stop &video capture"));
+	else
+		UserMessage::Show(std::format("Could not start capturing video to {}.", path), UserMessage::Type::Error);
+}
+
+
+void MainWindow::StopVideoCapture()
+{
+	menu_file->SetLabel(MenuBarID::video_capture, wxT("Start &video capture"));
+	const u64 num_dropped_frames = emulator.GetNumDroppedVideoCaptureFrames();
+	if (!emulator.StopVideoCapture())
+		UserMessage::Show("Could not write the whole video capture.", UserMessage::Type::Error);
+	else if (num_dropped_frames > 0)
+		UserMessage::Show(std::format("The video capture is complete. {} frames could not be encoded in time, and were replaced by the previous frame.",
+			num_dropped_frames), UserMessage::Type::Warning);
+}
+
+
+void MainWindow::OnMenuAudioCapture(wxCommandEvent& event)
+{
+	if (emulator.IsCapturingAudio())
+	{
+		StopAudioCapture();
+		return;
+	}
+	if (!emulator.emu_is_running)
+	{
+		UserMessage::Show("No game is loaded. Cannot capture audio.", UserMessage::Type::Error);
+		return;
+	}
+
+	static constexpr AudioCapture::Format formats_by_filter_index[] = {
+		AudioCapture::Format::WAV, AudioCapture::Format::WAV, AudioCapture::Format::Raw, AudioCapture::Format::Raw
+	};
+	static constexpr AudioCapture::SampleFormat sample_formats_by_filter_index[] = {
+		AudioCapture::SampleFormat::S16, AudioCapture::SampleFormat::F32, AudioCapture::SampleFormat::S16, AudioCapture::SampleFormat::F32
+	};
+	wxFileDialog* fileDialog = new wxFileDialog(
+		this, "Choose where to save the audio", wxEmptyString, wxEmptyString,
+		"WAV, 16-bit (*.wav)|*.wav|WAV, 32-bit float (*.wav)|*.wav|Raw PCM, 16-bit (*.raw)|*.raw|Raw PCM, 32-bit float (*.raw)|*.raw",
+		wxFD_SAVE | wxFD_OVERWRITE_PROMPT, wxDefaultPosition);
+
+	int buttonPressed = fileDialog->ShowModal();
+	const std::string path = std::string(fileDialog->GetPath().mb_str());
+	const int filter_index = std::clamp(fileDialog->GetFilterIndex(), 0, 3);
+	fileDialog->Destroy();
+	if (buttonPressed != wxID_OK)
+		return;
+
+	// the format follows the file extension if it has one that is known, and the chosen file type otherwise; the sample format always follows the file type
+	const AudioCapture::Format format = AudioCapture::GetFormatFromPath(path).value_or(formats_by_filter_index[filter_index]);
+	const bool record_stems = wxMessageBox("Also record each channel (pulse 1 and 2, triangle, noise, DMC) to a file of its own?",
+		"Audio capture", wxYES_NO | wxICON_QUESTION, this) == wxYES;
+
+	if (emulator.StartAudioCapture(path, format, sample_formats_by_filter_index[filter_index], record_stems))
+		menu_file->SetLabel(MenuBarID::audio_capture, wxT("Stop &audio capture"));
+	else
+		UserMessage::Show(std::format("Could not start capturing audio to {}.", path), UserMessage::Type::Error);
+}
+
+
+void MainWindow::StopAudioCapture()
+{
+	menu_file->SetLabel(MenuBarID::audio_capture, wxT("Start &audio capture"));
+	if (!emulator.StopAudioCapture())
+		UserMessage::Show("Could not write the whole audio capture.", UserMessage::Type::Error);
+}
+
+
 void MainWindow::OnMenuQuit(wxCommandEvent& event)
 {
 	Quit();
@@ -392,6 +600,27 @@ void MainWindow::OnMenuStop(wxCommandEvent& event)
 }
 
 
+void MainWindow::OnMenuTrack(wxCommandEvent& event)
+{
+	if (emulator.emu_is_running && emulator.IsPlayingNSF())
+	{
+		const unsigned num_songs = emulator.GetNumNSFSongs();
+		const unsigned step = event.GetId() == MenuBarID::next_track ? 1 : num_songs - 1;
+		menu_emulation->SetLabel(MenuBarID::pause_play, wxT("&Pause"));
+		emulator.SelectNSFSong((emulator.GetNSFSong() + step) % num_songs);
+	}
+}
+
+
+void MainWindow::OnMenuPPUViewer(wxCommandEvent& event)
+{
+	if (!ppu_viewer_window_active)
+		ppu_viewer_window = new PPUViewerWindow(this, emulator.GetPPUSnapshotChannel(), emulator.GetRGBPalette(), &ppu_viewer_window_active);
+	ppu_viewer_window->Show();
+	ppu_viewer_window->Raise();
+}
+
+
 void MainWindow::OnMenuSize(wxCommandEvent& event)
 {
 	int id = event.GetId();
@@ -470,6 +699,66 @@ void MainWindow::OnMenuSpeed(wxCommandEvent& event)
 }
 
 
+void MainWindow::OnMenuFrameSkip(wxCommandEvent& event)
+{
+	int frames = GetFrameSkipFromMenuBarID(event.GetId());
+	if (frames == PRESPECIFIED_FRAME_SKIP_NOT_FOUND)
+		return;
+
+	emulator.SetFrameSkip(frames);
+	config.Save();
+}
+
+
+void MainWindow::OnMenuVideoFilter(wxCommandEvent& event)
+{
+	emulator.SetVideoFilter(GetVideoFilterFromMenuBarID(event.GetId()));
+	config.Save();
+}
+
+
+void MainWindow::OnMenuAudioQuality(wxCommandEvent& event)
+{
+	emulator.SetAudioQuality(GetAudioQualityFromMenuBarID(event.GetId()));
+	config.Save();
+}
+
+
+void MainWindow::OnMenuToggleAudioThread(wxCommandEvent& event)
+{
+	emulator.SetAudioRenderedOnThread(menu_settings->IsChecked(MenuBarID::toggle_audio_thread));
+	config.Save();
+}
+
+
+void MainWindow::OnMenuToggleRewind(wxCommandEvent& event)
+{
+	emulator.SetRewindEnabled(menu_rewind->IsChecked(MenuBarID::toggle_rewind));
+	config.Save();
+}
+
+
+void MainWindow::OnMenuRewindDuration(wxCommandEvent& event)
+{
+	emulator.SetRewindDuration(GetRewindDurationFromMenuBarID(event.GetId()));
+	config.Save();
+}
+
+
+void MainWindow::OnMenuRunAhead(wxCommandEvent& event)
+{
+	emulator.SetRunAheadFrames(event.GetId() - MenuBarID::run_ahead_none);
+	config.Save();
+}
+
+
+void MainWindow::OnMenuToggleRunAheadSecondInstance(wxCommandEvent& event)
+{
+	emulator.SetRunAheadOnSecondInstance(menu_run_ahead->IsChecked(MenuBarID::toggle_run_ahead_second_instance));
+	config.Save();
+}
+
+
 void MainWindow::OnMenuInput(wxCommandEvent& event)
 {
 	/* Currently disabled */
@@ -502,32 +791,28 @@ void MainWindow::OnMenuGitHubLink(wxCommandEvent& event)
 }
 
 
-void MainWindow::OnListBoxGameSelection(wxCommandEvent& event)
+void MainWindow::OnListBoxGameSelection(wxListEvent& event)
 {
-	LocateAndOpenRomFromListBoxSelection(event.GetString());
+	OpenRomFromListBoxSelection(event.GetIndex());
 }
 
 
-void MainWindow::LocateAndOpenRomFromListBoxSelection(wxString selection)
+void MainWindow::OpenRomFromListBoxSelection(long selection)
 {
-	if (rom_folder_path_arr.GetCount() == 0) // when the only item in the listbox is the 'empty_listbox_item'
+	if (rom_library.GetNumEntries() == 0) // when the only item in the listbox is the 'empty_listbox_item'
 	{
 		ChooseGameDirDialog();
 		return;
 	}
 
-	// from the selection (rom name; name.ext), get the full path of the file from array `romFolderGamePaths'
-	for (const wxString& rom_path : rom_folder_path_arr)
+	std::string rom_path = rom_library.GetPath(selection);
+	if (rom_path.empty())
 	{
-		if (wxFileNameFromPath(rom_path).IsSameAs(selection))
-		{
-			active_rom_path = rom_path;
-			LaunchGame();
-			return;
-		}
+		UserMessage::Show("Error opening game; could not locate the file.", UserMessage::Type::Error);
+		return;
 	}
-
-	UserMessage::Show(wxString::Format("Error opening game; could not locate file \"%s\".", selection), UserMessage::Type::Error);
+	active_rom_path = wxString(rom_path);
+	LaunchGame();
 }
 
 
@@ -539,6 +824,11 @@ void MainWindow::OnWindowSizeChanged(wxSizeEvent& event)
 
 void MainWindow::OnClose(wxCloseEvent& event)
 {
+	/* The viewer's thread reads from the emulator, so it is stopped while the emulator is still there;
+	   wx would only delete the window once this one, and with it the emulator, is gone. */
+	if (ppu_viewer_window_active)
+		ppu_viewer_window->Close(true);
+	rom_library.Stop();
 	QuitGame();
 	SDL_Quit();
 	Destroy();
@@ -552,32 +842,8 @@ void MainWindow::OnKeyDown(wxKeyEvent& event)
 	// key presses are handled differently depending on if we are in the game list box selection view or playing a game
 	if (game_list_box->HasFocus())
 	{
-		switch (keycode)
-		{
-		case WXK_RETURN:
-		{
-			wxString selection = game_list_box->GetStringSelection();
-			if (selection != wxEmptyString)
-				LocateAndOpenRomFromListBoxSelection(selection);
-			break;
-		}
-
-		case WXK_DOWN:
-		{
-			int selection = game_list_box->GetSelection();
-			game_list_box->SetSelection(std::min(selection + 1, (int)game_list_box->GetCount()));
-			break;
-		}
-
-		case WXK_UP:
-		{
-			int selection = game_list_box->GetSelection();
-			game_list_box->SetSelection(std::max(selection - 1, 0));
-			break;
-		}
-
-		default: break;
-		}
+		// the list control moves the selection itself, and reports enter and double clicks through OnListBoxGameSelection
+		event.Skip();
 	}
 
 	else if (emulator.emu_is_running)
@@ -654,6 +920,14 @@ int MainWindow::GetIdOfSizeMenubarItem(int scale) const
 }
 
 
+int MainWindow::GetIdOfFrameSkipMenubarItem(int frames) const
+{
+	wxString item_string = FormatFrameSkipMenubarLabel(frames);
+	int menu_id = menu_frame_skip->FindItem(item_string);
+	return menu_id;
+}
+
+
 int MainWindow::GetIdOfSpeedMenubarItem(int speed) const
 {
 	wxString item_string = FormatSpeedMenubarLabel(speed);
@@ -662,6 +936,53 @@ int MainWindow::GetIdOfSpeedMenubarItem(int speed) const
 }
 
 
+int MainWindow::GetIdOfVideoFilterMenubarItem(VideoOutput::Filter filter) const
+{
+	switch (filter)
+	{
+	case VideoOutput::Filter::Nearest: return MenuBarID::video_filter_nearest;
+	case VideoOutput::Filter::Scale2x: return MenuBarID::video_filter_scale2x;
+	case VideoOutput::Filter::Scale3x: return MenuBarID::video_filter_scale3x;
+	case VideoOutput::Filter::HQ2x: return MenuBarID::video_filter_hq2x;
+	case VideoOutput::Filter::HQ3x: return MenuBarID::video_filter_hq3x;
+	case VideoOutput::Filter::XBR: return MenuBarID::video_filter_xbr;
+	case VideoOutput::Filter::NTSC: return MenuBarID::video_filter_ntsc;
+	default: return MenuBarID::video_filter_none;
+	}
+}
+
+
+int MainWindow::GetIdOfAudioQualityMenubarItem(Resampler::Quality quality) const
+{
+	switch (quality)
+	{
+	case Resampler::Quality::Low: return MenuBarID::audio_quality_low;
+	case Resampler::Quality::Medium: return MenuBarID::audio_quality_medium;
+	default: return MenuBarID::audio_quality_high;
+	}
+}
+
+
+int MainWindow::GetIdOfRewindDurationMenubarItem(unsigned seconds) const
+{
+	switch (seconds)
+	{
+	case 30: return MenuBarID::rewind_duration_30s;
+	case 60: return MenuBarID::rewind_duration_1min;
+	case 120: return MenuBarID::rewind_duration_2min;
+	case 300: return MenuBarID::rewind_duration_5min;
+	default: return wxNOT_FOUND;
+	}
+}
+
+
+wxString MainWindow::FormatFrameSkipMenubarLabel(int frames) const
+{
+	// format is 'Show 1 of 4 frames'
+	return wxString::Format("Show 1 of %i frames", frames + 1);
+}
+
+
 wxString MainWindow::FormatSizeMenubarLabel(int scale) const
 {
 	// format is '256x240 (1x)'
@@ -709,6 +1030,60 @@ int MainWindow::GetSizeFromMenuBarID(int id) const
 }
 
 
+int MainWindow::GetFrameSkipFromMenuBarID(int id) const
+{
+	switch (id)
+	{
+	case MenuBarID::frame_skip_none: return 0;
+	case MenuBarID::frame_skip_1: return 1;
+	case MenuBarID::frame_skip_2: return 2;
+	case MenuBarID::frame_skip_3: return 3;
+	case MenuBarID::frame_skip_5: return 5;
+	case MenuBarID::frame_skip_7: return 7;
+	default: return PRESPECIFIED_FRAME_SKIP_NOT_FOUND;
+	}
+}
+
+
+VideoOutput::Filter MainWindow::GetVideoFilterFromMenuBarID(int id) const
+{
+	switch (id)
+	{
+	case MenuBarID::video_filter_nearest: return VideoOutput::Filter::Nearest;
+	case MenuBarID::video_filter_scale2x: return VideoOutput::Filter::Scale2x;
+	case MenuBarID::video_filter_scale3x: return VideoOutput::Filter::Scale3x;
+	case MenuBarID::video_filter_hq2x: return VideoOutput::Filter::HQ2x;
+	case MenuBarID::video_filter_hq3x: return VideoOutput::Filter::HQ3x;
+	case MenuBarID::video_filter_xbr: return VideoOutput::Filter::XBR;
+	case MenuBarID::video_filter_ntsc: return VideoOutput::Filter::NTSC;
+	default: return VideoOutput::Filter::None;
+	}
+}
+
+
+Resampler::Quality MainWindow::GetAudioQualityFromMenuBarID(int id) const
+{
+	switch (id)
+	{
+	case MenuBarID::audio_quality_low: return Resampler::Quality::Low;
+	case MenuBarID::audio_quality_medium: return Resampler::Quality::Medium;
+	default: return Resampler::Quality::High;
+	}
+}
+
+
+unsigned MainWindow::GetRewindDurationFromMenuBarID(int id) const
+{
+	switch (id)
+	{
+	case MenuBarID::rewind_duration_30s: return 30;
+	case MenuBarID::rewind_duration_1min: return 60;
+	case MenuBarID::rewind_duration_5min: return 300;
+	default: return 120;
+	}
+}
+
+
 int MainWindow::GetSpeedFromMenuBarID(int id) const
 {
 	switch (id)
@@ -9,6 +9,7 @@
 #include "wx/wx.h"
 #include "SDL.h"
 
+#include <algorithm>
 #include <thread>
 
 #include "../Config.h"
@@ -16,7 +17,10 @@
 #include "../Observer.h"
 
 #include "AppUtils.h"
+#include "GameListCtrl.h"
 #include "InputBindingsWindow.h"
+#include "PPUViewerWindow.h"
+#include "RomLibrary.h"
 #include "UserMessage.h"
 
 class MainWindow : public wxFrame, public Configurable, public Observer
@@ -33,10 +37,15 @@ private:
 		set_game_dir,
 		save_state,
 		load_state,
+		video_capture,
+		audio_capture,
 		quit,
 		pause_play,
 		reset,
 		stop,
+		next_track,
+		previous_track,
+		ppu_viewer,
 		size_1x,
 		size_2x,
 		size_3x,
@@ -51,6 +60,35 @@ private:
 		size_fullscreen,
 		speed_100,
 		speed_uncapped,
+		frame_skip_none,
+		frame_skip_1,
+		frame_skip_2,
+		frame_skip_3,
+		frame_skip_5,
+		frame_skip_7,
+		video_filter_none,
+		video_filter_nearest,
+		video_filter_scale2x,
+		video_filter_scale3x,
+		video_filter_hq2x,
+		video_filter_hq3x,
+		video_filter_xbr,
+		video_filter_ntsc,
+		audio_quality_low,
+		audio_quality_medium,
+		audio_quality_high,
+		toggle_audio_thread,
+		toggle_rewind,
+		rewind_duration_30s,
+		rewind_duration_1min,
+		rewind_duration_2min,
+		rewind_duration_5min,
+		run_ahead_none, /* Followed by the items for 1 to 4 frames, in order */
+		run_ahead_1,
+		run_ahead_2,
+		run_ahead_3,
+		run_ahead_4,
+		toggle_run_ahead_second_instance,
 		sound_off,
 		input,
 		toggle_filter_nes_files,
@@ -78,8 +116,12 @@ private:
 	const int size_id_max = MenuBarID::size_15x;
 	const int speed_id_min = MenuBarID::speed_100;
 	const int speed_id_max = MenuBarID::speed_100;
+	int GetFrameSkipFromMenuBarID(int id) const;
 	int GetSizeFromMenuBarID(int id) const;
 	int GetSpeedFromMenuBarID(int id) const;
+	VideoOutput::Filter GetVideoFilterFromMenuBarID(int id) const;
+	Resampler::Quality GetAudioQualityFromMenuBarID(int id) const;
+	unsigned GetRewindDurationFromMenuBarID(int id) const;
 
 	const wxString empty_listbox_item = wxString("Double click this text to choose a game directory");
 	const wxSize default_window_size = wxSize(500, 500);
@@ -89,8 +131,7 @@ private:
 	bool game_view_active = false;
 	wxString active_rom_path; // path to currently or last played rom file
 	wxString rom_folder_path; // selected rom directory
-	wxArrayString rom_folder_name_arr; // array of names of all roms displayed in the list of games
-	wxArrayString rom_folder_path_arr; // array of paths of all roms displayed
+	RomLibrary rom_library{ AppUtils::GetExecutablePath() }; // the roms in the selected directory; its cache files are kept next to the executable
 
 	Config config;
 	Emulator emulator;
@@ -110,14 +151,22 @@ private:
 	wxMenu* menu_info = new wxMenu();
 	wxMenu* menu_size = new wxMenu();
 	wxMenu* menu_speed = new wxMenu();
+	wxMenu* menu_frame_skip = new wxMenu();
+	wxMenu* menu_video_filter = new wxMenu();
+	wxMenu* menu_audio_quality = new wxMenu();
 	wxMenu* menu_input = new wxMenu();
+	wxMenu* menu_rewind = new wxMenu();
+	wxMenu* menu_run_ahead = new wxMenu();
 
-	wxListBox* game_list_box = nullptr; // list of selectable roms in current directory 
+	GameListCtrl* game_list_box = nullptr; // list of selectable roms in current directory
 	wxPanel* SDL_window_panel = nullptr; // "holds" the SDL window
 
 	InputBindingsWindow* input_bindings_window = nullptr;
 	bool input_window_active = false;
 
+	PPUViewerWindow* ppu_viewer_window = nullptr;
+	bool ppu_viewer_window_active = false;
+
 	bool full_screen_active = false;
 
 	void StreamConfig(SerializationStream& stream);
@@ -127,20 +176,27 @@ private:
 	void ApplyGUISettings();
 	void ChooseGameDirDialog();
 	void CreateMenuBar();
+	wxString FormatFrameSkipMenubarLabel(int frames) const;
 	wxString FormatSizeMenubarLabel(int scale) const;
 	wxString FormatSpeedMenubarLabel(int speed) const;
 	wxString FormatCustomSizeMenubarLabel(int scale) const;
 	wxString FormatCustomSpeedMenubarLabel(int speed) const;
+	int GetIdOfFrameSkipMenubarItem(int frames) const;
 	int GetIdOfSizeMenubarItem(int scale) const;
 	int GetIdOfSpeedMenubarItem(int speed) const;
+	int GetIdOfVideoFilterMenubarItem(VideoOutput::Filter filter) const;
+	int GetIdOfAudioQualityMenubarItem(Resampler::Quality quality) const;
+	int GetIdOfRewindDurationMenubarItem(unsigned seconds) const;
 	void LaunchGame();
-	void LocateAndOpenRomFromListBoxSelection(wxString selection);
+	void OpenRomFromListBoxSelection(long selection);
 	void Quit();
 	void QuitGame();
 	void SetupConfig();
 	void SetupGameList();
 	void SetupInitialMenuView();
 	bool SetupSDL();
+	void StopAudioCapture();
+	void StopVideoCapture();
 	void SwitchToMenuView();
 	void SwitchToGameView();
 	void ToggleFullScreen();
@@ -152,17 +208,29 @@ private:
 	void OnMenuSetGameDir(wxCommandEvent& event);
 	void OnMenuSaveState(wxCommandEvent& event);
 	void OnMenuLoadState(wxCommandEvent& event);
+	void OnMenuVideoCapture(wxCommandEvent& event);
+	void OnMenuAudioCapture(wxCommandEvent& event);
 	void OnMenuQuit(wxCommandEvent& event);
 	void OnMenuPausePlay(wxCommandEvent& event);
 	void OnMenuReset(wxCommandEvent& event);
 	void OnMenuStop(wxCommandEvent& event);
+	void OnMenuTrack(wxCommandEvent& event);
+	void OnMenuPPUViewer(wxCommandEvent& event);
 	void OnMenuSize(wxCommandEvent& event);
 	void OnMenuSpeed(wxCommandEvent& event);
+	void OnMenuFrameSkip(wxCommandEvent& event);
+	void OnMenuVideoFilter(wxCommandEvent& event);
+	void OnMenuAudioQuality(wxCommandEvent& event);
+	void OnMenuToggleAudioThread(wxCommandEvent& event);
+	void OnMenuToggleRewind(wxCommandEvent& event);
+	void OnMenuRewindDuration(wxCommandEvent& event);
+	void OnMenuRunAhead(wxCommandEvent& event);
+	void OnMenuToggleRunAheadSecondInstance(wxCommandEvent& event);
 	void OnMenuInput(wxCommandEvent& event);
 	void OnMenuToggleFilterFiles(wxCommandEvent& event);
 	void OnMenuResetSettings(wxCommandEvent& event);
 	void OnMenuGitHubLink(wxCommandEvent& event);
-	void OnListBoxGameSelection(wxCommandEvent& event);
+	void OnListBoxGameSelection(wxListEvent& event);
 	void OnWindowSizeChanged(wxSizeEvent& event);
 	void OnClose(wxCloseEvent& event);
 	void OnKeyDown(wxKeyEvent& event);
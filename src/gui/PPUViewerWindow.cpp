@@ -0,0 +1,106 @@
+#include "PPUViewerWindow.h"
+
+
+wxBEGIN_EVENT_TABLE(PPUViewerWindow, wxFrame)
+	EVT_CHOICE(ControlID::palette_choice, PPUViewerWindow::OnPaletteChoice)
+	EVT_TIMER(ControlID::refresh_timer, PPUViewerWindow::OnTimer)
+	EVT_CLOSE(PPUViewerWindow::OnCloseWindow)
+wxEND_EVENT_TABLE()
+
+
+PPUViewerWindow::PPUViewerWindow(wxWindow* parent, PPUSnapshotChannel& snapshot_channel, const std::array<u32, 512>& rgb_palette, bool* window_active) :
+	wxFrame(parent, wxID_ANY, "PPU viewer", wxDefaultPosition, wxDefaultSize, wxDEFAULT_FRAME_STYLE & ~(wxRESIZE_BORDER | wxMAXIMIZE_BOX)),
+	viewer(snapshot_channel, rgb_palette),
+	timer(this, ControlID::refresh_timer)
+{
+	this->window_active = window_active;
+
+	// controls on top, and the images below them: the nametables on the left, and the pattern tables, palettes and sprites on the right
+	const wxSize label_size = wxSize(130, 25);
+	const wxSize choice_size = wxSize(150, 25);
+	const int controls_height = choice_size.y + padding;
+	const int right_column_x = 512 + padding;
+	const wxSize image_panel_size = wxSize(right_column_x + 256 * scale, std::max(480, (128 + 32 + 8 * 18) * scale + 2 * padding));
+
+	new wxStaticText(this, wxID_ANY, "Pattern table palette", wxPoint(padding, padding + 4), label_size);
+	const wxString palette_names[] = { "Background 0", "Background 1", "Background 2", "Background 3",
+		"Sprite 0", "Sprite 1", "Sprite 2", "Sprite 3" };
+	choice_palette = new wxChoice(this, ControlID::palette_choice, wxPoint(padding + label_size.x, padding), choice_size, 8, palette_names);
+	choice_palette->SetSelection(0);
+	static_text_frame = new wxStaticText(this, wxID_ANY, "Waiting for a frame", wxPoint(2 * padding + label_size.x + choice_size.x, padding + 4), label_size);
+
+	image_panel = new wxPanel(this, wxID_ANY, wxPoint(padding, padding + controls_height), image_panel_size);
+	image_panel->SetBackgroundStyle(wxBG_STYLE_PAINT);
+	image_panel->Bind(wxEVT_PAINT, &PPUViewerWindow::OnPaint, this);
+
+	SetClientSize(image_panel_size.x + 2 * padding, image_panel_size.y + controls_height + 2 * padding);
+
+	viewer.Start();
+	timer.Start(1000 / PPUViewer::default_refresh_rate);
+
+	*window_active = true;
+}
+
+
+wxBitmap PPUViewerWindow::ToBitmap(const PPUViewer::Image& image, int scale)
+{
+	wxImage wx_image(image.width, image.height, false);
+	unsigned char* rgb = wx_image.GetData();
+	for (u32 pixel : image.pixels)
+	{
+		*rgb++ = u8(pixel >> 16);
+		*rgb++ = u8(pixel >> 8);
+		*rgb++ = u8(pixel);
+	}
+	if (scale > 1)
+		wx_image.Rescale(image.width * scale, image.height * scale, wxIMAGE_QUALITY_NEAREST);
+	return wxBitmap(wx_image);
+}
+
+
+void PPUViewerWindow::OnCloseWindow(wxCloseEvent& event)
+{
+	timer.Stop();
+	viewer.Stop();
+	*window_active = false;
+	Destroy();
+}
+
+
+void PPUViewerWindow::OnPaint(wxPaintEvent& event)
+{
+	wxAutoBufferedPaintDC dc(image_panel);
+	dc.SetBackground(*wxBLACK_BRUSH);
+	dc.Clear();
+
+	const int right_column_x = 512 + padding;
+	if (nametables_bitmap.IsOk())
+		dc.DrawBitmap(nametables_bitmap, 0, 0);
+	if (pattern_tables_bitmap.IsOk())
+		dc.DrawBitmap(pattern_tables_bitmap, right_column_x, 0);
+	if (palettes_bitmap.IsOk())
+		dc.DrawBitmap(palettes_bitmap, right_column_x, 128 * scale + padding);
+	if (sprites_bitmap.IsOk())
+		dc.DrawBitmap(sprites_bitmap, right_column_x, (128 + 32) * scale + 2 * padding);
+}
+
+
+void PPUViewerWindow::OnPaletteChoice(wxCommandEvent& event)
+{
+	viewer.SetPatternTablePalette(choice_palette->GetSelection());
+}
+
+
+void PPUViewerWindow::OnTimer(wxTimerEvent& event)
+{
+	std::optional<PPUViewer::Images> images = viewer.TakeImages();
+	if (!images.has_value())
+		return;
+
+	nametables_bitmap = ToBitmap(images->nametables, 1);
+	pattern_tables_bitmap = ToBitmap(images->pattern_tables, scale);
+	palettes_bitmap = ToBitmap(images->palettes, scale);
+	sprites_bitmap = ToBitmap(images->sprites, scale);
+	static_text_frame->SetLabel(wxString::Format("Frame %llu", (unsigned long long)images->frame));
+	image_panel->Refresh(false);
+}
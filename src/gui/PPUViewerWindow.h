@@ -0,0 +1,56 @@
+#pragma once
+
+#include <wx/wx.h>
+#include <wx/choice.h>
+#include <wx/dcbuffer.h>
+#include <wx/timer.h>
+
+#include <array>
+
+#include "../Types.h"
+
+#include "../debug/PPUSnapshot.h"
+#include "../debug/PPUViewer.h"
+
+/* Shows the images drawn by a PPUViewer. The viewer thread runs only while this window is open,
+   and the window picks up new images at the same rate as the viewer draws them. */
+class PPUViewerWindow : public wxFrame
+{
+public:
+	PPUViewerWindow(wxWindow* parent, PPUSnapshotChannel& snapshot_channel, const std::array<u32, 512>& rgb_palette, bool* window_active);
+	// note: no destructor where all heap-allocated objects are deleted is needed. These are automatically destroyed when the window is destroyed
+
+private:
+	enum ControlID
+	{
+		palette_choice = 21000,
+		refresh_timer
+	};
+
+	const int padding = 10; // space (pixels) between the images
+	const int scale = 2; // all images except for the nametables are drawn this many times larger
+
+	bool* window_active = nullptr;
+
+	PPUViewer viewer;
+
+	wxBitmap nametables_bitmap;
+	wxBitmap pattern_tables_bitmap;
+	wxBitmap sprites_bitmap;
+	wxBitmap palettes_bitmap;
+
+	wxChoice* choice_palette = nullptr;
+	wxPanel* image_panel = nullptr;
+	wxStaticText* static_text_frame = nullptr;
+	wxTimer timer;
+
+	static wxBitmap ToBitmap(const PPUViewer::Image& image, int scale);
+
+	// event methods
+	void OnCloseWindow(wxCloseEvent& event);
+	void OnPaint(wxPaintEvent& event);
+	void OnPaletteChoice(wxCommandEvent& event);
+	void OnTimer(wxTimerEvent& event);
+
+	wxDECLARE_EVENT_TABLE();
+};
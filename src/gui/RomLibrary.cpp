@@ -0,0 +1,259 @@
+#include "RomLibrary.h"
+
+#include <algorithm>
+#include <cctype>
+#include <format>
+#include <fstream>
+
+#include "../core/Cartridge.h"
+#include "../core/RomImage.h"
+
+
+void RomLibrary::Index(const std::string& directory, std::vector<std::string> extensions, std::function<void()> on_change)
+{
+	Stop();
+	{
+		std::scoped_lock lock{ entries_mutex };
+		this->directory = directory;
+		entries.clear();
+	}
+	stop_requested = false;
+	indexing = true;
+	indexing_thread = std::thread([this, extensions = std::move(extensions), on_change = std::move(on_change)] {
+		IndexingLoop(extensions, on_change);
+	});
+}
+
+
+void RomLibrary::Stop()
+{
+	stop_requested = true;
+	if (indexing_thread.joinable())
+		indexing_thread.join();
+	indexing = false;
+}
+
+
+size_t RomLibrary::GetNumEntries() const
+{
+	std::scoped_lock lock{ entries_mutex };
+	return entries.size();
+}
+
+
+std::optional<RomLibrary::Entry> RomLibrary::GetEntry(const size_t index) const
+{
+	std::scoped_lock lock{ entries_mutex };
+	if (index >= entries.size())
+		return std::nullopt;
+	return entries[index];
+}
+
+
+std::string RomLibrary::GetPath(const size_t index) const
+{
+	std::scoped_lock lock{ entries_mutex };
+	if (index >= entries.size())
+		return {};
+	return (directory / entries[index].file_name).string();
+}
+
+
+void RomLibrary::IndexingLoop(const std::vector<std::string> extensions, const std::function<void()> on_change)
+{
+	auto CompareNames = [](const Entry& lhs, const Entry& rhs) { return lhs.file_name < rhs.file_name; };
+	auto Publish = [&](const std::vector<Entry>& new_entries) {
+		{
+			std::scoped_lock lock{ entries_mutex };
+			entries = new_entries;
+		}
+		on_change();
+	};
+
+	/* First, the entries known from the last time, so that the list is there at once. */
+	std::vector<Entry> cached_entries = LoadCache();
+	std::erase_if(cached_entries, [&](const Entry& entry) { return !HasExtension(entry.file_name, extensions); });
+	Publish(cached_entries);
+
+	/* Then, the directory as it is now. The entries of files that are new, or have changed since, are left to be indexed. */
+	std::vector<Entry> listed_entries;
+	std::error_code ec;
+	for (auto it = std::filesystem::directory_iterator(directory, ec); !ec && it != std::filesystem::directory_iterator(); it.increment(ec))
+	{
+		if (stop_requested)
+			break;
+		try {
+			if (!it->is_regular_file(ec) || !HasExtension(it->path(), extensions))
+				continue;
+			Entry entry;
+			entry.file_name = it->path().filename().string();
+			entry.file_size = it->file_size(ec);
+			entry.modification_time = it->last_write_time(ec).time_since_epoch().count();
+			auto cached_entry = std::lower_bound(cached_entries.begin(), cached_entries.end(), entry, CompareNames);
+			if (cached_entry != cached_entries.end() && cached_entry->file_name == entry.file_name
+				&& cached_entry->file_size == entry.file_size && cached_entry->modification_time == entry.modification_time)
+			{
+				entry = *cached_entry;
+			}
+			listed_entries.push_back(std::move(entry));
+		}
+		catch (const std::exception&)
+		{
+			/* E.g. a file name that cannot be represented; leave the file out. */
+		}
+	}
+	std::sort(listed_entries.begin(), listed_entries.end(), CompareNames);
+	if (!stop_requested)
+		Publish(listed_entries);
+
+	/* Last, index what is left, passing the entries on as they are done. */
+	auto last_change_notification_time = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < listed_entries.size() && !stop_requested; i++)
+	{
+		if (listed_entries[i].indexed)
+			continue;
+		IndexFile(directory / listed_entries[i].file_name, listed_entries[i]);
+		{
+			std::scoped_lock lock{ entries_mutex };
+			entries[i] = listed_entries[i];
+		}
+		const auto now = std::chrono::steady_clock::now();
+		if (now - last_change_notification_time >= change_notification_interval)
+		{
+			on_change();
+			last_change_notification_time = now;
+		}
+	}
+
+	/* Also when stopped early; what has been indexed so far need not be indexed again. */
+	if (!listed_entries.empty())
+		SaveCache(listed_entries);
+	indexing = false;
+	if (!stop_requested)
+		on_change();
+}
+
+
+std::string RomLibrary::GetCachePath() const
+{
+	const std::string directory_string = directory.string();
+	return (std::filesystem::path(cache_directory) /
+		std::format("rom_library_{:016X}.bin", Hash::FNV1a(directory_string.data(), directory_string.size()))).string();
+}
+
+
+std::vector<RomLibrary::Entry> RomLibrary::LoadCache() const
+{
+	/* Read whole, so that every count and length in it is checked against what is left of it before anything is allocated for it;
+	   a cache that is corrupt or cut short is dropped. */
+	std::ifstream ifs{ GetCachePath(), std::ios::in | std::ios::binary | std::ios::ate };
+	if (!ifs)
+		return {};
+	const std::streamoff file_size = ifs.tellg();
+	if (file_size <= 0 || file_size > std::streamoff(max_cache_size))
+		return {};
+	std::vector<u8> cache(file_size);
+	ifs.seekg(0);
+	ifs.read((char*)cache.data(), file_size);
+	if (!ifs)
+		return {};
+
+	SerializationStream stream{ std::span<const u8>(cache) };
+	u64 magic = 0;
+	u32 version = 0;
+	std::string cached_directory;
+	size_t num_entries = 0;
+	stream.StreamPrimitive(magic);
+	stream.StreamPrimitive(version);
+	if (stream.HasError() || magic != cache_magic || version != cache_version)
+		return {};
+	stream.StreamString(cached_directory);
+	stream.StreamPrimitive(num_entries);
+	if (stream.HasError() || cached_directory != directory.string())
+		return {};
+	/* Every entry holds at least the lengths of its two strings */
+	if (num_entries > cache.size() / (2 * sizeof(size_t)))
+		return {};
+
+	std::vector<Entry> cached_entries;
+	for (size_t i = 0; i < num_entries && !stream.HasError(); i++)
+		StreamEntry(stream, cached_entries.emplace_back());
+	if (stream.HasError())
+		return {};
+	return cached_entries;
+}
+
+
+void RomLibrary::SaveCache(std::vector<Entry>& entries_to_save) const
+{
+	/* Written to a temporary file first, so that the cache is never left half-written. */
+	const std::string cache_path = GetCachePath();
+	const std::string temporary_cache_path = cache_path + ".tmp";
+	{
+		SerializationStream stream{ temporary_cache_path, SerializationStream::Mode::Serialization };
+		u64 magic = cache_magic;
+		u32 version = cache_version;
+		std::string directory_string = directory.string();
+		size_t num_entries = entries_to_save.size();
+		stream.StreamPrimitive(magic);
+		stream.StreamPrimitive(version);
+		stream.StreamString(directory_string);
+		stream.StreamPrimitive(num_entries);
+		for (Entry& entry : entries_to_save)
+			StreamEntry(stream, entry);
+		if (stream.HasError())
+			return;
+	}
+	std::error_code ec;
+	std::filesystem::rename(temporary_cache_path, cache_path, ec);
+}
+
+
+void RomLibrary::IndexFile(const std::filesystem::path& path, Entry& entry)
+{
+	entry.indexed = true;
+	const std::string path_string = path.string();
+	const std::shared_ptr<const RomImage> rom_image = RomImage::Open(path_string);
+	if (!rom_image)
+		return;
+	const std::span<const u8> rom = rom_image->GetData();
+
+	MapperProperties mapper_properties{ path_string };
+	std::optional<NSFProperties> nsf_properties;
+	entry.is_rom = Cartridge::PeekHeader(rom, mapper_properties, nsf_properties);
+	entry.is_nsf = nsf_properties.has_value();
+	entry.mapper_num = mapper_properties.mapper_num;
+	entry.video_standard = mapper_properties.video_standard;
+	entry.prg_rom_size = u32(mapper_properties.prg_rom_size);
+	entry.chr_size = mapper_properties.has_chr_ram ? 0 : u32(mapper_properties.chr_size);
+	if (nsf_properties.has_value())
+		entry.title = nsf_properties->title;
+	entry.content_hash = Hash::FNV1a(rom.data(), rom.size());
+}
+
+
+void RomLibrary::StreamEntry(SerializationStream& stream, Entry& entry)
+{
+	stream.StreamString(entry.file_name);
+	stream.StreamPrimitive(entry.file_size);
+	stream.StreamPrimitive(entry.modification_time);
+	stream.StreamPrimitive(entry.indexed);
+	stream.StreamPrimitive(entry.is_rom);
+	stream.StreamPrimitive(entry.is_nsf);
+	stream.StreamPrimitive(entry.mapper_num);
+	stream.StreamPrimitive(entry.video_standard);
+	stream.StreamPrimitive(entry.prg_rom_size);
+	stream.StreamPrimitive(entry.chr_size);
+	stream.StreamPrimitive(entry.content_hash);
+	stream.StreamString(entry.title);
+}
+
+
+bool RomLibrary::HasExtension(const std::filesystem::path& path, const std::vector<std::string>& extensions)
+{
+	if (extensions.empty())
+		return true;
+	std::string extension = path.extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+	return std::find(extensions.begin(), extensions.end(), extension) != extensions.end();
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../Hash.h"
+#include "../SerializationStream.h"
+#include "../Types.h"
+
+#include "../core/System.h"
+
+/* An index of the roms in a directory, for the game list. Indexing runs on a thread of its own: the directory is listed,
+   and every file is mapped (see RomImage), its header parsed (see Cartridge::PeekHeader), and its contents hashed.
+   What has been found is kept in a cache file per directory, and is only found anew for files whose size or modification
+   time have changed since; so the entries known from the last time are there at once, and the rest come in as they are indexed.
+   The entries are sorted by file name, and can be read from any thread while indexing goes on. */
+class RomLibrary
+{
+public:
+	struct Entry
+	{
+		std::string file_name;
+		u64 file_size = 0;
+		s64 modification_time = 0;
+
+		/* The members below are only valid once the file has been indexed. */
+		bool indexed = false;
+		bool is_rom = false; /* An iNES/NES 2.0 image or an NSF tune, as opposed to a file without a valid header */
+		bool is_nsf = false;
+		u16 mapper_num = 0;
+		System::VideoStandard video_standard{};
+		u32 prg_rom_size = 0;
+		u32 chr_size = 0; /* 0 for CHR RAM */
+		u64 content_hash = 0;
+		std::string title; /* NSF tunes only */
+	};
+
+	/* The cache files are put in 'cache_directory'. */
+	explicit RomLibrary(std::string cache_directory) : cache_directory(std::move(cache_directory)) {}
+	~RomLibrary() { Stop(); }
+
+	RomLibrary(const RomLibrary&) = delete;
+	RomLibrary& operator=(const RomLibrary&) = delete;
+
+	/* Starts indexing the files in 'directory' that have one of 'extensions' (e.g. ".nes"; all files if empty), stopping an indexing
+	   that is going on. 'on_change' is called, from the indexing thread, whenever entries have been added or updated. */
+	void Index(const std::string& directory, std::vector<std::string> extensions, std::function<void()> on_change);
+	/* Returns once the indexing thread has stopped. */
+	void Stop();
+
+	bool IsIndexing() const { return indexing; }
+	size_t GetNumEntries() const;
+	std::optional<Entry> GetEntry(size_t index) const;
+	std::string GetPath(size_t index) const;
+
+private:
+	static constexpr u64 cache_magic = 0x3142494C444E5345; /* "ESNDLIB1" */
+	static constexpr u32 cache_version = 1;
+	/* Caches are around a hundred bytes per file; a larger one than this is taken to be corrupt. */
+	static constexpr size_t max_cache_size = 256 * 1024 * 1024;
+	/* While indexing, changes are passed on through 'on_change' at most this often. */
+	static constexpr std::chrono::milliseconds change_notification_interval{ 100 };
+
+	const std::string cache_directory;
+
+	std::filesystem::path directory;
+	std::vector<Entry> entries; /* Sorted by file name */
+	mutable std::mutex entries_mutex;
+
+	std::thread indexing_thread;
+	std::atomic<bool> indexing = false;
+	std::atomic<bool> stop_requested = false;
+
+	void IndexingLoop(std::vector<std::string> extensions, std::function<void()> on_change);
+
+	std::string GetCachePath() const;
+	std::vector<Entry> LoadCache() const;
+	void SaveCache(std::vector<Entry>& entries_to_save) const;
+
+	static void IndexFile(const std::filesystem::path& path, Entry& entry);
+	static void StreamEntry(SerializationStream& stream, Entry& entry);
+	static bool HasExtension(const std::filesystem::path& path, const std::vector<std::string>& extensions);
+};
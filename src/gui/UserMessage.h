@@ -1,7 +1,9 @@
 #pragma once
 
+#include <iostream>
 #include <string>
 
+#include <wx/thread.h>
 #include "wx/wx.h"
 
 namespace UserMessage
@@ -19,7 +21,11 @@ namespace UserMessage
 		case Type::Fatal: prefix = "Fatal: "; break;
 		default: break;
 		}
-		wxMessageBox(prefix + message);
+		/* Message boxes can only be shown from the GUI thread; e.g. headless emulator instances running on worker threads print to stderr. */
+		if (wxIsMainThread())
+			wxMessageBox(prefix + message);
+		else
+			std::cerr << (prefix + message).ToStdString() << std::endl;
 	}
 
 	inline void Show(const std::string& message, Type type = Type::Unspecified)
@@ -0,0 +1,125 @@
+#include "NTSCFilter.h"
+
+#include <xmmintrin.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <numbers>
+
+
+NTSCFilter::NTSCFilter()
+{
+	/* Signal levels (https://wiki.nesdev.org/w/index.php?title=NTSC_video), relative to sync level.
+	   The first four are the low levels of luma 0-3, the last four the high levels. */
+	constexpr std::array<f32, 8> levels = { 0.350f, 0.518f, 0.962f, 1.550f, 1.094f, 1.506f, 1.962f, 1.962f };
+	constexpr f32 black = 0.518f, white = 1.962f;
+	constexpr f32 emphasis_attenuation = 0.746f;
+
+	/* Decoder settings. The hue offset (in samples) lines up the demodulation carriers with the colour burst; it,
+	   together with the saturation and brightness, was chosen so that flat areas come out close to the 2C02 palette used without the filter. */
+	constexpr unsigned hue_offset = 4;
+	constexpr f32 saturation = 0.8f;
+	constexpr f32 brightness = 0.9f;
+	constexpr f32 luma_gain = brightness / decode_window;
+	constexpr f32 chroma_gain = 2.f * saturation * brightness / decode_window;
+
+	auto in_colour_phase = [](unsigned colour, unsigned phase) { return (colour + phase) % num_phases < 6; };
+
+	auto get_signal = [&](unsigned pixel, unsigned phase) {
+		const unsigned colour = pixel & 0xF;
+		const unsigned luma = colour >= 0xE ? 1 : pixel >> 4 & 3;
+		const unsigned emphasis = pixel >> 6;
+
+		f32 low = levels[luma], high = levels[4 + luma];
+		if (colour == 0) low = high;
+		if (colour >= 0xD) high = low;
+
+		f32 signal = in_colour_phase(colour, phase) ? high : low;
+		/* Each emphasis bit attenuates the signal during the part of the subcarrier cycle where colour 0 (red), 4 (green) or 8 (blue) is high. */
+		if ((emphasis & 1 && in_colour_phase(0, phase)) || (emphasis & 2 && in_colour_phase(4, phase)) || (emphasis & 4 && in_colour_phase(8, phase)))
+			signal *= emphasis_attenuation;
+		return (signal - black) / (white - black);
+	};
+
+	sample_table.resize(512 * num_pixel_phases * samples_per_pixel);
+	for (unsigned pixel = 0; pixel < 512; pixel++)
+	{
+		for (unsigned pixel_phase = 0; pixel_phase < num_pixel_phases; pixel_phase++)
+		{
+			for (unsigned sample = 0; sample < samples_per_pixel; sample++)
+			{
+				const unsigned phase = (pixel_phase * 4 + sample) % num_phases;
+				const f32 signal = get_signal(pixel, phase);
+				const f64 angle = std::numbers::pi * (phase + hue_offset) / 6;
+				sample_table[(pixel * num_pixel_phases + pixel_phase) * samples_per_pixel + sample] = _mm_setr_ps(
+					signal * luma_gain,
+					signal * chroma_gain * f32(std::cos(angle)),
+					signal * chroma_gain * f32(std::sin(angle)),
+					0.f);
+			}
+		}
+	}
+}
+
+
+void NTSCFilter::FilterRows(const u16* pixels, unsigned first_row, unsigned num_rows, unsigned burst_phase,
+	u32* output, size_t output_pitch, unsigned output_width) const
+{
+	for (unsigned row = first_row; row < first_row + num_rows; row++)
+	{
+		const unsigned line_phase = (burst_phase + row * phase_advance_per_scanline) % num_phases;
+		FilterRow(pixels + row * input_width, line_phase, output + row * output_pitch, output_width);
+	}
+}
+
+
+void NTSCFilter::FilterRow(const u16* pixels, unsigned line_phase, u32* output, unsigned output_width) const
+{
+	/* Running sums of the demodulated samples, with half a decode window of black on each side of the scanline.
+	   sums[n] is the sum of the first n (padded) samples, so any window is decoded with a single subtraction. */
+	constexpr unsigned padding = decode_window / 2;
+	std::array<__m128, max_output_width + 2 * padding + 1> sums;
+
+	__m128 sum = _mm_setzero_ps();
+	std::fill(sums.begin(), sums.begin() + padding + 1, sum);
+	__m128* dst = sums.data() + padding + 1;
+	for (unsigned x = 0; x < input_width; x++)
+	{
+		const unsigned pixel_phase = (line_phase + x * samples_per_pixel) % num_phases / 4;
+		const __m128* samples = &sample_table[(pixels[x] * num_pixel_phases + pixel_phase) * samples_per_pixel];
+		for (unsigned sample = 0; sample < samples_per_pixel; sample++)
+		{
+			sum = _mm_add_ps(sum, samples[sample]);
+			*dst++ = sum;
+		}
+	}
+	std::fill(dst, sums.end(), sum);
+
+	const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.f), scale = _mm_set1_ps(255.f), half = _mm_set1_ps(0.5f);
+
+	/* Decode four output pixels at a time. The window of each is centered at the output pixel's position in the sample stream. */
+	for (unsigned x = 0; x < output_width; x += 4)
+	{
+		std::array<__m128, 4> yiq;
+		for (unsigned i = 0; i < 4; i++)
+		{
+			const size_t center = (2 * size_t(x + i) + 1) * max_output_width / (2 * output_width);
+			yiq[i] = _mm_sub_ps(sums[center + decode_window], sums[center]);
+		}
+		_MM_TRANSPOSE4_PS(yiq[0], yiq[1], yiq[2], yiq[3]);
+		const __m128 y = yiq[0], i = yiq[1], q = yiq[2];
+
+		auto to_channel = [&](f32 i_factor, f32 q_factor) {
+			__m128 value = _mm_add_ps(y, _mm_add_ps(_mm_mul_ps(i, _mm_set1_ps(i_factor)), _mm_mul_ps(q, _mm_set1_ps(q_factor))));
+			value = _mm_min_ps(_mm_max_ps(value, zero), one);
+			return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, scale), half));
+		};
+		const __m128i r = to_channel( 0.946882f,  0.623557f);
+		const __m128i g = to_channel(-0.274788f, -0.635691f);
+		const __m128i b = to_channel(-1.108545f,  1.709007f);
+
+		const __m128i rgb = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(r, 16), _mm_slli_epi32(g, 8)), b);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(output + x), rgb);
+	}
+}
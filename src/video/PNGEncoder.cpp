@@ -0,0 +1,215 @@
+#include "PNGEncoder.h"
+
+#include <algorithm>
+
+
+std::vector<u8> PNGEncoder::Encode(const u8* rgb, const unsigned width, const unsigned height)
+{
+	/* Every row is preceded by its filter type. Filtering does not improve much on frames this flat, so it is always 0 (none). */
+	const size_t row_size = size_t(width) * 3;
+	std::vector<u8> filtered_rows((row_size + 1) * height);
+	for (unsigned row = 0; row < height; row++)
+	{
+		u8* dst = &filtered_rows[row * (row_size + 1)];
+		dst[0] = 0;
+		std::copy(rgb + row * row_size, rgb + (row + 1) * row_size, dst + 1);
+	}
+
+	std::vector<u8> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+	std::vector<u8> header;
+	WriteU32BigEndian(header, width);
+	WriteU32BigEndian(header, height);
+	header.insert(header.end(), {
+		8, /* bit depth */
+		2, /* colour type: RGB */
+		0, /* compression method: deflate */
+		0, /* filter method: adaptive */
+		0  /* interlace method: none */
+	});
+	WriteChunk(png, "IHDR", header);
+	WriteChunk(png, "IDAT", Compress(filtered_rows.data(), filtered_rows.size()));
+	WriteChunk(png, "IEND", {});
+	return png;
+}
+
+
+std::vector<u8> PNGEncoder::Compress(const u8* data, const size_t size)
+{
+	std::vector<u8> out = {
+		0x78, /* CMF: deflate, 32 KiB window */
+		0x01  /* FLG: no preset dictionary, fastest compression level; (CMF * 256 + FLG) is a multiple of 31 */
+	};
+	out.reserve(size / 4);
+
+	BitWriter writer{ out };
+	writer.Write(1, 1); /* BFINAL: this is the last block */
+	writer.Write(1, 2); /* BTYPE: compressed with the fixed Huffman codes */
+
+	constexpr unsigned hash_size = 1 << hash_bits;
+	auto Hash = [&](size_t pos) {
+		return (data[pos] << 10 ^ data[pos + 1] << 5 ^ data[pos + 2]) & (hash_size - 1);
+	};
+
+	/* 'head' holds the last position with a given hash, and 'prev' links every position to the one before it with the same hash. */
+	std::vector<s32> head(hash_size, -1);
+	std::vector<s32> prev(size);
+
+	auto Insert = [&](size_t pos) {
+		if (pos + min_match_len <= size)
+		{
+			const unsigned hash = Hash(pos);
+			prev[pos] = head[hash];
+			head[hash] = s32(pos);
+		}
+	};
+
+	size_t pos = 0;
+	while (pos < size)
+	{
+		unsigned best_len = 0, best_distance = 0;
+		if (pos + min_match_len <= size)
+		{
+			const size_t max_len = std::min<size_t>(max_match_len, size - pos);
+			s32 candidate = head[Hash(pos)];
+			for (unsigned chain = 0; candidate >= 0 && pos - candidate <= window_size && chain < max_chain_len; chain++)
+			{
+				unsigned len = 0;
+				while (len < max_len && data[candidate + len] == data[pos + len])
+					len++;
+				if (len > best_len)
+				{
+					best_len = len;
+					best_distance = unsigned(pos - candidate);
+					if (len == max_len)
+						break;
+				}
+				candidate = prev[candidate];
+			}
+		}
+
+		if (best_len >= min_match_len)
+		{
+			WriteMatch(writer, best_len, best_distance);
+			for (size_t i = 0; i < best_len; i++)
+				Insert(pos + i);
+			pos += best_len;
+		}
+		else
+		{
+			WriteLiteralOrLength(writer, data[pos]);
+			Insert(pos);
+			pos++;
+		}
+	}
+
+	WriteLiteralOrLength(writer, 256); /* end of block */
+	writer.Flush();
+
+	WriteU32BigEndian(out, Adler32(data, size));
+	return out;
+}
+
+
+u32 PNGEncoder::CRC32(const u8* data, const size_t size, u32 crc)
+{
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++)
+		crc = crc_table[(crc ^ data[i]) & 0xFF] ^ crc >> 8;
+	return ~crc;
+}
+
+
+u32 PNGEncoder::Adler32(const u8* data, const size_t size)
+{
+	/* 5552 is the largest number of bytes that can be summed before the sums must be reduced, to not overflow 32 bits. */
+	constexpr u32 modulus = 65521;
+	constexpr size_t max_bytes_per_reduction = 5552;
+	u32 a = 1, b = 0;
+	for (size_t i = 0; i < size; )
+	{
+		const size_t end = std::min(size, i + max_bytes_per_reduction);
+		for (; i < end; i++)
+		{
+			a += data[i];
+			b += a;
+		}
+		a %= modulus;
+		b %= modulus;
+	}
+	return b << 16 | a;
+}
+
+
+void PNGEncoder::BitWriter::Write(const u32 bits, const unsigned num_bits)
+{
+	bit_buffer |= bits << num_buffered_bits;
+	num_buffered_bits += num_bits;
+	while (num_buffered_bits >= 8)
+	{
+		out.push_back(u8(bit_buffer));
+		bit_buffer >>= 8;
+		num_buffered_bits -= 8;
+	}
+}
+
+
+void PNGEncoder::BitWriter::WriteHuffmanCode(const u32 code, const unsigned len)
+{
+	u32 reversed = 0;
+	for (unsigned i = 0; i < len; i++)
+		reversed |= (code >> i & 1) << (len - 1 - i);
+	Write(reversed, len);
+}
+
+
+void PNGEncoder::BitWriter::Flush()
+{
+	if (num_buffered_bits > 0)
+		out.push_back(u8(bit_buffer));
+	bit_buffer = 0;
+	num_buffered_bits = 0;
+}
+
+
+void PNGEncoder::WriteLiteralOrLength(BitWriter& writer, const unsigned symbol)
+{
+	/* The fixed literal/length code (RFC 1951, 3.2.6) */
+	if (symbol < 144)
+		writer.WriteHuffmanCode(0x30 + symbol, 8);
+	else if (symbol < 256)
+		writer.WriteHuffmanCode(0x190 + symbol - 144, 9);
+	else if (symbol < 280)
+		writer.WriteHuffmanCode(symbol - 256, 7);
+	else
+		writer.WriteHuffmanCode(0xC0 + symbol - 280, 8);
+}
+
+
+void PNGEncoder::WriteMatch(BitWriter& writer, const unsigned len, const unsigned distance)
+{
+	const size_t len_code = std::upper_bound(length_base.begin(), length_base.end(), len) - length_base.begin() - 1;
+	WriteLiteralOrLength(writer, unsigned(257 + len_code));
+	writer.Write(len - length_base[len_code], length_extra_bits[len_code]);
+
+	/* Distance codes are five bits long in the fixed code. */
+	const size_t distance_code = std::upper_bound(distance_base.begin(), distance_base.end(), distance) - distance_base.begin() - 1;
+	writer.WriteHuffmanCode(unsigned(distance_code), 5);
+	writer.Write(distance - distance_base[distance_code], distance_extra_bits[distance_code]);
+}
+
+
+void PNGEncoder::WriteChunk(std::vector<u8>& png, const char* type, const std::vector<u8>& data)
+{
+	WriteU32BigEndian(png, u32(data.size()));
+	const size_t type_pos = png.size();
+	png.insert(png.end(), type, type + 4);
+	png.insert(png.end(), data.begin(), data.end());
+	WriteU32BigEndian(png, CRC32(&png[type_pos], data.size() + 4));
+}
+
+
+void PNGEncoder::WriteU32BigEndian(std::vector<u8>& out, const u32 value)
+{
+	out.insert(out.end(), { u8(value >> 24), u8(value >> 16), u8(value >> 8), u8(value) });
+}
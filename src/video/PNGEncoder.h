@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+#include "../Types.h"
+
+/* A self-contained PNG encoder for 8-bit RGB images. The image data is compressed with deflate, using the fixed Huffman codes
+   and greedy LZ77 matching over hash chains. NES frames consist mostly of runs of a few colours and of repeated rows,
+   which this finds well enough, without the cost of building dynamic Huffman tables. */
+class PNGEncoder
+{
+public:
+	/* 'rgb' holds 'height' rows of 'width' pixels, three bytes (R, G, B) per pixel. */
+	static std::vector<u8> Encode(const u8* rgb, unsigned width, unsigned height);
+
+	/* zlib (RFC 1950) stream of 'data', with a single fixed-Huffman deflate block. */
+	static std::vector<u8> Compress(const u8* data, size_t size);
+
+	static u32 CRC32(const u8* data, size_t size, u32 crc = 0);
+	static u32 Adler32(const u8* data, size_t size);
+
+private:
+	static constexpr unsigned min_match_len = 3;
+	static constexpr unsigned max_match_len = 258;
+	static constexpr unsigned window_size = 32768;
+	static constexpr unsigned max_chain_len = 32; /* How many earlier positions with the same hash are tried at most. */
+	static constexpr unsigned hash_bits = 15;
+
+	static constexpr std::array<u16, 29> length_base = {
+		3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+	};
+	static constexpr std::array<u8, 29> length_extra_bits = {
+		0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+	};
+	static constexpr std::array<u16, 30> distance_base = {
+		1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+	};
+	static constexpr std::array<u8, 30> distance_extra_bits = {
+		0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+	};
+
+	static constexpr std::array<u32, 256> crc_table = [] {
+		std::array<u32, 256> table{};
+		for (u32 n = 0; n < 256; n++)
+		{
+			u32 c = n;
+			for (int k = 0; k < 8; k++)
+				c = c & 1 ? 0xEDB88320 ^ c >> 1 : c >> 1;
+			table[n] = c;
+		}
+		return table;
+	}();
+
+	/* Deflate writes bits starting from the least significant bit of each byte. */
+	class BitWriter
+	{
+	public:
+		explicit BitWriter(std::vector<u8>& out) : out(out) {}
+
+		void Write(u32 bits, unsigned num_bits);
+		void WriteHuffmanCode(u32 code, unsigned len); /* Huffman codes are stored starting from their most significant bit. */
+		void Flush();
+
+	private:
+		std::vector<u8>& out;
+		u32 bit_buffer = 0;
+		unsigned num_buffered_bits = 0;
+	};
+
+	static void WriteChunk(std::vector<u8>& png, const char* type, const std::vector<u8>& data);
+	static void WriteLiteralOrLength(BitWriter& writer, unsigned symbol);
+	static void WriteMatch(BitWriter& writer, unsigned len, unsigned distance);
+	static void WriteU32BigEndian(std::vector<u8>& out, u32 value);
+};
@@ -0,0 +1,388 @@
+#include "Upscaler.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+
+/* Weighted average of up to three colours, two channels at a time. The weights must add up to 1 << shift (at most 16). */
+static u32 Blend(u32 c1, unsigned w1, u32 c2, unsigned w2, u32 c3, unsigned w3, unsigned shift)
+{
+	const u32 rb = ((c1 & 0xFF00FF) * w1 + (c2 & 0xFF00FF) * w2 + (c3 & 0xFF00FF) * w3) >> shift & 0xFF00FF;
+	const u32 g  = ((c1 & 0x00FF00) * w1 + (c2 & 0x00FF00) * w2 + (c3 & 0x00FF00) * w3) >> shift & 0x00FF00;
+	return rb | g;
+}
+
+
+static __m128i Select(__m128i mask, __m128i a, __m128i b)
+{
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+
+/* Interleaves a0 b0 c0 a1 b1 c1 ... a3 b3 c3, and stores the result at 'dst'. */
+static void StoreInterleaved3(u32* dst, __m128i a, __m128i b, __m128i c)
+{
+	const __m128 ab_lo = _mm_castsi128_ps(_mm_unpacklo_epi32(a, b)); // a0 b0 a1 b1
+	const __m128 ab_hi = _mm_castsi128_ps(_mm_unpackhi_epi32(a, b)); // a2 b2 a3 b3
+	const __m128 bc_lo = _mm_castsi128_ps(_mm_unpacklo_epi32(b, c)); // b0 c0 b1 c1
+	const __m128 bc_hi = _mm_castsi128_ps(_mm_unpackhi_epi32(b, c)); // b2 c2 b3 c3
+	const __m128 ca_lo = _mm_castsi128_ps(_mm_unpacklo_epi32(c, a)); // c0 a0 c1 a1
+	const __m128 ca_hi = _mm_castsi128_ps(_mm_unpackhi_epi32(c, a)); // c2 a2 c3 a3
+	_mm_storeu_ps(reinterpret_cast<float*>(dst    ), _mm_shuffle_ps(ab_lo, ca_lo, _MM_SHUFFLE(3, 0, 1, 0)));
+	_mm_storeu_ps(reinterpret_cast<float*>(dst + 4), _mm_shuffle_ps(bc_lo, ab_hi, _MM_SHUFFLE(1, 0, 3, 2)));
+	_mm_storeu_ps(reinterpret_cast<float*>(dst + 8), _mm_shuffle_ps(ca_hi, bc_hi, _MM_SHUFFLE(3, 2, 3, 0)));
+}
+
+
+Upscaler::Upscaler(const std::array<u32, 512>& rgb_palette) : rgb_palette(rgb_palette)
+{
+	for (size_t i = 0; i < rgb_palette.size(); i++)
+	{
+		const int r = rgb_palette[i] >> 16 & 0xFF, g = rgb_palette[i] >> 8 & 0xFF, b = rgb_palette[i] & 0xFF;
+		yuv_palette[i].y = (299 * r + 587 * g + 114 * b) / 1000;
+		yuv_palette[i].u = (-169 * r - 331 * g + 500 * b) / 1000 + 128;
+		yuv_palette[i].v = (500 * r - 419 * g - 81 * b) / 1000 + 128;
+	}
+
+	/* Which pairs of pixel values count as similar colours is looked up in a 512x512 bit table (32 KiB). */
+	similarity_bits.resize(512 * 512 / 64);
+	for (unsigned a = 0; a < 512; a++)
+	{
+		for (unsigned b = 0; b < 512; b++)
+		{
+			const YUV& p = yuv_palette[a];
+			const YUV& q = yuv_palette[b];
+			/* The thresholds used by hqx */
+			if (std::abs(p.y - q.y) <= 0x30 && std::abs(p.u - q.u) <= 7 && std::abs(p.v - q.v) <= 6)
+				similarity_bits[(a * 512 + b) / 64] |= u64(1) << (b % 64);
+		}
+	}
+
+	padded_pixels.resize(stride * (max_height + 2 * border));
+	padded_rgb.resize(stride * (max_height + 2 * border));
+}
+
+
+unsigned Upscaler::GetFactor(const Algorithm algorithm)
+{
+	switch (algorithm)
+	{
+	case Algorithm::Scale2x:
+	case Algorithm::HQ2x:
+	case Algorithm::XBR:
+		return 2;
+	case Algorithm::Scale3x:
+	case Algorithm::HQ3x:
+		return 3;
+	default:
+		return 1;
+	}
+}
+
+
+void Upscaler::PrepareRows(const u16* pixels, const unsigned height, const unsigned first_row, const unsigned num_rows)
+{
+	auto copy_row = [&](unsigned src_row, unsigned dst_row) {
+		std::memcpy(&padded_pixels[dst_row * stride], &padded_pixels[src_row * stride], stride * sizeof(u16));
+		std::memcpy(&padded_rgb[dst_row * stride], &padded_rgb[src_row * stride], stride * sizeof(u32));
+	};
+
+	for (unsigned row = first_row; row < first_row + num_rows; row++)
+	{
+		const u16* src = pixels + row * input_width;
+		u16* dst_pixels = &padded_pixels[(row + border) * stride];
+		u32* dst_rgb = &padded_rgb[(row + border) * stride];
+		for (unsigned x = 0; x < stride; x++)
+		{
+			const u16 pixel = src[std::clamp(int(x) - int(border), 0, int(input_width) - 1)];
+			dst_pixels[x] = pixel;
+			dst_rgb[x] = rgb_palette[pixel];
+		}
+
+		/* The first and last rows are also repeated into the border above and below the frame. */
+		for (unsigned i = 0; i < border; i++)
+		{
+			if (row == 0)
+				copy_row(border, i);
+			if (row == height - 1)
+				copy_row(height - 1 + border, height + border + i);
+		}
+	}
+}
+
+
+void Upscaler::ScaleRows(const Algorithm algorithm, const unsigned first_row, const unsigned num_rows,
+	const unsigned integer_scale, u32* output, const size_t output_pitch) const
+{
+	const unsigned factor = GetFactor(algorithm);
+	const unsigned width = input_width * factor;
+
+	/* Without further widening, the upscalers write straight into the output. Otherwise, they write to a scratch buffer first;
+	   one per thread, as rows are scaled on several threads at once, allocated the first time that it is needed. */
+	const bool use_scratch = integer_scale > 1 && algorithm != Algorithm::Nearest;
+	thread_local std::vector<u32> scratch;
+	if (use_scratch && scratch.empty())
+		scratch.resize(max_factor * input_width * max_factor);
+
+	for (unsigned row = first_row; row < first_row + num_rows; row++)
+	{
+		std::array<u32*, 3> dst{};
+		for (unsigned i = 0; i < factor; i++)
+			dst[i] = use_scratch ? &scratch[i * width] : output + (row * factor + i) * output_pitch;
+		std::array<const u32*, 3> widen_src = { dst[0], dst[1], dst[2] };
+
+		switch (algorithm)
+		{
+		case Algorithm::Nearest:
+			if (integer_scale == 1)
+				std::memcpy(dst[0], RGBRow(row), width * sizeof(u32));
+			else
+				widen_src[0] = RGBRow(row);
+			break;
+		case Algorithm::Scale2x: ScaleRowScale2x(row, dst.data()); break;
+		case Algorithm::Scale3x: ScaleRowScale3x(row, dst.data()); break;
+		case Algorithm::HQ2x: ScaleRowHQ(row, 2, dst.data()); break;
+		case Algorithm::HQ3x: ScaleRowHQ(row, 3, dst.data()); break;
+		case Algorithm::XBR: ScaleRowXBR(row, dst.data()); break;
+		}
+
+		if (integer_scale > 1)
+		{
+			for (unsigned i = 0; i < factor; i++)
+			{
+				u32* out = output + size_t(row * factor + i) * integer_scale * output_pitch;
+				WidenRow(widen_src[i], width, integer_scale, out);
+				for (unsigned j = 1; j < integer_scale; j++)
+					std::memcpy(out + j * output_pitch, out, width * integer_scale * sizeof(u32));
+			}
+		}
+	}
+}
+
+
+bool Upscaler::Similar(const u16 a, const u16 b) const
+{
+	return similarity_bits[(a * 512 + b) / 64] >> (b % 64) & 1;
+}
+
+
+int Upscaler::Distance(const u16 a, const u16 b) const
+{
+	/* The weights used by xBR */
+	const YUV& p = yuv_palette[a];
+	const YUV& q = yuv_palette[b];
+	return 48 * std::abs(p.y - q.y) + 7 * std::abs(p.u - q.u) + 6 * std::abs(p.v - q.v);
+}
+
+
+void Upscaler::ScaleRowScale2x(const unsigned row, u32* const* dst) const
+{
+	/*  A B C      E0 E1
+	    D E F  ->  E2 E3
+	    G H I              (https://www.scale2x.it/algorithm) */
+	const u32* cur = RGBRow(row);
+	const u32* above = cur - stride;
+	const u32* below = cur + stride;
+
+	for (unsigned x = 0; x < input_width; x += 4)
+	{
+		const __m128i B = _mm_loadu_si128(reinterpret_cast<const __m128i*>(above + x));
+		const __m128i D = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + x - 1));
+		const __m128i E = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + x));
+		const __m128i F = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + x + 1));
+		const __m128i H = _mm_loadu_si128(reinterpret_cast<const __m128i*>(below + x));
+
+		const __m128i db = _mm_cmpeq_epi32(D, B), bf = _mm_cmpeq_epi32(B, F);
+		const __m128i dh = _mm_cmpeq_epi32(D, H), hf = _mm_cmpeq_epi32(H, F);
+
+		const __m128i E0 = Select(_mm_andnot_si128(_mm_or_si128(bf, dh), db), D, E);
+		const __m128i E1 = Select(_mm_andnot_si128(_mm_or_si128(db, hf), bf), F, E);
+		const __m128i E2 = Select(_mm_andnot_si128(_mm_or_si128(db, hf), dh), D, E);
+		const __m128i E3 = Select(_mm_andnot_si128(_mm_or_si128(dh, bf), hf), F, E);
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst[0] + 2 * x    ), _mm_unpacklo_epi32(E0, E1));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst[0] + 2 * x + 4), _mm_unpackhi_epi32(E0, E1));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst[1] + 2 * x    ), _mm_unpacklo_epi32(E2, E3));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst[1] + 2 * x + 4), _mm_unpackhi_epi32(E2, E3));
+	}
+}
+
+
+void Upscaler::ScaleRowScale3x(const unsigned row, u32* const* dst) const
+{
+	/*  A B C      E0 E1 E2
+	    D E F  ->  E3 E4 E5
+	    G H I      E6 E7 E8  */
+	const u32* cur = RGBRow(row);
+	const u32* above = cur - stride;
+	const u32* below = cur + stride;
+
+	for (unsigned x = 0; x < input_width; x += 4)
+	{
+		const __m128i A = _mm_loadu_si128(reinterpret_cast<const __m128i*>(above + x - 1));
+		const __m128i B = _mm_loadu_si128(reinterpret_cast<const __m128i*>(above + x));
+		const __m128i C = _mm_loadu_si128(reinterpret_cast<const __m128i*>(above + x + 1));
+		const __m128i D = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + x - 1));
+		const __m128i E = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + x));
+		const __m128i F = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cur + x + 1));
+		const __m128i G = _mm_loadu_si128(reinterpret_cast<const __m128i*>(below + x - 1));
+		const __m128i H = _mm_loadu_si128(reinterpret_cast<const __m128i*>(below + x));
+		const __m128i I = _mm_loadu_si128(reinterpret_cast<const __m128i*>(below + x + 1));
+
+		/* Nothing is changed unless B != H and D != F. */
+		const __m128i inactive = _mm_or_si128(_mm_cmpeq_epi32(B, H), _mm_cmpeq_epi32(D, F));
+		const __m128i db = _mm_andnot_si128(inactive, _mm_cmpeq_epi32(D, B));
+		const __m128i bf = _mm_andnot_si128(inactive, _mm_cmpeq_epi32(B, F));
+		const __m128i dh = _mm_andnot_si128(inactive, _mm_cmpeq_epi32(D, H));
+		const __m128i hf = _mm_andnot_si128(inactive, _mm_cmpeq_epi32(H, F));
+		const __m128i ea = _mm_cmpeq_epi32(E, A), ec = _mm_cmpeq_epi32(E, C);
+		const __m128i eg = _mm_cmpeq_epi32(E, G), ei = _mm_cmpeq_epi32(E, I);
+
+		const __m128i E0 = Select(db, D, E);
+		const __m128i E1 = Select(_mm_or_si128(_mm_andnot_si128(ec, db), _mm_andnot_si128(ea, bf)), B, E);
+		const __m128i E2 = Select(bf, F, E);
+		const __m128i E3 = Select(_mm_or_si128(_mm_andnot_si128(eg, db), _mm_andnot_si128(ea, dh)), D, E);
+		const __m128i E5 = Select(_mm_or_si128(_mm_andnot_si128(ei, bf), _mm_andnot_si128(ec, hf)), F, E);
+		const __m128i E6 = Select(dh, D, E);
+		const __m128i E7 = Select(_mm_or_si128(_mm_andnot_si128(ei, dh), _mm_andnot_si128(eg, hf)), H, E);
+		const __m128i E8 = Select(hf, F, E);
+
+		StoreInterleaved3(dst[0] + 3 * x, E0, E1, E2);
+		StoreInterleaved3(dst[1] + 3 * x, E3, E, E5);
+		StoreInterleaved3(dst[2] + 3 * x, E6, E7, E8);
+	}
+}
+
+
+void Upscaler::ScaleRowHQ(const unsigned row, const unsigned factor, u32* const* dst) const
+{
+	/*  w0 w1 w2
+	    w3 w4 w5
+	    w6 w7 w8
+	   Uses the colour similarity thresholds and interpolation weights of hqx, but the blend of each corner is decided from its
+	   two adjacent neighbours and the diagonal one, rather than from a table covering all 256 patterns of the neighbourhood. */
+	const u16* pixels = PixelRow(row);
+	const u32* rgb = RGBRow(row);
+	constexpr int s = stride;
+	constexpr std::array<int, 9> offsets = { -s - 1, -s, -s + 1, -1, 0, 1, s - 1, s, s + 1 };
+
+	for (unsigned x = 0; x < input_width; x++)
+	{
+		std::array<u16, 9> w;
+		std::array<u32, 9> c;
+		for (unsigned i = 0; i < 9; i++)
+		{
+			w[i] = pixels[int(x) + offsets[i]];
+			c[i] = rgb[int(x) + offsets[i]];
+		}
+
+		/* Whether an edge passes diagonally by the corner between w4, w[a] and w[b]. */
+		auto is_edge = [&](unsigned a, unsigned b) {
+			return !Similar(w[4], w[a]) && !Similar(w[4], w[b]) && Similar(w[a], w[b]);
+		};
+
+		auto corner = [&](unsigned a, unsigned b, unsigned d) {
+			const bool a_differs = !Similar(w[4], w[a]), b_differs = !Similar(w[4], w[b]);
+			if (a_differs && b_differs)
+			{
+				if (!Similar(w[a], w[b]))
+					return Blend(c[4], 6, c[a], 1, c[b], 1, 3);
+				if (Similar(w[4], w[d])) // A thin diagonal line; round it off lightly
+					return Blend(c[4], 2, c[a], 1, c[b], 1, 2);
+				return factor == 2
+					? Blend(c[4], 6, c[a], 5, c[b], 5, 4)
+					: Blend(c[4], 2, c[a], 7, c[b], 7, 4);
+			}
+			if (a_differs) return Blend(c[4], 3, c[a], 1, 0, 0, 2);
+			if (b_differs) return Blend(c[4], 3, c[b], 1, 0, 0, 2);
+			if (!Similar(w[4], w[d])) return Blend(c[4], 3, c[d], 1, 0, 0, 2);
+			return c[4];
+		};
+
+		auto side = [&](unsigned n, bool edge_on_either_end) {
+			return edge_on_either_end ? Blend(c[4], 3, c[n], 1, 0, 0, 2) : c[4];
+		};
+
+		const u32 top_left = corner(1, 3, 0), top_right = corner(1, 5, 2);
+		const u32 bottom_left = corner(7, 3, 6), bottom_right = corner(7, 5, 8);
+
+		if (factor == 2)
+		{
+			dst[0][2 * x] = top_left;
+			dst[0][2 * x + 1] = top_right;
+			dst[1][2 * x] = bottom_left;
+			dst[1][2 * x + 1] = bottom_right;
+		}
+		else
+		{
+			const bool edge_top_left = is_edge(1, 3), edge_top_right = is_edge(1, 5);
+			const bool edge_bottom_left = is_edge(7, 3), edge_bottom_right = is_edge(7, 5);
+			dst[0][3 * x] = top_left;
+			dst[0][3 * x + 1] = side(1, edge_top_left || edge_top_right);
+			dst[0][3 * x + 2] = top_right;
+			dst[1][3 * x] = side(3, edge_top_left || edge_bottom_left);
+			dst[1][3 * x + 1] = c[4];
+			dst[1][3 * x + 2] = side(5, edge_top_right || edge_bottom_right);
+			dst[2][3 * x] = bottom_left;
+			dst[2][3 * x + 1] = side(7, edge_bottom_left || edge_bottom_right);
+			dst[2][3 * x + 2] = bottom_right;
+		}
+	}
+}
+
+
+void Upscaler::ScaleRowXBR(const unsigned row, u32* const* dst) const
+{
+	/* 2xBR (https://forums.libretro.com/t/xbr-algorithm-tutorial/123). The rule for the bottom right corner, using the 5x5 neighbourhood
+	          A1 B1 C1
+	       A0 A  B  C  C4
+	       D0 D  E  F  F4
+	       G0 G  H  I  I4
+	          G5 H5 I5
+	   is mirrored for the other three corners. */
+	const u16* pixels = PixelRow(row);
+	const u32* rgb = RGBRow(row);
+
+	for (unsigned x = 0; x < input_width; x++)
+	{
+		auto P = [&](int dx, int dy) { return pixels[int(x) + dx + dy * int(stride)]; };
+		auto C = [&](int dx, int dy) { return rgb[int(x) + dx + dy * int(stride)]; };
+
+		auto corner = [&](int dx, int dy) {
+			const u16 e = P(0, 0), f = P(dx, 0), h = P(0, dy), i = P(dx, dy);
+			if (e == f || e == h)
+				return C(0, 0);
+			const int edge = Distance(e, P(dx, -dy)) + Distance(e, P(-dx, dy)) + Distance(i, P(2 * dx, 0)) + Distance(i, P(0, 2 * dy)) + 4 * Distance(h, f);
+			const int diagonal = Distance(h, P(-dx, 0)) + Distance(h, P(dx, 2 * dy)) + Distance(f, P(2 * dx, dy)) + Distance(f, P(0, -dy)) + 4 * Distance(e, i);
+			if (edge >= diagonal)
+				return C(0, 0);
+			const u32 new_colour = Distance(e, f) <= Distance(e, h) ? C(dx, 0) : C(0, dy);
+			return Blend(C(0, 0), 1, new_colour, 1, 0, 0, 1);
+		};
+
+		dst[0][2 * x] = corner(-1, -1);
+		dst[0][2 * x + 1] = corner(1, -1);
+		dst[1][2 * x] = corner(-1, 1);
+		dst[1][2 * x + 1] = corner(1, 1);
+	}
+}
+
+
+void Upscaler::WidenRow(const u32* src, const unsigned width, const unsigned factor, u32* dst)
+{
+	if (factor == 2)
+	{
+		for (unsigned x = 0; x < width; x += 4)
+		{
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2 * x    ), _mm_unpacklo_epi32(v, v));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2 * x + 4), _mm_unpackhi_epi32(v, v));
+		}
+	}
+	else
+	{
+		for (unsigned x = 0; x < width; x++)
+			std::fill_n(dst + x * factor, factor, src[x]);
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <emmintrin.h>
+
+#include <array>
+#include <vector>
+
+#include "../Types.h"
+
+/* Pixel-art upscalers: integer nearest neighbour, Scale2x/Scale3x (AdvMAME), a simplified hq2x/hq3x (see ScaleRowHQ) and 2xBR.
+   A frame is first converted to RGB into a buffer with a 'border' pixels wide margin of repeated edge pixels,
+   so that every neighbourhood can be read without bounds checks. Both steps work on any set of rows, so that they
+   can be spread over worker threads; all rows must have been prepared before any are scaled.
+   The result can be widened further by an integer factor, so that the renderer does not have to scale it again. */
+class Upscaler
+{
+public:
+	enum class Algorithm { Nearest, Scale2x, Scale3x, HQ2x, HQ3x, XBR };
+
+	explicit Upscaler(const std::array<u32, 512>& rgb_palette);
+
+	static constexpr unsigned input_width = 256;
+	static constexpr unsigned max_height = 240;
+
+	static unsigned GetFactor(Algorithm algorithm);
+
+	/* Converts the rows [first_row, first_row + num_rows) of a frame of 9-bit pixels. */
+	void PrepareRows(const u16* pixels, unsigned height, unsigned first_row, unsigned num_rows);
+	/* Scales the rows [first_row, first_row + num_rows) of the prepared frame by GetFactor(algorithm) * 'integer_scale',
+	   into XRGB8888 rows in 'output', 'output_pitch' pixels apart. */
+	void ScaleRows(Algorithm algorithm, unsigned first_row, unsigned num_rows, unsigned integer_scale, u32* output, size_t output_pitch) const;
+
+private:
+	static constexpr unsigned border = 2;
+	static constexpr unsigned max_factor = 3;
+	static constexpr unsigned stride = input_width + 2 * border;
+
+	struct YUV { int y, u, v; };
+
+	const std::array<u32, 512>& rgb_palette;
+	std::array<YUV, 512> yuv_palette;
+
+	std::vector<u64> similarity_bits;
+	std::vector<u16> padded_pixels;
+	std::vector<u32> padded_rgb;
+
+	const u16* PixelRow(unsigned row) const { return &padded_pixels[(row + border) * stride + border]; }
+	const u32* RGBRow(unsigned row) const { return &padded_rgb[(row + border) * stride + border]; }
+
+	bool Similar(u16 a, u16 b) const;
+	int Distance(u16 a, u16 b) const;
+
+	void ScaleRowScale2x(unsigned row, u32* const* dst) const;
+	void ScaleRowScale3x(unsigned row, u32* const* dst) const;
+	void ScaleRowHQ(unsigned row, unsigned factor, u32* const* dst) const;
+	void ScaleRowXBR(unsigned row, u32* const* dst) const;
+
+	static void WidenRow(const u32* src, unsigned width, unsigned factor, u32* dst);
+};
@@ -0,0 +1,457 @@
+#include "VideoCapture.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <filesystem>
+#include <format>
+
+
+VideoCapture::VideoCapture(const std::array<u32, 512>& rgb_palette) : rgb_palette(rgb_palette)
+{
+	yuv_palette = MakeYUVPalette();
+}
+
+
+VideoCapture::~VideoCapture()
+{
+	Stop();
+}
+
+
+std::optional<VideoCapture::Format> VideoCapture::GetFormatFromPath(const std::string& path)
+{
+	std::string extension = std::filesystem::path(path).extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return char(std::tolower(c)); });
+	if (extension == ".avi") return Format::AVI;
+	if (extension == ".png") return Format::PNGSequence;
+	if (extension == ".y4m") return Format::Y4M;
+	return std::nullopt;
+}
+
+
+bool VideoCapture::Start(const std::string& path, const Format format, const unsigned height,
+	const u32 frame_rate_numerator, const u32 frame_rate_denominator, const OverflowPolicy overflow_policy)
+{
+	Stop();
+
+	this->path = path;
+	this->format = format;
+	this->height = height;
+	this->frame_rate_numerator = frame_rate_numerator;
+	this->frame_rate_denominator = frame_rate_denominator;
+	this->overflow_policy = overflow_policy;
+
+	buffers.assign(num_buffers, std::vector<u16>(frame_width * height));
+	free_buffers.clear();
+	for (unsigned i = 0; i < num_buffers; i++)
+		free_buffers.push_back(i);
+	queue = {};
+	stopping = false;
+	write_failed = false;
+	num_dropped_frames = 0;
+	has_written_frame = false;
+	num_frames_written = 0;
+	last_frame.assign(frame_width * height, 0);
+	avi_file_index = 0;
+
+	/* The output is opened here rather than on the encoder thread, so that failing to open it can be reported right away. */
+	bool opened = true;
+	if (format == Format::AVI)
+	{
+		opened = OpenAVI();
+	}
+	else if (format == Format::Y4M)
+	{
+		ofs.open(path, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+		WriteY4MHeader();
+		opened = ofs && !write_failed;
+	}
+	if (!opened)
+	{
+		ofs.close();
+		return false;
+	}
+
+	capturing = true;
+	encoder_thread = std::thread([this] { EncoderLoop(); });
+	return true;
+}
+
+
+bool VideoCapture::Stop()
+{
+	if (!capturing)
+		return true;
+
+	{
+		std::lock_guard lock(mutex);
+		stopping = true;
+	}
+	frame_available.notify_one();
+	encoder_thread.join();
+
+	if (format == Format::AVI)
+		FinishAVI();
+	ofs.close();
+	capturing = false;
+	return !write_failed;
+}
+
+
+void VideoCapture::PushFrame(const u16* pixels)
+{
+	std::unique_lock lock(mutex);
+	if (free_buffers.empty())
+	{
+		if (overflow_policy == OverflowPolicy::Drop)
+		{
+			num_dropped_frames++;
+			lock.unlock();
+			RepeatFrame();
+			return;
+		}
+		buffer_available.wait(lock, [&] { return !free_buffers.empty(); });
+	}
+	const unsigned buffer_index = free_buffers.back();
+	free_buffers.pop_back();
+
+	/* The buffer is not shared with the encoder thread until it has been queued, so the copy can be made without holding the lock. */
+	lock.unlock();
+	std::copy(pixels, pixels + buffers[buffer_index].size(), buffers[buffer_index].begin());
+	lock.lock();
+
+	queue.push({ buffer_index, 0 });
+	lock.unlock();
+	frame_available.notify_one();
+}
+
+
+void VideoCapture::RepeatFrame()
+{
+	{
+		std::lock_guard lock(mutex);
+		if (queue.empty())
+			queue.push({ std::nullopt, 0 });
+		else
+			queue.back().num_repeats++;
+	}
+	frame_available.notify_one();
+}
+
+
+void VideoCapture::EncoderLoop()
+{
+	while (true)
+	{
+		QueuedFrame frame;
+		{
+			std::unique_lock lock(mutex);
+			frame_available.wait(lock, [&] { return stopping || !queue.empty(); });
+			if (queue.empty())
+				return;
+			frame = queue.front();
+			queue.pop();
+			if (frame.buffer_index.has_value())
+			{
+				/* Take the frame over by swapping it with the last one, and hand the buffer back right away. */
+				last_frame.swap(buffers[frame.buffer_index.value()]);
+				free_buffers.push_back(frame.buffer_index.value());
+				buffer_available.notify_one();
+			}
+		}
+
+		if (frame.buffer_index.has_value())
+			WriteFrame();
+		else
+			WriteRepeatedFrame();
+		for (unsigned i = 0; i < frame.num_repeats; i++)
+			WriteRepeatedFrame();
+	}
+}
+
+
+void VideoCapture::Write(const void* data, const size_t size)
+{
+	if (write_failed)
+		return;
+	ofs.write(static_cast<const char*>(data), size);
+	if (!ofs)
+		write_failed = true;
+}
+
+
+void VideoCapture::WriteFrame()
+{
+	switch (format)
+	{
+	case Format::AVI: WriteAVIFrame(false); break;
+	case Format::PNGSequence: WritePNGFrame(false); break;
+	case Format::Y4M: WriteY4MFrame(); break;
+	}
+	has_written_frame = true;
+	num_frames_written++;
+}
+
+
+void VideoCapture::WriteRepeatedFrame()
+{
+	/* A repeat before the first frame (e.g. if the first frame was dropped) has nothing to repeat. */
+	if (!has_written_frame)
+		return;
+
+	switch (format)
+	{
+	case Format::AVI: WriteAVIFrame(true); break;
+	case Format::PNGSequence: WritePNGFrame(true); break;
+	case Format::Y4M: WriteY4MFrame(); break;
+	}
+	num_frames_written++;
+}
+
+
+/* Layout: RIFF 'AVI ' { LIST 'hdrl' { 'avih', LIST 'strl' { 'strh', 'strf' } }, LIST 'movi' { '00db'... }, 'idx1' }
+   The header has a fixed size, so that the sizes and frame counts that are only known at the end can be patched in at known offsets. */
+namespace AVIOffset
+{
+	constexpr std::streamoff riff_size = 4;
+	constexpr std::streamoff avih_total_frames = 48;
+	constexpr std::streamoff strh_length = 140;
+	constexpr std::streamoff movi_size = 216;
+	constexpr std::streamoff movi_fourcc = 220;
+}
+
+
+bool VideoCapture::OpenAVI()
+{
+	ofs.open(GetAVIPath(), std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+	if (!ofs)
+		return false;
+	avi_num_frames = 0;
+	avi_movi_size = 4; /* The 'movi' FOURCC */
+	avi_index.clear();
+	WriteAVIHeader();
+	return !write_failed;
+}
+
+
+void VideoCapture::WriteAVIHeader()
+{
+	const u32 frame_size = frame_width * height * 3;
+	const u32 frames_per_second = (frame_rate_numerator + frame_rate_denominator - 1) / frame_rate_denominator;
+
+	std::vector<u8> header;
+	auto FourCC = [&](const char* fourcc) { header.insert(header.end(), fourcc, fourcc + 4); };
+	auto U32 = [&](u32 value) { header.insert(header.end(), { u8(value), u8(value >> 8), u8(value >> 16), u8(value >> 24) }); };
+	auto U16 = [&](u16 value) { header.insert(header.end(), { u8(value), u8(value >> 8) }); };
+
+	FourCC("RIFF"); U32(0); FourCC("AVI ");
+	FourCC("LIST"); U32(192); FourCC("hdrl");
+
+	FourCC("avih"); U32(56);
+	U32(u32(std::lround(1'000'000.0 * frame_rate_denominator / frame_rate_numerator))); /* microseconds per frame */
+	U32(frame_size * frames_per_second); /* max bytes per second */
+	U32(0); /* padding granularity */
+	U32(0x10); /* flags: AVIF_HASINDEX */
+	U32(0); /* total frames */
+	U32(0); /* initial frames */
+	U32(1); /* streams */
+	U32(frame_size + 8); /* suggested buffer size */
+	U32(frame_width);
+	U32(height);
+	U32(0); U32(0); U32(0); U32(0); /* reserved */
+
+	FourCC("LIST"); U32(116); FourCC("strl");
+	FourCC("strh"); U32(56);
+	FourCC("vids");
+	FourCC("DIB ");
+	U32(0); /* flags */
+	U16(0); U16(0); /* priority, language */
+	U32(0); /* initial frames */
+	U32(frame_rate_denominator); /* scale */
+	U32(frame_rate_numerator); /* rate; frames per second = rate / scale */
+	U32(0); /* start */
+	U32(0); /* length (frames) */
+	U32(frame_size + 8); /* suggested buffer size */
+	U32(0xFFFFFFFF); /* quality: default */
+	U32(0); /* sample size: varies (repeated frames are empty) */
+	U16(0); U16(0); U16(frame_width); U16(height); /* frame rectangle */
+
+	FourCC("strf"); U32(40); /* BITMAPINFOHEADER */
+	U32(40);
+	U32(frame_width);
+	U32(height); /* positive: rows are stored bottom-up */
+	U16(1); /* planes */
+	U16(24); /* bits per pixel */
+	U32(0); /* BI_RGB */
+	U32(frame_size);
+	U32(0); U32(0); U32(0); U32(0); /* pixels per metre (x, y), colours used, colours important */
+
+	FourCC("LIST"); U32(0); FourCC("movi");
+
+	Write(header.data(), header.size());
+}
+
+
+void VideoCapture::WriteAVIFrame(const bool repeat)
+{
+	const u32 frame_size = frame_width * height * 3;
+	const u64 index_size = (avi_index.size() + 1) * 16;
+	if (avi_num_frames > 0 && avi_movi_size + 8 + frame_size + 8 + index_size > max_avi_movi_size)
+	{
+		FinishAVI();
+		avi_file_index++;
+		if (!OpenAVI())
+			write_failed = true;
+	}
+	if (write_failed)
+		return;
+
+	/* A repeated frame is stored as an empty chunk, which players show as a repeat of the previous one;
+	   it cannot be the first frame of a file, though. */
+	const bool write_empty_chunk = repeat && avi_num_frames > 0;
+	const u32 chunk_size = write_empty_chunk ? 0 : frame_size;
+	const u8 chunk_header[8] = { '0', '0', 'd', 'b', u8(chunk_size), u8(chunk_size >> 8), u8(chunk_size >> 16), u8(chunk_size >> 24) };
+	avi_index.push_back({ u32(avi_movi_size), chunk_size });
+	Write(chunk_header, sizeof(chunk_header));
+
+	if (!write_empty_chunk)
+	{
+		/* 24-bit DIBs are stored bottom-up, as BGR. Rows are 768 bytes, so no padding to four bytes is needed. */
+		converted_frame.resize(frame_size);
+		u8* dst = converted_frame.data();
+		for (unsigned row = height; row-- > 0; )
+		{
+			const u16* src = &last_frame[row * frame_width];
+			for (unsigned x = 0; x < frame_width; x++)
+			{
+				const u32 rgb = rgb_palette[src[x]];
+				*dst++ = u8(rgb);
+				*dst++ = u8(rgb >> 8);
+				*dst++ = u8(rgb >> 16);
+			}
+		}
+		Write(converted_frame.data(), frame_size);
+	}
+
+	avi_movi_size += 8 + chunk_size;
+	avi_num_frames++;
+}
+
+
+void VideoCapture::FinishAVI()
+{
+	if (!ofs.is_open())
+		return;
+
+	std::vector<u8> index;
+	index.reserve(8 + avi_index.size() * 16);
+	auto U32 = [&](u32 value) { index.insert(index.end(), { u8(value), u8(value >> 8), u8(value >> 16), u8(value >> 24) }); };
+	index.insert(index.end(), { 'i', 'd', 'x', '1' });
+	U32(u32(avi_index.size() * 16));
+	for (const AVIIndexEntry& entry : avi_index)
+	{
+		index.insert(index.end(), { '0', '0', 'd', 'b' });
+		U32(entry.size > 0 ? 0x10 : 0); /* AVIIF_KEYFRAME */
+		U32(entry.offset);
+		U32(entry.size);
+	}
+	Write(index.data(), index.size());
+
+	const u64 file_size = AVIOffset::movi_fourcc + avi_movi_size + index.size();
+	auto Patch = [&](std::streamoff offset, u32 value) {
+		const u8 bytes[4] = { u8(value), u8(value >> 8), u8(value >> 16), u8(value >> 24) };
+		ofs.seekp(offset);
+		Write(bytes, sizeof(bytes));
+	};
+	Patch(AVIOffset::riff_size, u32(file_size - 8));
+	Patch(AVIOffset::avih_total_frames, avi_num_frames);
+	Patch(AVIOffset::strh_length, avi_num_frames);
+	Patch(AVIOffset::movi_size, u32(avi_movi_size));
+	ofs.close();
+}
+
+
+std::string VideoCapture::GetAVIPath() const
+{
+	if (avi_file_index == 0)
+		return path;
+	const std::filesystem::path fs_path{ path };
+	return (fs_path.parent_path() / std::format("{}_{}{}", fs_path.stem().string(), avi_file_index, fs_path.extension().string())).string();
+}
+
+
+void VideoCapture::WriteY4MHeader()
+{
+	const std::string header = std::format("YUV4MPEG2 W{} H{} F{}:{} Ip A1:1 C444 XCOLORRANGE=FULL\n",
+		frame_width, height, frame_rate_numerator, frame_rate_denominator);
+	Write(header.data(), header.size());
+}
+
+
+void VideoCapture::WriteY4MFrame()
+{
+	/* The planes (Y, then Cb, then Cr) are stored one after the other. */
+	const size_t plane_size = frame_width * height;
+	converted_frame.resize(plane_size * 3);
+	for (size_t i = 0; i < plane_size; i++)
+	{
+		const std::array<u8, 3>& yuv = yuv_palette[last_frame[i]];
+		converted_frame[i] = yuv[0];
+		converted_frame[plane_size + i] = yuv[1];
+		converted_frame[2 * plane_size + i] = yuv[2];
+	}
+	static constexpr char frame_header[] = "FRAME\n";
+	Write(frame_header, sizeof(frame_header) - 1);
+	Write(converted_frame.data(), converted_frame.size());
+}
+
+
+void VideoCapture::WritePNGFrame(const bool repeat)
+{
+	if (write_failed)
+		return;
+
+	if (!repeat)
+	{
+		converted_frame.resize(frame_width * height * 3);
+		u8* dst = converted_frame.data();
+		for (size_t i = 0; i < last_frame.size(); i++)
+		{
+			const u32 rgb = rgb_palette[last_frame[i]];
+			*dst++ = u8(rgb >> 16);
+			*dst++ = u8(rgb >> 8);
+			*dst++ = u8(rgb);
+		}
+		last_png = PNGEncoder::Encode(converted_frame.data(), frame_width, height);
+	}
+
+	const std::filesystem::path fs_path{ path };
+	const std::filesystem::path frame_path = fs_path.parent_path() / std::format("{}_{:06}.png", fs_path.stem().string(), num_frames_written);
+	ofs.open(frame_path, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+	if (!ofs)
+	{
+		write_failed = true;
+		return;
+	}
+	Write(last_png.data(), last_png.size());
+	ofs.close();
+}
+
+
+std::array<std::array<u8, 3>, 512> VideoCapture::MakeYUVPalette() const
+{
+	/* BT.601, full range */
+	std::array<std::array<u8, 3>, 512> yuv{};
+	for (size_t i = 0; i < yuv.size(); i++)
+	{
+		const f32 r = f32(rgb_palette[i] >> 16 & 0xFF);
+		const f32 g = f32(rgb_palette[i] >> 8 & 0xFF);
+		const f32 b = f32(rgb_palette[i] & 0xFF);
+		auto ToU8 = [](f32 value) { return u8(std::clamp(std::lround(value), 0l, 255l)); };
+		yuv[i][0] = ToU8(0.299f * r + 0.587f * g + 0.114f * b);
+		yuv[i][1] = ToU8(128.f - 0.168736f * r - 0.331264f * g + 0.5f * b);
+		yuv[i][2] = ToU8(128.f + 0.5f * r - 0.418688f * g - 0.081312f * b);
+	}
+	return yuv;
+}
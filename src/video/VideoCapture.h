@@ -0,0 +1,128 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../Types.h"
+
+#include "PNGEncoder.h"
+
+/* Records the frames output by the PPU, losslessly and uncompressed (or PNG compressed), to one of:
+   - a raw AVI (24-bit RGB DIB frames). A file is closed and a new one (<name>_<n>.avi) is started before it grows past 1 GiB,
+     since AVI 1.0 readers may not cope with more.
+   - a Y4M (YUV4MPEG2) stream, 4:4:4 and full range, so that no colour information is lost to subsampling.
+   - a sequence of PNG files, <name>_000000.png, <name>_000001.png, ...
+   Frames are copied as 9-bit pixels into a fixed set of buffers, and handed to an encoder thread, so that the emulation thread
+   never converts, compresses or writes anything. When all buffers are in use, the frame is either waited for (for batch encoding,
+   where nothing is lost by waiting), or dropped and replaced by a repeat of the previous frame (when running in real time). */
+class VideoCapture
+{
+public:
+	enum class Format { AVI, PNGSequence, Y4M };
+	enum class OverflowPolicy { Block, Drop };
+
+	explicit VideoCapture(const std::array<u32, 512>& rgb_palette);
+	~VideoCapture();
+	VideoCapture(const VideoCapture& other) = delete;
+	VideoCapture(VideoCapture&& other) = delete;
+
+	VideoCapture& operator=(const VideoCapture& other) = delete;
+	VideoCapture& operator=(VideoCapture&& other) = delete;
+
+	static constexpr unsigned frame_width = 256;
+
+	/* Deduces the format from the file extension (.avi, .png or .y4m). */
+	static std::optional<Format> GetFormatFromPath(const std::string& path);
+
+	/* The frame rate is given as a fraction, e.g. 39375000/655171 for NTSC. */
+	[[nodiscard]] bool Start(const std::string& path, Format format, unsigned height,
+		u32 frame_rate_numerator, u32 frame_rate_denominator, OverflowPolicy overflow_policy);
+	/* Waits for every queued frame to be written, and closes the output. Returns false if anything could not be written. */
+	bool Stop();
+	bool IsCapturing() const { return capturing; }
+	u64 GetNumDroppedFrames() const { return num_dropped_frames; }
+
+	/* Queues a frame of 'frame_width' * height 9-bit pixels (see VideoOutput). */
+	void PushFrame(const u16* pixels);
+	/* Queues a repeat of the last frame, e.g. for frames that were skipped by the PPU, so that the recording keeps its timing. */
+	void RepeatFrame();
+
+private:
+	static constexpr unsigned num_buffers = 8;
+	static constexpr u64 max_avi_movi_size = 1ull << 30;
+
+	struct QueuedFrame
+	{
+		std::optional<unsigned> buffer_index; /* Empty if this is a repeat of the previous frame. */
+		unsigned num_repeats; /* The number of times the frame is repeated after being written once. */
+	};
+
+	struct AVIIndexEntry
+	{
+		u32 offset;
+		u32 size;
+	};
+
+	const std::array<u32, 512>& rgb_palette;
+	std::array<std::array<u8, 3>, 512> yuv_palette;
+
+	bool capturing = false;
+	bool stopping = false;
+	bool write_failed = false; /* Only accessed by the encoder thread while it is running. */
+	std::atomic<u64> num_dropped_frames = 0;
+
+	Format format;
+	OverflowPolicy overflow_policy;
+	std::string path;
+	unsigned height;
+	u32 frame_rate_numerator, frame_rate_denominator;
+
+	std::vector<std::vector<u16>> buffers;
+	std::vector<unsigned> free_buffers;
+	std::queue<QueuedFrame> queue;
+	std::mutex mutex;
+	std::condition_variable buffer_available;
+	std::condition_variable frame_available;
+	std::thread encoder_thread;
+
+	/* Encoder thread state */
+	bool has_written_frame = false;
+	u64 num_frames_written = 0;
+	std::vector<u16> last_frame;
+	std::vector<u8> converted_frame;
+	std::vector<u8> last_png;
+	std::ofstream ofs;
+
+	/* AVI */
+	unsigned avi_file_index = 0;
+	u32 avi_num_frames = 0;
+	u64 avi_movi_size = 0;
+	std::vector<AVIIndexEntry> avi_index;
+
+	void EncoderLoop();
+	void Write(const void* data, size_t size);
+	void WriteFrame();
+	void WriteRepeatedFrame();
+
+	bool OpenAVI();
+	void WriteAVIHeader();
+	void WriteAVIFrame(bool repeat);
+	void FinishAVI();
+	std::string GetAVIPath() const;
+
+	void WriteY4MHeader();
+	void WriteY4MFrame();
+
+	void WritePNGFrame(bool repeat);
+
+	std::array<std::array<u8, 3>, 512> MakeYUVPalette() const;
+};
@@ -0,0 +1,194 @@
+#include "VideoOutput.h"
+
+
+VideoOutput::~VideoOutput()
+{
+	SDL_DestroyTexture(texture);
+	SDL_DestroyRenderer(renderer);
+	SDL_DestroyWindow(window);
+}
+
+
+bool VideoOutput::CreateRenderer(const void* window_handle)
+{
+	this->window = SDL_CreateWindowFrom(window_handle);
+	if (window == nullptr)
+	{
+		const char* error_msg = SDL_GetError();
+		UserMessage::Show(std::format("Could not create the SDL window; {}", error_msg), UserMessage::Type::Error);
+		return false;
+	}
+
+	this->renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+	if (renderer == nullptr)
+	{
+		const char* error_msg = SDL_GetError();
+		UserMessage::Show(std::format("Could not create the SDL renderer; {}", error_msg), UserMessage::Type::Error);
+		SDL_DestroyWindow(window);
+		window = nullptr;
+		return false;
+	}
+
+	if (thread_pool == nullptr)
+		thread_pool = std::make_unique<ThreadPool>();
+	return true;
+}
+
+
+void VideoOutput::Clear()
+{
+	if (renderer != nullptr)
+		SDL_RenderClear(renderer);
+}
+
+
+void VideoOutput::PresentFrame(const u16* pixels, const unsigned height, const unsigned scale, const SDL_Rect& dst_rect, const unsigned burst_phase)
+{
+	if (capture.IsCapturing())
+		capture.PushFrame(pixels);
+
+	/* Without a renderer (e.g. when running headless), there is nowhere to show the frame. */
+	if (renderer == nullptr)
+		return;
+
+	/* Read once, as the GUI thread may change it while the frame is converted */
+	const Filter filter = this->filter;
+	const unsigned factor = [&] {
+		const std::optional<Upscaler::Algorithm> algorithm = GetUpscalerAlgorithm(filter);
+		return algorithm.has_value() ? Upscaler::GetFactor(algorithm.value()) : 1;
+	}();
+	const unsigned integer_scale = filter == Filter::None || filter == Filter::NTSC ? 1 : std::max(scale / factor, 1u);
+	const unsigned width = filter == Filter::NTSC
+		? frame_width * std::clamp(scale, 1u, max_ntsc_scale)
+		: frame_width * factor * integer_scale;
+
+	if (!PrepareTexture(width, height * factor * integer_scale))
+		return;
+
+	void* texture_pixels;
+	int pitch;
+	if (SDL_LockTexture(texture, nullptr, &texture_pixels, &pitch) != 0)
+		return;
+
+	Convert(filter, pixels, height, scale, burst_phase, static_cast<u32*>(texture_pixels), pitch / sizeof(u32));
+	SDL_UnlockTexture(texture);
+	SDL_RenderCopy(renderer, texture, nullptr, &dst_rect);
+	SDL_RenderPresent(renderer);
+}
+
+
+void VideoOutput::SkipFrame()
+{
+	/* The screen keeps showing the last frame, and so does the recording. */
+	if (capture.IsCapturing())
+		capture.RepeatFrame();
+}
+
+
+void VideoOutput::Convert(const Filter filter, const u16* pixels, const unsigned height, const unsigned scale, const unsigned burst_phase, u32* output, const size_t output_pitch)
+{
+	if (filter == Filter::NTSC)
+	{
+		const unsigned width = frame_width * std::clamp(scale, 1u, max_ntsc_scale);
+		thread_pool->ParallelFor(height, [&](size_t first_row, size_t end_row) {
+			ntsc_filter.FilterRows(pixels, unsigned(first_row), unsigned(end_row - first_row), burst_phase, output, output_pitch, width);
+		});
+	}
+	else if (const std::optional<Upscaler::Algorithm> algorithm = GetUpscalerAlgorithm(filter); algorithm.has_value())
+	{
+		const unsigned integer_scale = std::max(scale / Upscaler::GetFactor(algorithm.value()), 1u);
+		thread_pool->ParallelFor(height, [&](size_t first_row, size_t end_row) {
+			upscaler.PrepareRows(pixels, height, unsigned(first_row), unsigned(end_row - first_row));
+		});
+		thread_pool->ParallelFor(height, [&](size_t first_row, size_t end_row) {
+			upscaler.ScaleRows(algorithm.value(), unsigned(first_row), unsigned(end_row - first_row), integer_scale, output, output_pitch);
+		});
+	}
+	else
+	{
+		thread_pool->ParallelFor(height, [&](size_t first_row, size_t end_row) {
+			ConvertRows(pixels, unsigned(first_row), unsigned(end_row - first_row), output, output_pitch);
+		});
+	}
+}
+
+
+void VideoOutput::ConvertRows(const u16* pixels, const unsigned first_row, const unsigned num_rows, u32* output, const size_t output_pitch) const
+{
+	for (unsigned row = first_row; row < first_row + num_rows; row++)
+	{
+		const u16* src = pixels + row * frame_width;
+		u32* dst = output + row * output_pitch;
+		for (unsigned x = 0; x < frame_width; x++)
+			dst[x] = rgb_palette[src[x]];
+	}
+}
+
+
+std::array<u32, 512> VideoOutput::MakeRGBPalette() const
+{
+	/* Each emphasis bit (red, green, blue) darkens the two other colour channels. */
+	std::array<u32, 512> rgb{};
+	for (unsigned pixel = 0; pixel < rgb.size(); pixel++)
+	{
+		const SDL_Color& col = palette[pixel & 0x3F];
+		const unsigned emphasis = pixel >> 6;
+		std::array<f32, 3> channels = { f32(col.r), f32(col.g), f32(col.b) };
+		for (unsigned channel = 0; channel < 3; channel++)
+		{
+			for (unsigned emphasized_channel = 0; emphasized_channel < 3; emphasized_channel++)
+			{
+				if (emphasized_channel != channel && emphasis & 1 << emphasized_channel)
+					channels[channel] *= emphasis_attenuation;
+			}
+		}
+		rgb[pixel] = u32(channels[0] + 0.5f) << 16 | u32(channels[1] + 0.5f) << 8 | u32(channels[2] + 0.5f);
+	}
+	return rgb;
+}
+
+
+/* (Re)creates the streaming texture if its size needs to change. Returns false if that failed. */
+bool VideoOutput::PrepareTexture(const int width, const int height)
+{
+	if (texture != nullptr && texture_width == width && texture_height == height)
+		return true;
+
+	SDL_DestroyTexture(texture);
+	texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_STREAMING, width, height);
+	if (texture == nullptr)
+	{
+		texture_width = texture_height = 0;
+		return false;
+	}
+	texture_width = width;
+	texture_height = height;
+	return true;
+}
+
+
+std::optional<Upscaler::Algorithm> VideoOutput::GetUpscalerAlgorithm(const Filter filter)
+{
+	switch (filter)
+	{
+	case Filter::Nearest: return Upscaler::Algorithm::Nearest;
+	case Filter::Scale2x: return Upscaler::Algorithm::Scale2x;
+	case Filter::Scale3x: return Upscaler::Algorithm::Scale3x;
+	case Filter::HQ2x: return Upscaler::Algorithm::HQ2x;
+	case Filter::HQ3x: return Upscaler::Algorithm::HQ3x;
+	case Filter::XBR: return Upscaler::Algorithm::XBR;
+	default: return std::nullopt;
+	}
+}
+
+
+void VideoOutput::StreamConfig(SerializationStream& stream)
+{
+	stream.StreamPrimitive(filter);
+}
+
+
+void VideoOutput::SetDefaultConfig()
+{
+	filter = default_filter;
+}